@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A small benchmark runner: each case is calibrated to run for about
+// `min_time`, measured over several repetitions, and reported as the
+// median time per iteration (plus throughput when the case says how many
+// bytes one iteration processes).
+
+// Keep the compiler from discarding a result whose value is never used.
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class BenchRunner {
+public:
+    std::string               filter;                        // substring of the case name
+    std::chrono::milliseconds min_time{200};                 // per repetition
+    int                       repetitions = 5;
+
+    // Runs fn() in a loop; `bytes` is what one call processes (0: none).
+    template <typename Fn>
+    void run(std::string_view name, size_t bytes, Fn fn) {
+        if (!filter.empty() && name.find(filter) == std::string_view::npos) return;
+        using clock = std::chrono::steady_clock;
+
+        // calibrate: double the batch until it takes a tenth of min_time
+        uint64_t batch = 1;
+        for (;;) {
+            auto start = clock::now();
+            for (uint64_t i = 0; i < batch; ++i) fn();
+            if (clock::now() - start >= min_time / 10 || batch >= (uint64_t{1} << 30)) break;
+            batch *= 2;
+        }
+        batch = std::max<uint64_t>(1, batch * 10);
+
+        std::vector<double> perIter;
+        for (int r = 0; r < repetitions; ++r) {
+            auto start = clock::now();
+            for (uint64_t i = 0; i < batch; ++i) fn();
+            std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+            perIter.push_back(elapsed.count() / static_cast<double>(batch));
+        }
+        std::sort(perIter.begin(), perIter.end());
+        double median = perIter[perIter.size() / 2];
+
+        std::printf("%-40.*s %12.1f ns %10llu iter", static_cast<int>(name.size()), name.data(), median,
+                    static_cast<unsigned long long>(batch));
+        if (bytes) std::printf(" %10.1f MB/s", static_cast<double>(bytes) / median * 1e3);
+        std::printf("\n");
+        ++ran_;
+    }
+
+    int ran() const { return ran_; }
+
+private:
+    int ran_ = 0;
+};
@@ -0,0 +1,277 @@
+// Microbenchmarks for the sampling hot path: the /proc parsers, Docker
+// list parsing and the JSON / OpenMetrics renderers, run against recorded
+// inputs under bench/fixtures/{small,large}.  The large set is sized for a
+// big host: 256 cores, 500 interfaces, 512 block devices, 400 mounts and
+// 1000 containers.
+//
+//   serverhealth_bench [--filter=SUBSTRING] [--min-time=MS] [--fixtures=DIR]
+
+#include "bench.h"
+
+#include "docker_client.h"
+#include "health_collector.h"
+#include "json_delta.h"
+#include "json_writer.h"
+#include "openmetrics.h"
+#include "proc_parsers.h"
+#include "series_store.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef SERVERHEALTH_BENCH_FIXTURES
+#define SERVERHEALTH_BENCH_FIXTURES "bench/fixtures"
+#endif
+
+static std::string readFile(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) {
+        std::cerr << "missing fixture " << path << std::endl;
+        std::exit(1);
+    }
+    std::ostringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+struct Fixture {
+    std::string name;   // "small" / "large"
+    std::string dir;
+    std::string stat, meminfo, vmstat, pressure, netdev, diskstats, mounts, containers;
+};
+
+static Fixture loadFixture(const std::string& root, const std::string& name) {
+    Fixture f;
+    f.name       = name;
+    f.dir        = root + "/" + name;
+    f.stat       = readFile(f.dir + "/stat");
+    f.meminfo    = readFile(f.dir + "/meminfo");
+    f.vmstat     = readFile(f.dir + "/vmstat");
+    f.pressure   = readFile(f.dir + "/pressure/io");
+    f.netdev     = readFile(f.dir + "/net/dev");
+    f.diskstats  = readFile(f.dir + "/diskstats");
+    f.mounts     = readFile(f.dir + "/mounts");
+    f.containers = readFile(f.dir + "/containers.json");
+    return f;
+}
+
+// A full document as one sample of this host would produce it.
+static HealthData healthData(const Fixture& f) {
+    HealthData d;
+    d.timestamp = 1717000000;
+    d.groups    = kAllGroups & ~kGroupTemperature;
+    d.refreshed = d.groups;
+
+    CpuTimes              total;
+    std::vector<CpuTimes> cores;
+    parseProcStat(f.stat, total, cores);
+    for (const auto& c : cores) d.cpu.cores.push_back(CpuCoreInfo{c.cpu, 12.5f, 8.25f, 3.0f, 1.0f, 0.125f, 0.125f, 0.0f});
+    d.cpu.usage_percent = 12.5f;
+    d.cpu.idle_percent  = 87.5f;
+    parseMeminfo(f.meminfo, d.memory);
+    d.pressure.available = parsePressure(f.pressure, d.pressure.io);
+    parseNetDev(f.netdev, d.network);
+    parseDiskstats(f.diskstats, d.disk_io);
+
+    std::vector<MountEntry> mounts;
+    parseMounts(f.mounts, mounts);
+    for (const auto& m : mounts) d.disks.push_back(DiskInfo{m.mount, 976762584, 512345678, 464416906, 52.45f, false});
+
+    parseContainerList(f.containers, d.docker);
+    d.speed.available     = true;
+    d.speed.download_mbps = 941.5f;
+    d.speed.upload_mbps   = 38.25f;
+    d.speed.timestamp     = "2024-05-29T16:26:40Z";
+    return d;
+}
+
+static void benchFixture(BenchRunner& b, const Fixture& f) {
+    const std::string p = f.name + "/";
+
+    {
+        CpuTimes total;
+        std::vector<CpuTimes> cores;
+        b.run(p + "parseProcStat", f.stat.size(), [&] {
+            parseProcStat(f.stat, total, cores);
+            doNotOptimize(cores.data());
+        });
+    }
+    {
+        MemoryInfo info{};
+        b.run(p + "parseMeminfo", f.meminfo.size(), [&] {
+            parseMeminfo(f.meminfo, info);
+            doNotOptimize(info);
+        });
+    }
+    {
+        VmStat vm;
+        b.run(p + "parseVmstat", f.vmstat.size(), [&] {
+            parseVmstat(f.vmstat, vm);
+            doNotOptimize(vm);
+        });
+    }
+    {
+        PressureResource res;
+        b.run(p + "parsePressure", f.pressure.size(), [&] {
+            parsePressure(f.pressure, res);
+            doNotOptimize(res);
+        });
+    }
+    {
+        std::vector<NetworkInterface> out;
+        b.run(p + "parseNetDev", f.netdev.size(), [&] {
+            parseNetDev(f.netdev, out);
+            doNotOptimize(out.data());
+        });
+    }
+    {
+        std::vector<DiskIO> out;
+        b.run(p + "parseDiskstats", f.diskstats.size(), [&] {
+            parseDiskstats(f.diskstats, out);
+            doNotOptimize(out.data());
+        });
+    }
+    {
+        std::vector<MountEntry> out;
+        b.run(p + "parseMounts", f.mounts.size(), [&] {
+            parseMounts(f.mounts, out);
+            doNotOptimize(out.data());
+        });
+    }
+    {
+        std::vector<DockerContainer> out;
+        b.run(p + "parseContainerList", f.containers.size(), [&] {
+            out.clear();
+            parseContainerList(f.containers, out);
+            doNotOptimize(out.data());
+        });
+    }
+
+    const HealthData data = healthData(f);
+    std::string out;
+    HealthCollector::writeJson(data, out, true);
+    b.run(p + "writeJson/pretty", out.size(), [&] {
+        HealthCollector::writeJson(data, out, true);
+        doNotOptimize(out.data());
+    });
+    HealthCollector::writeJson(data, out, false);
+    b.run(p + "writeJson/compact", out.size(), [&] {
+        HealthCollector::writeJson(data, out, false);
+        doNotOptimize(out.data());
+    });
+    {
+        const std::string doc = out;
+        std::vector<FlatField> prev, cur;
+        flattenJson(doc, prev);
+        b.run(p + "flattenJson", doc.size(), [&] {
+            flattenJson(doc, cur);
+            doNotOptimize(cur.data());
+        });
+        std::string delta;
+        b.run(p + "writeJsonDelta/unchanged", 0, [&] {
+            JsonWriter w(delta, false);
+            w.beginObject();
+            writeJsonDelta(w, prev, cur);
+            w.endObject();
+            doNotOptimize(delta.data());
+        });
+    }
+    renderOpenMetrics(data, 1, out);
+    b.run(p + "renderOpenMetrics", out.size(), [&] {
+        renderOpenMetrics(data, 1, out);
+        doNotOptimize(out.data());
+    });
+
+    // The whole /api/health path against the fixture as PROC_PATH: read,
+    // parse, compute and serialize.  Disks, temperature and Docker need the
+    // real host and are left out.
+    setenv("PROC_PATH", f.dir.c_str(), 1);
+    HealthCollector collector(kGroupCpu | kGroupMemory | kGroupNetwork | kGroupDiskIO);
+    b.run(p + "getHealthJson", 0, [&] {
+        std::string json = collector.getHealthJson();
+        doNotOptimize(json.data());
+    });
+}
+
+static void benchStrings(BenchRunner& b) {
+    const std::string plain(256, 'a');
+    std::string escaped;
+    for (int i = 0; i < 32; ++i) escaped += "path\\with \"quotes\"\n";
+    std::string out;
+    b.run("appendJsonString/plain", plain.size(), [&] {
+        out.clear();
+        appendJsonString(out, plain);
+        doNotOptimize(out.data());
+    });
+    b.run("appendJsonString/escaped", escaped.size(), [&] {
+        out.clear();
+        appendJsonString(out, escaped);
+        doNotOptimize(out.data());
+    });
+
+    const std::string mountPlain   = "/var/lib/docker/overlay2/0123456789abcdef/merged";
+    const std::string mountEscaped = "/mnt/My\\040Drive\\040(2)/back\\134slash\\011tab";
+    b.run("decodeMountField/plain", mountPlain.size(), [&] {
+        std::string s = decodeMountField(mountPlain);
+        doNotOptimize(s.data());
+    });
+    b.run("decodeMountField/escaped", mountEscaped.size(), [&] {
+        std::string s = decodeMountField(mountEscaped);
+        doNotOptimize(s.data());
+    });
+}
+
+// Persistent history: one append (the sampler does ~100 per sample) and
+// decoding an hour of one series at 1 s, in a scratch directory.
+static void benchStore(BenchRunner& b) {
+    char tmpl[] = "/tmp/serverhealth-bench-XXXXXX";
+    if (!mkdtemp(tmpl)) return;
+    {
+        SeriesStore store(tmpl, std::chrono::hours(24 * 365));
+        int64_t t = 1700000000000;
+        float   v = 42.0f;
+        b.run("SeriesStore/append", 0, [&] {
+            t += 1000 + (t & 7);
+            v += (t & 0x10) ? 0.25f : -0.25f;
+            store.append("cpu.usage_percent", t, v);
+        });
+        for (int i = 0; i < 3600; ++i) store.append("memory.usage_percent", 1700000000000 + i * 1000LL, 50.0f + i % 13);
+        b.run("SeriesStore/scan-1h", 0, [&] {
+            double sum = 0.0;
+            store.scan("memory.usage_percent", 0, INT64_MAX, [&](int64_t, float x) { sum += x; });
+            doNotOptimize(sum);
+        });
+    }
+    std::error_code ec;
+    std::filesystem::remove_all(tmpl, ec);
+}
+
+int main(int argc, char** argv) {
+    BenchRunner b;
+    std::string fixtures = SERVERHEALTH_BENCH_FIXTURES;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if      (arg.rfind("--filter=", 0) == 0)   b.filter = std::string(arg.substr(9));
+        else if (arg.rfind("--min-time=", 0) == 0) b.min_time = std::chrono::milliseconds(std::atol(argv[i] + 11));
+        else if (arg.rfind("--fixtures=", 0) == 0) fixtures = std::string(arg.substr(11));
+        else {
+            std::cerr << "usage: " << argv[0] << " [--filter=SUBSTRING] [--min-time=MS] [--fixtures=DIR]" << std::endl;
+            return 2;
+        }
+    }
+
+    benchStrings(b);
+    benchStore(b);
+    for (const char* scale : {"small", "large"}) benchFixture(b, loadFixture(fixtures, scale));
+    if (b.ran() == 0) {
+        std::cerr << "no benchmark matches \"" << b.filter << "\"" << std::endl;
+        return 1;
+    }
+    return 0;
+}
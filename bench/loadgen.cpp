@@ -0,0 +1,195 @@
+// Load generator for a running serverhealth instance.
+//
+// Request mode: --connections keep-alive clients issue GETs back to back,
+// round-robin over --paths, for --duration seconds; reports requests/s,
+// bytes/s and latency percentiles per path.
+//
+// Stream mode (--streams=N): additionally holds N /api/stream subscribers
+// open and reports time to the first frame and frames received.
+//
+//   serverhealth_loadgen [--host=127.0.0.1] [--port=9091] [--connections=8]
+//                        [--duration=10] [--paths=/api/health,/metrics]
+//                        [--streams=0] [--gzip]
+
+#include "latency_histogram.h"
+
+#include "httplib.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string              host        = "127.0.0.1";
+    int                      port        = 9091;
+    int                      connections = 8;
+    int                      duration_s  = 10;
+    int                      streams     = 0;
+    bool                     gzip        = false;
+    std::vector<std::string> paths{"/api/health", "/metrics"};
+};
+
+struct PathStats {
+    std::string           path;
+    LatencyHistogram      latency;
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> errors{0};
+};
+
+struct StreamStats {
+    LatencyHistogram      first_frame;
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> errors{0};
+};
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t nanosSince(Clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+std::vector<std::string> splitList(std::string_view s) {
+    std::vector<std::string> out;
+    while (!s.empty()) {
+        size_t comma = s.find(',');
+        if (comma != 0) out.emplace_back(s.substr(0, comma));
+        if (comma == std::string_view::npos) break;
+        s.remove_prefix(comma + 1);
+    }
+    return out;
+}
+
+void requestWorker(const Options& o, std::vector<std::unique_ptr<PathStats>>& stats, size_t offset,
+                   Clock::time_point end) {
+    httplib::Client cli(o.host, o.port);
+    cli.set_keep_alive(true);
+    httplib::Headers headers;
+    if (o.gzip) headers.emplace("Accept-Encoding", "gzip");
+
+    for (size_t i = offset; Clock::now() < end; ++i) {
+        PathStats& s = *stats[i % stats.size()];
+        auto start = Clock::now();
+        auto res = cli.Get(s.path, headers);
+        uint64_t ns = nanosSince(start);
+        if (!res || res->status != 200) {
+            s.errors.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        s.latency.record(ns);
+        s.bytes.fetch_add(res->body.size(), std::memory_order_relaxed);
+    }
+}
+
+// Counts "\n\n" frame terminators (keep-alive comments included, though
+// with samples every second there are none); a terminator split across two
+// reads is caught by remembering whether the previous chunk ended in '\n'.
+void streamWorker(const Options& o, StreamStats& stats, Clock::time_point end) {
+    httplib::Client cli(o.host, o.port);
+    cli.set_read_timeout(std::chrono::seconds(20));
+    auto start      = Clock::now();
+    bool first      = true;
+    bool trailingNl = false;
+    auto res = cli.Get("/api/stream", httplib::Headers{}, [&](const char* data, size_t n) {
+        stats.bytes.fetch_add(n, std::memory_order_relaxed);
+        for (size_t i = 0; i < n; ++i) {
+            bool nl = data[i] == '\n';
+            if (nl && trailingNl) {
+                if (first) {
+                    stats.first_frame.record(nanosSince(start));
+                    first = false;
+                }
+                stats.frames.fetch_add(1, std::memory_order_relaxed);
+            }
+            trailingNl = nl;
+        }
+        return Clock::now() < end;
+    });
+    if (first) stats.errors.fetch_add(1, std::memory_order_relaxed);
+    (void)res;   // ends with Canceled once the receiver stops it
+}
+
+void printLatency(const char* label, const LatencyHistogram& h) {
+    LatencyHistogram::Summary s = h.summary();
+    double mean = s.count ? static_cast<double>(s.sum_ns) / s.count : 0.0;
+    std::printf("  %-28s mean %8.3f ms  p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f\n", label, mean / 1e6,
+                s.p50_ns / 1e6, s.p90_ns / 1e6, s.p99_ns / 1e6, s.max_ns / 1e6);
+}
+
+bool parseArgs(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view a = argv[i];
+        auto value = [&a](const char* flag) -> const char* {
+            size_t n = std::char_traits<char>::length(flag);
+            return a.compare(0, n, flag) == 0 ? a.data() + n : nullptr;
+        };
+        if      (const char* v = value("--host="))        o.host        = v;
+        else if (const char* v = value("--port="))        o.port        = std::atoi(v);
+        else if (const char* v = value("--connections=")) o.connections = std::atoi(v);
+        else if (const char* v = value("--duration="))    o.duration_s  = std::atoi(v);
+        else if (const char* v = value("--streams="))     o.streams     = std::atoi(v);
+        else if (const char* v = value("--paths="))       o.paths       = splitList(v);
+        else if (a == "--gzip")                           o.gzip        = true;
+        else return false;
+    }
+    return o.duration_s > 0 && o.connections >= 0 && o.streams >= 0 &&
+           (o.connections == 0 || !o.paths.empty());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options o;
+    if (!parseArgs(argc, argv, o)) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--host=H] [--port=P] [--connections=N] [--duration=S] [--paths=/a,/b] [--streams=N] [--gzip]"
+                  << std::endl;
+        return 2;
+    }
+
+    std::vector<std::unique_ptr<PathStats>> stats;
+    for (const auto& p : o.paths) {
+        stats.push_back(std::make_unique<PathStats>());
+        stats.back()->path = p;
+    }
+    StreamStats streamStats;
+
+    auto start = Clock::now();
+    auto end   = start + std::chrono::seconds(o.duration_s);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < o.streams; ++i)
+        threads.emplace_back([&o, &streamStats, end] { streamWorker(o, streamStats, end); });
+    for (int i = 0; i < o.connections; ++i)
+        threads.emplace_back([&o, &stats, end, i] { requestWorker(o, stats, static_cast<size_t>(i), end); });
+    for (auto& t : threads) t.join();
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::printf("%s:%d, %d connections, %d streams, %.1f s%s\n", o.host.c_str(), o.port, o.connections, o.streams,
+                elapsed, o.gzip ? ", gzip" : "");
+    uint64_t total = 0;
+    for (const auto& s : stats) {
+        uint64_t n = s->latency.summary().count;
+        total += n;
+        std::printf("%s: %.0f req/s, %.2f MB/s, %llu errors\n", s->path.c_str(), n / elapsed,
+                    s->bytes.load() / elapsed / 1e6, static_cast<unsigned long long>(s->errors.load()));
+        printLatency("latency", s->latency);
+    }
+    if (!stats.empty()) std::printf("total: %.0f req/s\n", total / elapsed);
+    if (o.streams > 0) {
+        std::printf("/api/stream: %llu frames (%.1f/s per stream), %.2f MB, %llu failed\n",
+                    static_cast<unsigned long long>(streamStats.frames.load()),
+                    streamStats.frames.load() / elapsed / o.streams, streamStats.bytes.load() / 1e6,
+                    static_cast<unsigned long long>(streamStats.errors.load()));
+        printLatency("time to first frame", streamStats.first_frame);
+    }
+    return 0;
+}
@@ -0,0 +1,512 @@
+#include "alerts.h"
+
+#include <charconv>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+// EWMA weight of a new sample, and how many samples a z-score rule waits
+// before its mean and variance are trusted
+static constexpr double   kZAlpha  = 0.05;
+static constexpr uint32_t kZWarmup = 30;
+
+// ---------------------------------------------------------------------------
+// field tables  –  what a rule can watch, per group
+// ---------------------------------------------------------------------------
+
+template <typename T>
+struct NumberField {
+    const char* name;
+    double (*get)(const T&);
+};
+template <typename T>
+struct TextField {
+    const char* name;
+    const std::string& (*get)(const T&);
+};
+
+static const NumberField<CpuInfo> kCpuFields[] = {
+    {"usage_percent",   [](const CpuInfo& c) { return double(c.usage_percent); }},
+    {"idle_percent",    [](const CpuInfo& c) { return double(c.idle_percent); }},
+    {"user_percent",    [](const CpuInfo& c) { return double(c.user_percent); }},
+    {"system_percent",  [](const CpuInfo& c) { return double(c.system_percent); }},
+    {"iowait_percent",  [](const CpuInfo& c) { return double(c.iowait_percent); }},
+    {"irq_percent",     [](const CpuInfo& c) { return double(c.irq_percent); }},
+    {"softirq_percent", [](const CpuInfo& c) { return double(c.softirq_percent); }},
+    {"steal_percent",   [](const CpuInfo& c) { return double(c.steal_percent); }},
+};
+static const NumberField<MemoryInfo> kMemoryFields[] = {
+    {"usage_percent", [](const MemoryInfo& m) { return double(m.usage_percent); }},
+    {"used_kb",       [](const MemoryInfo& m) { return double(m.used_kb); }},
+    {"free_kb",       [](const MemoryInfo& m) { return double(m.free_kb); }},
+    {"available_kb",  [](const MemoryInfo& m) { return double(m.available_kb); }},
+    {"swap_used_kb",  [](const MemoryInfo& m) { return double(m.swap_used_kb); }},
+    {"dirty_kb",      [](const MemoryInfo& m) { return double(m.dirty_kb); }},
+    {"major_faults_per_sec", [](const MemoryInfo& m) { return m.major_faults_per_sec; }},
+    {"swap_out_per_sec",     [](const MemoryInfo& m) { return m.swap_out_per_sec; }},
+    {"oom_kills",            [](const MemoryInfo& m) { return double(m.oom_kills); }},
+};
+static const NumberField<DiskInfo> kDiskFields[] = {
+    {"usage_percent", [](const DiskInfo& d) { return double(d.usage_percent); }},
+    {"used_kb",       [](const DiskInfo& d) { return double(d.used_kb); }},
+    {"free_kb",       [](const DiskInfo& d) { return double(d.free_kb); }},
+    {"inodes_usage_percent", [](const DiskInfo& d) { return double(d.inodes_usage_percent); }},
+    {"inodes_free",          [](const DiskInfo& d) { return double(d.inodes_free); }},
+};
+static const NumberField<NetworkInterface> kNetworkFields[] = {
+    {"rx_bytes_per_sec",   [](const NetworkInterface& n) { return n.rx_bytes_per_sec; }},
+    {"tx_bytes_per_sec",   [](const NetworkInterface& n) { return n.tx_bytes_per_sec; }},
+    {"rx_packets_per_sec", [](const NetworkInterface& n) { return n.rx_packets_per_sec; }},
+    {"tx_packets_per_sec", [](const NetworkInterface& n) { return n.tx_packets_per_sec; }},
+    {"rx_errors",          [](const NetworkInterface& n) { return double(n.rx_errors); }},
+    {"tx_errors",          [](const NetworkInterface& n) { return double(n.tx_errors); }},
+    {"rx_dropped",         [](const NetworkInterface& n) { return double(n.rx_dropped); }},
+    {"tx_dropped",         [](const NetworkInterface& n) { return double(n.tx_dropped); }},
+};
+static const TextField<NetworkInterface> kNetworkText[] = {
+    {"state", [](const NetworkInterface& n) -> const std::string& { return n.state; }},
+};
+static const NumberField<DiskIO> kDiskIOFields[] = {
+    {"reads_per_sec",       [](const DiskIO& d) { return d.reads_per_sec; }},
+    {"writes_per_sec",      [](const DiskIO& d) { return d.writes_per_sec; }},
+    {"read_bytes_per_sec",  [](const DiskIO& d) { return d.read_bytes_per_sec; }},
+    {"write_bytes_per_sec", [](const DiskIO& d) { return d.write_bytes_per_sec; }},
+    {"read_latency_ms",     [](const DiskIO& d) { return d.read_latency_ms; }},
+    {"write_latency_ms",    [](const DiskIO& d) { return d.write_latency_ms; }},
+    {"queue_depth",         [](const DiskIO& d) { return d.queue_depth; }},
+    {"util_percent",        [](const DiskIO& d) { return d.util_percent; }},
+};
+static const NumberField<ThermalZone> kThermalFields[] = {
+    {"temperature_celsius", [](const ThermalZone& t) { return double(t.temperature_celsius); }},
+};
+static const NumberField<DockerContainer> kDockerFields[] = {
+    {"cpu_percent",            [](const DockerContainer& c) { return c.resources.cpu_percent; }},
+    {"memory_bytes",           [](const DockerContainer& c) { return double(c.resources.memory_bytes); }},
+    {"io_read_bytes_per_sec",  [](const DockerContainer& c) { return c.resources.io_read_bytes_per_sec; }},
+    {"io_write_bytes_per_sec", [](const DockerContainer& c) { return c.resources.io_write_bytes_per_sec; }},
+};
+static const TextField<DockerContainer> kDockerText[] = {
+    {"health", [](const DockerContainer& c) -> const std::string& { return c.health; }},
+    {"state",  [](const DockerContainer& c) -> const std::string& { return c.state; }},
+};
+static const NumberField<SpeedTestResult> kSpeedFields[] = {
+    {"download_mbps", [](const SpeedTestResult& s) { return double(s.download_mbps); }},
+    {"upload_mbps",   [](const SpeedTestResult& s) { return double(s.upload_mbps); }},
+    {"latency_ms",    [](const SpeedTestResult& s) { return double(s.latency_ms); }},
+    {"jitter_ms",     [](const SpeedTestResult& s) { return double(s.jitter_ms); }},
+};
+
+static const NumberField<PressureInfo> kPressureFields[] = {
+    {"cpu.some.avg10",    [](const PressureInfo& p) { return double(p.cpu.some.avg10); }},
+    {"cpu.some.avg60",    [](const PressureInfo& p) { return double(p.cpu.some.avg60); }},
+    {"memory.some.avg10", [](const PressureInfo& p) { return double(p.memory.some.avg10); }},
+    {"memory.some.avg60", [](const PressureInfo& p) { return double(p.memory.some.avg60); }},
+    {"memory.full.avg10", [](const PressureInfo& p) { return double(p.memory.full.avg10); }},
+    {"memory.full.avg60", [](const PressureInfo& p) { return double(p.memory.full.avg60); }},
+    {"io.some.avg10",     [](const PressureInfo& p) { return double(p.io.some.avg10); }},
+    {"io.some.avg60",     [](const PressureInfo& p) { return double(p.io.some.avg60); }},
+    {"io.full.avg10",     [](const PressureInfo& p) { return double(p.io.full.avg10); }},
+    {"io.full.avg60",     [](const PressureInfo& p) { return double(p.io.full.avg60); }},
+};
+
+static const NumberField<KernelLatency> kLatencyFields[] = {
+    {"runq.p50_us",             [](const KernelLatency& k) { return k.runq.p50_us; }},
+    {"runq.p99_us",             [](const KernelLatency& k) { return k.runq.p99_us; }},
+    {"tcp_retransmits_per_sec", [](const KernelLatency& k) { return k.tcp_retransmits_per_sec; }},
+};
+
+// Nothing to look up for groups without string fields
+template <typename T>
+static const TextField<T>* noText() { return nullptr; }
+
+template <typename Table>
+static int findField(const Table& table, size_t n, std::string_view name) {
+    for (size_t i = 0; i < n; ++i)
+        if (name == table[i].name) return static_cast<int>(i);
+    return -1;
+}
+
+// Index of `name` in the number (text = false) or string table of `group`
+static bool resolveField(int group, std::string_view name, int& index, bool& text) {
+    auto look = [&](const auto& numbers, const auto* strings, size_t nStrings) {
+        index = findField(numbers, std::size(numbers), name);
+        text  = false;
+        if (index < 0 && strings) {
+            index = findField(strings, nStrings, name);
+            text  = true;
+        }
+        return index >= 0;
+    };
+    switch (1u << group) {
+        case kGroupCpu:         return look(kCpuFields, noText<CpuInfo>(), 0);
+        case kGroupMemory:      return look(kMemoryFields, noText<MemoryInfo>(), 0);
+        case kGroupDisks:       return look(kDiskFields, noText<DiskInfo>(), 0);
+        case kGroupNetwork:     return look(kNetworkFields, kNetworkText, std::size(kNetworkText));
+        case kGroupDiskIO:      return look(kDiskIOFields, noText<DiskIO>(), 0);
+        case kGroupTemperature: return look(kThermalFields, noText<ThermalZone>(), 0);
+        case kGroupDocker:      return look(kDockerFields, kDockerText, std::size(kDockerText));
+        case kGroupSpeed:       return look(kSpeedFields, noText<SpeedTestResult>(), 0);
+        case kGroupPressure:    return look(kPressureFields, noText<PressureInfo>(), 0);
+        case kGroupLatency:     return look(kLatencyFields, noText<KernelLatency>(), 0);
+    }
+    return false;
+}
+
+static bool listGroup(int group) {
+    return !((1u << group) & kObjectGroups);
+}
+
+// ---------------------------------------------------------------------------
+// parsing
+// ---------------------------------------------------------------------------
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t' || s.front() == '\r')) s.remove_prefix(1);
+    while (!s.empty() && (s.back()  == ' ' || s.back()  == '\t' || s.back()  == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+// Next whitespace-separated word of `s`
+static std::string_view word(std::string_view& s) {
+    s = trim(s);
+    size_t end = s.find_first_of(" \t");
+    std::string_view w = s.substr(0, end);
+    s.remove_prefix(end == std::string_view::npos ? s.size() : end);
+    return w;
+}
+
+static bool parseNumber(std::string_view s, double& v) {
+    auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+    return !s.empty() && r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+// "30s", "5m", "1h", or plain seconds
+static bool parseHold(std::string_view s, std::chrono::milliseconds& out) {
+    double scale = 1000.0;
+    if (!s.empty() && (s.back() == 's' || s.back() == 'm' || s.back() == 'h')) {
+        scale = s.back() == 's' ? 1000.0 : s.back() == 'm' ? 60000.0 : 3600000.0;
+        s.remove_suffix(1);
+    }
+    double v;
+    if (!parseNumber(s, v) || v < 0) return false;
+    out = std::chrono::milliseconds(static_cast<int64_t>(v * scale));
+    return true;
+}
+
+static bool parseOp(std::string_view s, AlertRule::Op& op) {
+    using Op = AlertRule::Op;
+    if (s == ">")  { op = Op::Gt; return true; }
+    if (s == ">=") { op = Op::Ge; return true; }
+    if (s == "<")  { op = Op::Lt; return true; }
+    if (s == "<=") { op = Op::Le; return true; }
+    if (s == "==") { op = Op::Eq; return true; }
+    if (s == "!=") { op = Op::Ne; return true; }
+    return false;
+}
+
+// "disks[*].usage_percent" / "cpu.usage_percent"
+static bool parseMetric(std::string_view m, AlertRule& r) {
+    size_t bracket = m.find('[');
+    size_t dot     = bracket == std::string_view::npos ? m.find('.') : m.find("].", bracket);
+    if (dot == std::string_view::npos) return false;
+    std::string_view group = m.substr(0, bracket == std::string_view::npos ? dot : bracket);
+    std::string_view field;
+    if (bracket == std::string_view::npos) {
+        field = m.substr(dot + 1);
+    } else {
+        r.entry.assign(m.substr(bracket + 1, dot - bracket - 1));
+        field = m.substr(dot + 2);
+        if (r.entry.empty()) return false;
+    }
+    r.group = metricGroupIndex(group);
+    if (r.group < 0 || listGroup(r.group) != (bracket != std::string_view::npos)) return false;
+    return resolveField(r.group, field, r.field, r.text);
+}
+
+static bool parseRule(std::string_view line, AlertRule& r) {
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) return false;
+    r.name.assign(trim(line.substr(0, colon)));
+    std::string_view rest = trim(line.substr(colon + 1));
+    r.expr.assign(rest);
+    if (r.name.empty() || !parseMetric(word(rest), r)) return false;
+
+    std::string_view w = word(rest);
+    if (w == "rate" || w == "zscore") {
+        if (r.text) return false;
+        r.fn = w == "rate" ? AlertRule::Fn::Rate : AlertRule::Fn::ZScore;
+        w = word(rest);
+    }
+    if (!parseOp(w, r.op)) return false;
+    w = word(rest);
+    if (r.text) {
+        if ((r.op != AlertRule::Op::Eq && r.op != AlertRule::Op::Ne) || w.empty()) return false;
+        r.word.assign(w);
+    } else if (!parseNumber(w, r.threshold)) {
+        return false;
+    }
+    w = word(rest);
+    if (w.empty()) return true;
+    if (w != "for" || !parseHold(word(rest), r.hold)) return false;
+    return trim(rest).empty();
+}
+
+bool parseAlertRules(std::string_view text, std::vector<AlertRule>& out, std::string& error) {
+    out.clear();
+    while (!text.empty()) {
+        size_t end = text.find_first_of(";\n");
+        std::string_view line = trim(text.substr(0, end));
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+        if (line.empty() || line.front() == '#') continue;
+        AlertRule r;
+        if (!parseRule(line, r)) {
+            error.assign(line);
+            return false;
+        }
+        out.push_back(std::move(r));
+    }
+    return true;
+}
+
+std::string alertMetricName(const AlertRule& rule, const std::string& key) {
+    std::string m = metricGroupName(rule.group);
+    if (listGroup(rule.group)) {
+        m += '[';
+        m += key;
+        m += ']';
+    }
+    m += '.';
+    switch (1u << rule.group) {
+        case kGroupCpu:         m += kCpuFields[rule.field].name;    break;
+        case kGroupMemory:      m += kMemoryFields[rule.field].name; break;
+        case kGroupDisks:       m += kDiskFields[rule.field].name;   break;
+        case kGroupNetwork:     m += rule.text ? kNetworkText[rule.field].name : kNetworkFields[rule.field].name; break;
+        case kGroupDiskIO:      m += kDiskIOFields[rule.field].name; break;
+        case kGroupTemperature: m += kThermalFields[rule.field].name; break;
+        case kGroupDocker:      m += rule.text ? kDockerText[rule.field].name : kDockerFields[rule.field].name; break;
+        case kGroupSpeed:       m += kSpeedFields[rule.field].name;  break;
+        case kGroupPressure:    m += kPressureFields[rule.field].name; break;
+        case kGroupLatency:     m += kLatencyFields[rule.field].name;  break;
+    }
+    return m;
+}
+
+// ---------------------------------------------------------------------------
+// evaluation
+// ---------------------------------------------------------------------------
+
+AlertEngine::AlertEngine(std::vector<AlertRule> rules) {
+    rules_.reserve(rules.size());
+    for (AlertRule& r : rules) {
+        by_group_[r.group].push_back(rules_.size());
+        rules_.push_back(Bound{std::move(r), {}});
+    }
+}
+
+static bool compare(AlertRule::Op op, double x, double t) {
+    switch (op) {
+        case AlertRule::Op::Gt: return x >  t;
+        case AlertRule::Op::Ge: return x >= t;
+        case AlertRule::Op::Lt: return x <  t;
+        case AlertRule::Op::Le: return x <= t;
+        case AlertRule::Op::Eq: return x == t;
+        case AlertRule::Op::Ne: return x != t;
+    }
+    return false;
+}
+
+// `s` is null for number fields
+void AlertEngine::check(Bound& b, const std::string& key, double v, const std::string* s, int64_t tMs,
+                        std::vector<AlertEvent>& events) {
+    const AlertRule& r = b.rule;
+    Instance& in = b.instances[key];
+    in.seen = pass_;
+
+    // an unchanged input cannot change a plain comparison's outcome
+    const bool unchanged = in.has_input && (s ? *s == in.text : v == in.input);
+    if (r.fn == AlertRule::Fn::Value && unchanged && in.pending_since < 0) return;
+
+    bool   cond;
+    double x = v;
+    if (s) {
+        cond = (*s == r.word) == (r.op == AlertRule::Op::Eq);
+        in.text = *s;
+    } else if (r.fn == AlertRule::Fn::Rate) {
+        if (!in.has_input || tMs <= in.input_ms) {
+            in.has_input = true;
+            in.input     = v;
+            in.input_ms  = tMs;
+            return;
+        }
+        x    = (v - in.input) * 1000.0 / static_cast<double>(tMs - in.input_ms);
+        cond = compare(r.op, x, r.threshold);
+    } else if (r.fn == AlertRule::Fn::ZScore) {
+        // score against the history so far, then fold the sample in
+        cond = false;
+        x    = 0.0;
+        if (in.samples >= kZWarmup && in.var > 0.0) {
+            x    = (v - in.mean) / std::sqrt(in.var);
+            cond = compare(r.op, x, r.threshold);
+        }
+        double diff = v - in.mean;
+        double incr = kZAlpha * diff;
+        in.mean = in.samples ? in.mean + incr : v;
+        in.var  = in.samples ? (1.0 - kZAlpha) * (in.var + diff * incr) : 0.0;
+        ++in.samples;
+    } else {
+        cond = compare(r.op, x, r.threshold);
+    }
+    in.has_input = true;
+    in.input     = v;
+    in.input_ms  = tMs;
+    in.value     = x;
+
+    if (cond) {
+        if (in.firing) return;
+        if (in.pending_since < 0) in.pending_since = tMs;
+        if (tMs - in.pending_since < r.hold.count()) return;
+        in.firing   = true;
+        in.since_ms = tMs;
+    } else {
+        in.pending_since = -1;
+        if (!in.firing) return;
+        in.firing = false;
+    }
+    events.push_back(AlertEvent{&r, alertMetricName(r, key), in.firing, x, s ? *s : std::string(),
+                                in.since_ms, tMs});
+}
+
+static const std::string kNoKey;
+
+void AlertEngine::evaluate(const HealthData& d, int64_t tMs, std::vector<AlertEvent>& events) {
+    ++pass_;
+    for (int g = 0; g < kMetricGroupCount; ++g) {
+        if (!(d.refreshed & (1u << g))) continue;
+        for (size_t i : by_group_[g]) {
+            Bound& b = rules_[i];
+            const AlertRule& r = b.rule;
+            auto each = [&](const auto& list, const auto& numbers, const auto* strings, auto key, auto skip) {
+                for (const auto& e : list) {
+                    const std::string& k = key(e);
+                    if (r.entry != "*" && r.entry != k) continue;
+                    if (skip(e)) {   // stale: keep its state as is
+                        auto it = b.instances.find(k);
+                        if (it != b.instances.end()) it->second.seen = pass_;
+                        continue;
+                    }
+                    if (r.text) check(b, k, 0.0, &strings[r.field].get(e), tMs, events);
+                    else        check(b, k, numbers[r.field].get(e), nullptr, tMs, events);
+                }
+            };
+            auto never = [](const auto&) { return false; };
+            switch (1u << g) {
+                case kGroupCpu:
+                    check(b, kNoKey, kCpuFields[r.field].get(d.cpu), nullptr, tMs, events);
+                    break;
+                case kGroupMemory:
+                    check(b, kNoKey, kMemoryFields[r.field].get(d.memory), nullptr, tMs, events);
+                    break;
+                case kGroupSpeed:
+                    if (d.speed.available && !d.speed.stale)
+                        check(b, kNoKey, kSpeedFields[r.field].get(d.speed), nullptr, tMs, events);
+                    break;
+                case kGroupPressure:
+                    if (d.pressure.available)
+                        check(b, kNoKey, kPressureFields[r.field].get(d.pressure), nullptr, tMs, events);
+                    break;
+                case kGroupLatency:
+                    if (d.latency.available)
+                        check(b, kNoKey, kLatencyFields[r.field].get(d.latency), nullptr, tMs, events);
+                    break;
+                case kGroupDisks:
+                    each(d.disks, kDiskFields, noText<DiskInfo>(),
+                         [](const DiskInfo& e) -> const std::string& { return e.path; },
+                         [](const DiskInfo& e) { return e.stale; });
+                    break;
+                case kGroupNetwork:
+                    each(d.network, kNetworkFields, kNetworkText,
+                         [](const NetworkInterface& e) -> const std::string& { return e.name; }, never);
+                    break;
+                case kGroupDiskIO:
+                    each(d.disk_io, kDiskIOFields, noText<DiskIO>(),
+                         [](const DiskIO& e) -> const std::string& { return e.name; }, never);
+                    break;
+                case kGroupTemperature:
+                    each(d.temperature, kThermalFields, noText<ThermalZone>(),
+                         [](const ThermalZone& e) -> const std::string& { return e.zone; }, never);
+                    break;
+                case kGroupDocker:
+                    each(d.docker, kDockerFields, kDockerText,
+                         [](const DockerContainer& e) -> const std::string& { return e.names; },
+                         [](const DockerContainer& e) { return e.stale; });
+                    break;
+            }
+
+            // entries that went away
+            if (!listGroup(g)) continue;
+            for (auto it = b.instances.begin(); it != b.instances.end();) {
+                if (it->second.seen == pass_) {
+                    ++it;
+                    continue;
+                }
+                if (it->second.firing)
+                    events.push_back(AlertEvent{&r, alertMetricName(r, it->first), false, NAN, std::string(),
+                                                it->second.since_ms, tMs});
+                it = b.instances.erase(it);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// rendering
+// ---------------------------------------------------------------------------
+
+static void writeValue(JsonWriter& w, const AlertRule& r, double v, const std::string& text) {
+    if (r.text) w.value(text);
+    else        w.value(v);
+}
+
+void AlertEngine::writeJson(JsonWriter& w) const {
+    w.key("rules");
+    w.beginArray();
+    for (const Bound& b : rules_) {
+        w.beginObject();
+        w.field("name", b.rule.name);
+        w.field("expr", b.rule.expr);
+        w.endObject();
+    }
+    w.endArray();
+    w.key("active");
+    w.beginArray();
+    for (const Bound& b : rules_) {
+        for (const auto& [key, in] : b.instances) {
+            if (!in.firing && in.pending_since < 0) continue;
+            w.beginObject();
+            w.field("rule",   b.rule.name);
+            w.field("metric", alertMetricName(b.rule, key));
+            w.field("state",  in.firing ? "firing" : "pending");
+            w.key("value");
+            writeValue(w, b.rule, in.value, in.text);
+            w.field("since", HealthCollector::isoTimestamp(
+                                 static_cast<std::time_t>((in.firing ? in.since_ms : in.pending_since) / 1000)));
+            w.endObject();
+        }
+    }
+    w.endArray();
+}
+
+void writeAlertEventJson(const AlertEvent& e, const std::string& host, std::string& out) {
+    JsonWriter w(out, false);
+    w.beginObject();
+    w.field("alert",  e.rule->name);
+    w.field("state",  e.firing ? "firing" : "resolved");
+    w.field("metric", e.metric);
+    w.field("expr",   e.rule->expr);
+    w.key("value");
+    writeValue(w, *e.rule, e.value, e.text);
+    w.field("since",     HealthCollector::isoTimestamp(static_cast<std::time_t>(e.since_ms / 1000)));
+    w.field("timestamp", HealthCollector::isoTimestamp(static_cast<std::time_t>(e.t_ms / 1000)));
+    w.field("host",      host);
+    w.endObject();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "health_collector.h"
+#include "json_writer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// One alert rule, e.g.
+//
+//   disk_full: disks[*].usage_percent > 90 for 5m
+//   unhealthy: docker[*].health == unhealthy
+//   rx_burst:  network[eth0].rx_bytes_per_sec rate > 1e7
+//   cpu_spike: cpu.usage_percent zscore > 4 for 30s
+//
+// The metric is named as in /api/history: "group.field" for cpu, memory,
+// internet_speed, pressure and latency (e.g. pressure.io.full.avg10),
+// "group[key].field" for list groups, where key is the disk
+// path, interface, device, thermal zone (thermal_zone0 ...) or container
+// name, or * for all of them.  parseAlertRules() resolves the field to an accessor once, so a
+// sample is never looked up by name.
+struct AlertRule {
+    enum class Fn { Value, Rate, ZScore };
+    enum class Op { Gt, Ge, Lt, Le, Eq, Ne };
+
+    std::string name;
+    std::string expr;            // as written, after the name
+    int         group = 0;
+    std::string entry;           // list groups: key or "*"
+    int         field = 0;       // index into the group's field table
+    bool        text  = false;   // string field (compared with == / !=)
+    Fn          fn    = Fn::Value;
+    Op          op    = Op::Gt;
+    double      threshold = 0.0;
+    std::string word;            // threshold of a string field
+    std::chrono::milliseconds hold{0};   // must hold this long before firing
+};
+
+// Parse rules separated by newlines or ';'.  Empty lines and lines
+// starting with # are skipped.  On failure `error` names the bad rule.
+bool parseAlertRules(std::string_view text, std::vector<AlertRule>& out, std::string& error);
+
+// A rule instance that started or stopped firing.
+struct AlertEvent {
+    const AlertRule* rule = nullptr;
+    std::string      metric;      // e.g. disks[/home].usage_percent
+    bool             firing = false;
+    double           value  = 0.0;   // what was compared (rate / z-score for those)
+    std::string      text;           // value of a string field
+    int64_t          since_ms = 0;   // when it started firing
+    int64_t          t_ms     = 0;
+};
+
+// Evaluates the rules against each sample as it is merged.
+//
+// Rules are bound to their group, so a sample only visits the rules of the
+// groups it refreshed (disks on their own schedule are not re-checked on
+// every tick), and a threshold whose input did not change and that is not
+// waiting out a hold is skipped without comparing anything.  Rate rules
+// keep the previous value, z-score rules an exponentially weighted mean
+// and variance, per instance.  An entry that disappears resolves its
+// alerts.  Sampler thread only.
+class AlertEngine {
+public:
+    explicit AlertEngine(std::vector<AlertRule> rules);
+
+    bool empty() const { return rules_.empty(); }
+
+    // Check the rules of the groups in d.refreshed; transitions are
+    // appended to `events`.
+    void evaluate(const HealthData& d, int64_t tMs, std::vector<AlertEvent>& events);
+
+    // "rules": [...], "active": [{rule, metric, state, value, since}, ...]
+    // into the object `w` has open; state is "firing", or "pending" while
+    // a hold runs.
+    void writeJson(JsonWriter& w) const;
+
+private:
+    struct Instance {
+        bool        firing        = false;
+        int64_t     pending_since = -1;
+        int64_t     since_ms      = 0;
+        double      value         = 0.0;   // last compared value
+        std::string text;
+        bool        has_input     = false;
+        double      input         = 0.0;   // last raw value
+        int64_t     input_ms      = 0;
+        double      mean = 0.0, var = 0.0;   // z-score
+        uint32_t    samples       = 0;
+        uint64_t    seen          = 0;
+    };
+    struct Bound {
+        AlertRule                                 rule;
+        std::unordered_map<std::string, Instance> instances;   // by entry key
+    };
+
+    void check(Bound& b, const std::string& key, double v, const std::string* s, int64_t tMs,
+               std::vector<AlertEvent>& events);
+
+    std::vector<Bound>  rules_;
+    std::vector<size_t> by_group_[kMetricGroupCount];
+    uint64_t            pass_ = 0;
+};
+
+// The metric an instance of `rule` watches for entry `key`.
+std::string alertMetricName(const AlertRule& rule, const std::string& key);
+
+// Webhook body: {"alert", "state", "metric", "expr", "value", "since",
+// "timestamp", "host"}.
+void writeAlertEventJson(const AlertEvent& e, const std::string& host, std::string& out);
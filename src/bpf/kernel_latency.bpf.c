@@ -0,0 +1,204 @@
+// In-kernel latency histograms, read once per sample by ebpf_collector.cpp:
+//
+//   io_hist       block request issue -> completion, per disk (major:minor)
+//   runq_hist     wakeup -> on CPU, per CPU
+//   cgroup_runq   the same, per cgroup v2 id
+//   retransmits   TCP retransmitted segments
+//
+// Everything on the hot path is a map lookup and a few increments of a
+// per-CPU value, so no cache line is shared between CPUs; only the
+// per-cgroup table is shared, and updated atomically.  CO-RE: compiled
+// once against vmlinux.h, relocated on load against the running kernel's
+// BTF.
+
+#include "vmlinux.h"
+
+#include <bpf/bpf_core_read.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+#include "kernel_latency.h"
+
+char LICENSE[] SEC("license") = "GPL";
+
+extern int LINUX_KERNEL_VERSION __kconfig;
+
+#define TASK_RUNNING 0
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, 10240);
+    __type(key, struct request *);
+    __type(value, u64);
+} io_start SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+    __uint(max_entries, 256);
+    __type(key, u32);   // major << 20 | minor, as the kernel's dev_t
+    __type(value, struct kl_hist);
+} io_hist SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, 10240);
+    __type(key, u32);   // pid
+    __type(value, u64);
+} wakeup_start SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, u32);
+    __type(value, struct kl_hist);
+} runq_hist SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, 512);
+    __type(key, u64);   // cgroup id: inode number of the cgroup's directory
+    __type(value, struct kl_hist);
+} cgroup_runq SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, u32);
+    __type(value, u64);
+} retransmits SEC(".maps");
+
+static struct kl_hist zero_hist;
+
+static __always_inline u32 slot(u64 ns) {
+    u64 us = ns / 1000;
+    u32 s  = 0;
+    for (int i = 0; i < KL_SLOTS - 1 && us > 1; i++) {
+        us >>= 1;
+        s++;
+    }
+    return s < KL_SLOTS ? s : KL_SLOTS - 1;   // spelled out for the verifier
+}
+
+static __always_inline struct kl_hist *hist(void *map, const void *key) {
+    struct kl_hist *h = bpf_map_lookup_elem(map, key);
+    if (h) return h;
+    bpf_map_update_elem(map, key, &zero_hist, BPF_NOEXIST);
+    return bpf_map_lookup_elem(map, key);
+}
+
+// ---------------------------------------------------------------------------
+// block I/O
+// ---------------------------------------------------------------------------
+
+// before 5.17 a request pointed at its disk directly
+struct request___old {
+    struct gendisk *rq_disk;
+} __attribute__((preserve_access_index));
+
+static __always_inline u32 disk_dev(struct request *rq) {
+    struct gendisk *disk;
+    if (bpf_core_field_exists(((struct request___old *)rq)->rq_disk))
+        disk = BPF_CORE_READ((struct request___old *)rq, rq_disk);
+    else
+        disk = BPF_CORE_READ(rq, q, disk);
+    if (!disk) return 0;
+    return (u32)BPF_CORE_READ(disk, major) << 20 | (u32)BPF_CORE_READ(disk, first_minor);
+}
+
+static __always_inline int io_issue(struct request *rq) {
+    u64 ts = bpf_ktime_get_ns();
+    bpf_map_update_elem(&io_start, &rq, &ts, BPF_ANY);
+    return 0;
+}
+
+SEC("tp_btf/block_rq_issue")
+int BPF_PROG(block_rq_issue) {
+    // the request_queue argument was dropped in 5.11
+    if (LINUX_KERNEL_VERSION < KERNEL_VERSION(5, 11, 0)) return io_issue((struct request *)ctx[1]);
+    return io_issue((struct request *)ctx[0]);
+}
+
+SEC("tp_btf/block_rq_complete")
+int BPF_PROG(block_rq_complete, struct request *rq, int error, unsigned int nr_bytes) {
+    u64 *tsp = bpf_map_lookup_elem(&io_start, &rq);
+    if (!tsp) return 0;   // issued before the program was attached
+    u64 delta = bpf_ktime_get_ns() - *tsp;
+    bpf_map_delete_elem(&io_start, &rq);
+
+    u32             dev = disk_dev(rq);
+    struct kl_hist *h   = hist(&io_hist, &dev);
+    if (!h) return 0;
+    h->slots[slot(delta)]++;
+    h->sum_ns += delta;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// run queue
+// ---------------------------------------------------------------------------
+
+struct task_struct___old {
+    long state;
+} __attribute__((preserve_access_index));
+
+static __always_inline long task_state(struct task_struct *t) {
+    if (bpf_core_field_exists(t->__state)) return BPF_CORE_READ(t, __state);
+    return BPF_CORE_READ((struct task_struct___old *)t, state);
+}
+
+static __always_inline int enqueued(u32 pid) {
+    if (!pid) return 0;   // the idle task
+    u64 ts = bpf_ktime_get_ns();
+    bpf_map_update_elem(&wakeup_start, &pid, &ts, BPF_ANY);
+    return 0;
+}
+
+SEC("tp_btf/sched_wakeup")
+int BPF_PROG(sched_wakeup, struct task_struct *p) {
+    return enqueued(BPF_CORE_READ(p, pid));
+}
+
+SEC("tp_btf/sched_wakeup_new")
+int BPF_PROG(sched_wakeup_new, struct task_struct *p) {
+    return enqueued(BPF_CORE_READ(p, pid));
+}
+
+SEC("tp_btf/sched_switch")
+int BPF_PROG(sched_switch, bool preempt, struct task_struct *prev, struct task_struct *next) {
+    // a preempted task goes straight back on the run queue
+    if (task_state(prev) == TASK_RUNNING) enqueued(BPF_CORE_READ(prev, pid));
+
+    u32  pid = BPF_CORE_READ(next, pid);
+    u64 *tsp = bpf_map_lookup_elem(&wakeup_start, &pid);
+    if (!tsp) return 0;
+    u64 delta = bpf_ktime_get_ns() - *tsp;
+    bpf_map_delete_elem(&wakeup_start, &pid);
+    u32 s = slot(delta);
+
+    u32             zero = 0;
+    struct kl_hist *h    = bpf_map_lookup_elem(&runq_hist, &zero);
+    if (h) {
+        h->slots[s]++;
+        h->sum_ns += delta;
+    }
+
+    u64 cgroup = BPF_CORE_READ(next, cgroups, dfl_cgrp, kn, id);
+    h = hist(&cgroup_runq, &cgroup);
+    if (h) {
+        __sync_fetch_and_add(&h->slots[s], 1);
+        __sync_fetch_and_add(&h->sum_ns, delta);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// TCP
+// ---------------------------------------------------------------------------
+
+SEC("tp_btf/tcp_retransmit_skb")
+int BPF_PROG(tcp_retransmit_skb, const struct sock *sk, const struct sk_buff *skb) {
+    u32  zero = 0;
+    u64 *n    = bpf_map_lookup_elem(&retransmits, &zero);
+    if (n) (*n)++;
+    return 0;
+}
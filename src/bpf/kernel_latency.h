@@ -0,0 +1,16 @@
+#pragma once
+
+// Map layout shared by kernel_latency.bpf.c and ebpf_collector.cpp.
+
+#ifndef __VMLINUX_H__
+#include <linux/types.h>
+#endif
+
+// log2 buckets of a latency in microseconds: slot i counts [2^i, 2^(i+1)),
+// slot 0 also everything under 1 us, the last slot everything longer
+#define KL_SLOTS 27
+
+struct kl_hist {
+    __u64 slots[KL_SLOTS];
+    __u64 sum_ns;
+};
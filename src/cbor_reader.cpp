@@ -0,0 +1,179 @@
+#include "cbor_reader.h"
+
+#include <cmath>
+#include <cstring>
+
+// Deeper nesting than any health document has; bounds the frame stack
+static constexpr size_t kMaxDepth = 64;
+
+// ---------------------------------------------------------------------------
+// helpers
+// ---------------------------------------------------------------------------
+
+static double halfToDouble(uint16_t h) {
+    int    exp  = (h >> 10) & 0x1f;
+    int    mant = h & 0x3ff;
+    double v;
+    if (exp == 0)       v = std::ldexp(mant, -24);
+    else if (exp == 31) v = mant ? NAN : INFINITY;
+    else                v = std::ldexp(mant + 1024, exp - 25);
+    return (h & 0x8000) ? -v : v;
+}
+
+// The argument following an initial byte: inline below 24, otherwise the
+// next 1 / 2 / 4 / 8 bytes, big endian.
+bool CborReader::readArg(uint8_t info, uint64_t& arg) {
+    if (info < 24) {
+        arg = info;
+        return true;
+    }
+    if (info > 27) return false;
+    size_t bytes = size_t{1} << (info - 24);
+    if (data_.size() - pos_ < bytes) return false;
+    arg = 0;
+    for (size_t i = 0; i < bytes; ++i) arg = (arg << 8) | static_cast<uint8_t>(data_[pos_ + i]);
+    pos_ += bytes;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// tokenizer
+// ---------------------------------------------------------------------------
+
+CborReader::Token CborReader::next() {
+    if (failed_) return Token::Error;
+
+    // a definite-length container ends after its last item, with no marker
+    if (!stack_.empty() && stack_.back().remaining == 0) {
+        bool map = stack_.back().map;
+        stack_.pop_back();
+        return map ? Token::EndObject : Token::EndArray;
+    }
+    if (pos_ >= data_.size()) return stack_.empty() ? Token::End : fail();
+
+    uint8_t ib = static_cast<uint8_t>(data_[pos_]);
+    if (ib == 0xff) {   // "break" closing an indefinite-length container
+        if (stack_.empty() || stack_.back().remaining != kIndefinite || stack_.back().odd) return fail();
+        ++pos_;
+        bool map = stack_.back().map;
+        stack_.pop_back();
+        return map ? Token::EndObject : Token::EndArray;
+    }
+
+    // this item counts towards the enclosing container
+    bool key = false;
+    if (!stack_.empty()) {
+        Frame& f = stack_.back();
+        key   = f.map && !f.odd;
+        f.odd = f.map && !f.odd;
+        if (f.remaining != kIndefinite) --f.remaining;
+    }
+
+    uint8_t  major, info;
+    uint64_t arg = 0;
+    for (;;) {
+        ib    = static_cast<uint8_t>(data_[pos_++]);
+        major = ib >> 5;
+        info  = ib & 0x1f;
+        if (major == 7 || ((major == 2 || major == 3 || major == 4 || major == 5) && info == 31)) break;
+        if (!readArg(info, arg)) return fail();
+        if (major != 6) break;
+        if (pos_ >= data_.size()) return fail();   // tag: its item follows
+    }
+    if (key && major != 3) return fail();   // walked like JSON, so keys are text
+
+    switch (major) {
+        case 0:
+        case 1:
+            kind_ = major == 0 ? Kind::Unsigned : Kind::Negative;
+            arg_  = arg;
+            return Token::Number;
+        case 2:
+        case 3:
+            if (info == 31 || data_.size() - pos_ < arg) return fail();
+            str_.assign(data_.data() + pos_, static_cast<size_t>(arg));
+            pos_ += static_cast<size_t>(arg);
+            return key ? Token::Key : Token::String;
+        case 4:
+        case 5: {
+            if (stack_.size() >= kMaxDepth) return fail();
+            uint64_t items = kIndefinite;
+            if (info != 31) {
+                if (major == 5 && arg > (kIndefinite - 1) / 2) return fail();
+                items = major == 5 ? arg * 2 : arg;
+            }
+            stack_.push_back(Frame{major == 5, items, false});
+            return major == 5 ? Token::BeginObject : Token::BeginArray;
+        }
+        default:   // 7: simple values and floats
+            break;
+    }
+
+    kind_ = info == 27 ? Kind::Double : Kind::Single;
+    switch (info) {
+        case 20: return Token::False;
+        case 21: return Token::True;
+        case 22:
+        case 23: return Token::Null;   // null, undefined
+        case 25:
+        case 26:
+        case 27: {
+            uint64_t bits;
+            if (!readArg(info, bits)) return fail();
+            if (info == 25) {
+                float_ = halfToDouble(static_cast<uint16_t>(bits));
+            } else if (info == 26) {
+                uint32_t b32 = static_cast<uint32_t>(bits);
+                float    f;
+                std::memcpy(&f, &b32, sizeof(f));
+                float_ = f;
+            } else {
+                std::memcpy(&float_, &bits, sizeof(float_));
+            }
+            return Token::Number;
+        }
+        default: return fail();
+    }
+}
+
+double CborReader::number() const {
+    switch (kind_) {
+        case Kind::Unsigned: return static_cast<double>(arg_);
+        case Kind::Negative: return -1.0 - static_cast<double>(arg_);
+        default:             return float_;
+    }
+}
+
+void CborReader::skipValue(bool inside) {
+    int depth = inside ? 1 : 0;
+    do {
+        switch (next()) {
+            case Token::BeginObject:
+            case Token::BeginArray:  ++depth; break;
+            case Token::EndObject:
+            case Token::EndArray:    --depth; break;
+            case Token::End:
+            case Token::Error:       return;
+            default:                 break;
+        }
+    } while (depth > 0);
+}
+
+std::string_view CborReader::rawValue() {
+    size_t start = pos_;
+    switch (next()) {
+        case Token::BeginObject:
+        case Token::BeginArray:
+            skipValue(true);
+            break;
+        case Token::EndObject:
+        case Token::EndArray:
+        case Token::End:
+        case Token::Error:
+            return {};
+        default:
+            break;
+    }
+    if (failed_) return {};
+    return data_.substr(start, pos_ - start);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Pull-style CBOR (RFC 8949) tokenizer over a borrowed buffer, the
+// counterpart of JsonReader: the same tokens, the same skipValue(), so code
+// that walks a JSON document walks a CBOR one with the types swapped.  Text
+// strings in key position of a map come back as Key.
+//
+// Definite and indefinite maps / arrays are both accepted; tags are
+// skipped.  Indefinite-length (chunked) strings, which CborWriter never
+// produces, are reported as Error.
+class CborReader {
+public:
+    enum class Token {
+        BeginObject, EndObject, BeginArray, EndArray,
+        Key, String, Number, True, False, Null,
+        End, Error
+    };
+
+    explicit CborReader(std::string_view data) : data_(data) {}
+
+    Token next();
+
+    // Value of the last Key/String token (text or byte string).
+    const std::string& str() const { return str_; }
+
+    // Last Number token, as a double and, for CBOR integers, exactly.
+    double   number()     const;
+    bool     isInteger()  const { return kind_ == Kind::Unsigned || kind_ == Kind::Negative; }
+    bool     isNegative() const { return kind_ == Kind::Negative; }
+    bool     isSingle()   const { return kind_ == Kind::Single; }   // half or float32
+    uint64_t uintValue()  const { return arg_; }                           // Unsigned
+    int64_t  intValue()   const { return -1 - static_cast<int64_t>(arg_); } // Negative
+
+    // Skip the value that follows the last Key token (or the remainder of
+    // the container whose Begin token was just returned when `inside`).
+    void skipValue(bool inside = false);
+
+    // Consume the next value and return its encoded bytes, e.g. to keep one
+    // entry of a document without decoding it.  Empty on error.
+    std::string_view rawValue();
+
+    bool failed() const { return failed_; }
+
+private:
+    enum class Kind { Unsigned, Negative, Single, Double };
+    struct Frame {
+        bool     map;
+        uint64_t remaining;   // items (keys and values) left; kIndefinite if unknown
+        bool     odd;         // in a map: a key was read, its value is next
+    };
+    static constexpr uint64_t kIndefinite = UINT64_MAX;
+
+    bool  readArg(uint8_t info, uint64_t& arg);
+    Token fail() { failed_ = true; return Token::Error; }
+
+    std::string_view   data_;
+    size_t             pos_ = 0;
+    std::vector<Frame> stack_;
+    std::string        str_;
+    Kind               kind_  = Kind::Unsigned;
+    uint64_t           arg_   = 0;
+    double             float_ = 0.0;
+    bool               failed_ = false;
+};
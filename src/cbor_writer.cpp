@@ -0,0 +1,72 @@
+#include "cbor_writer.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+CborWriter::CborWriter(std::string& out) : out_(out) {
+    out_.clear();
+}
+
+// Major type in the top three bits, the argument in the shortest of the
+// 0-23 / 1 / 2 / 4 / 8 byte forms, big endian.
+void CborWriter::head(uint8_t major, uint64_t arg) {
+    const char m = static_cast<char>(major << 5);
+    if (arg < 24) {
+        out_ += static_cast<char>(m | static_cast<char>(arg));
+        return;
+    }
+    int bytes;
+    if      (arg <= 0xff)        { out_ += static_cast<char>(m | 24); bytes = 1; }
+    else if (arg <= 0xffff)      { out_ += static_cast<char>(m | 25); bytes = 2; }
+    else if (arg <= 0xffffffffu) { out_ += static_cast<char>(m | 26); bytes = 4; }
+    else                         { out_ += static_cast<char>(m | 27); bytes = 8; }
+    for (int i = bytes - 1; i >= 0; --i) out_ += static_cast<char>((arg >> (8 * i)) & 0xff);
+}
+
+void CborWriter::value(std::string_view s) {
+    head(3, s.size());
+    out_.append(s.data(), s.size());
+}
+
+void CborWriter::value(int64_t v) {
+    if (v >= 0) head(0, static_cast<uint64_t>(v));
+    else        head(1, static_cast<uint64_t>(-(v + 1)));
+}
+
+void CborWriter::value(uint64_t v) {
+    head(0, v);
+}
+
+// Non-finite values become null, as in the JSON document; whole numbers
+// are written as integers.
+void CborWriter::value(float v) {
+    if (!std::isfinite(v)) { null(); return; }
+    if (std::fabs(v) < 16777216.0f && v == std::trunc(v)) {
+        value(static_cast<int64_t>(v));
+        return;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    out_ += '\xfa';
+    for (int i = 3; i >= 0; --i) out_ += static_cast<char>((bits >> (8 * i)) & 0xff);
+}
+
+// Whole numbers go out as integers (to_chars prints them without a
+// fraction in the JSON too) and anything a float holds exactly as float32,
+// so counters and idle percentages cost one to five bytes instead of nine.
+void CborWriter::value(double v) {
+    if (!std::isfinite(v)) { null(); return; }
+    if (std::fabs(v) < 9007199254740992.0 && v == std::trunc(v)) {
+        value(static_cast<int64_t>(v));
+        return;
+    }
+    if (std::fabs(v) <= FLT_MAX && static_cast<double>(static_cast<float>(v)) == v) {
+        value(static_cast<float>(v));
+        return;
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    out_ += '\xfb';
+    for (int i = 7; i >= 0; --i) out_ += static_cast<char>((bits >> (8 * i)) & 0xff);
+}
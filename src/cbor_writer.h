@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Streaming CBOR (RFC 8949) writer with the same interface as JsonWriter,
+// so the renderers in health_collector.cpp produce either format from the
+// same code.  Maps and arrays are written with indefinite length (0xbf /
+// 0x9f ... 0xff), which keeps the writer single pass; every other item has
+// its length up front, so a decoder can skip or slice values without
+// looking inside them.  Doubles are narrowed to an integer or float32
+// whenever that loses nothing.
+class CborWriter {
+public:
+    // Clears `out` (keeping its capacity).
+    explicit CborWriter(std::string& out);
+
+    void beginObject() { out_ += '\xbf'; }
+    void endObject()   { out_ += '\xff'; }
+    void beginArray()  { out_ += '\x9f'; }
+    void endArray()    { out_ += '\xff'; }
+
+    void key(std::string_view k) { value(k); }
+
+    void value(std::string_view s);
+    void value(const char* s) { value(std::string_view(s)); }
+    void value(const std::string& s) { value(std::string_view(s)); }
+    void value(double v);
+    void value(float v);
+    void value(int64_t v);
+    void value(uint64_t v);
+    void value(int v) { value(static_cast<int64_t>(v)); }
+    // Any other integer type (long / unsigned long are not int64_t /
+    // uint64_t on ILP32 targets such as armhf)
+    template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    void value(T v) {
+        if constexpr (std::is_signed_v<T>) value(static_cast<int64_t>(v));
+        else                               value(static_cast<uint64_t>(v));
+    }
+    void value(bool v) { out_ += v ? '\xf5' : '\xf4'; }
+    void null()        { out_ += '\xf6'; }
+
+    // An already encoded CBOR item (e.g. a slice of a cached document).
+    void rawValue(std::string_view cbor) { out_.append(cbor.data(), cbor.size()); }
+
+    template <typename T>
+    void field(std::string_view k, const T& v) {
+        key(k);
+        value(v);
+    }
+
+    // Bytes written so far; lets a caller record where an item starts.
+    size_t size() const { return out_.size(); }
+
+private:
+    void head(uint8_t major, uint64_t arg);
+
+    std::string& out_;
+};
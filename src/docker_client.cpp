@@ -0,0 +1,393 @@
+#include "docker_client.h"
+
+#include "health_collector.h"
+#include "json_reader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------
+// connection
+// ---------------------------------------------------------------------------
+
+DockerClient::DockerClient(std::string socketPath)
+    : socket_path_(std::move(socketPath)), rbuf_(16384) {}
+
+DockerClient::~DockerClient() {
+    closeSocket();
+}
+
+bool DockerClient::connectSocket() {
+    sockaddr_un addr{};
+    if (socket_path_.size() >= sizeof(addr.sun_path)) return false;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, socket_path_.c_str(), socket_path_.size() + 1);
+
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) return false;
+
+    // never let a wedged daemon hang the sampler
+    timeval tv{5, 0};
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    if (::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        closeSocket();
+        return false;
+    }
+    rpos_ = rlen_ = 0;
+    return true;
+}
+
+void DockerClient::closeSocket() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    rpos_ = rlen_ = 0;
+}
+
+// ---------------------------------------------------------------------------
+// buffered reading
+// ---------------------------------------------------------------------------
+
+bool DockerClient::fill() {
+    if (rpos_ == rlen_) rpos_ = rlen_ = 0;
+    if (rlen_ == rbuf_.size()) {
+        if (rpos_ == 0) rbuf_.resize(rbuf_.size() * 2);
+        else {
+            std::memmove(rbuf_.data(), rbuf_.data() + rpos_, rlen_ - rpos_);
+            rlen_ -= rpos_;
+            rpos_ = 0;
+        }
+    }
+    for (;;) {
+        ssize_t n = ::read(fd_, rbuf_.data() + rlen_, rbuf_.size() - rlen_);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        rlen_ += static_cast<size_t>(n);
+        return true;
+    }
+}
+
+bool DockerClient::readLine(std::string& line) {
+    line.clear();
+    for (;;) {
+        const char* start = rbuf_.data() + rpos_;
+        const void* nl    = std::memchr(start, '\n', rlen_ - rpos_);
+        if (nl) {
+            size_t len = static_cast<size_t>(static_cast<const char*>(nl) - start);
+            line.append(start, len);
+            rpos_ += len + 1;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            return true;
+        }
+        line.append(start, rlen_ - rpos_);
+        rpos_ = rlen_;
+        if (!fill()) return false;
+    }
+}
+
+bool DockerClient::readBody(size_t n, std::string& body) {
+    while (n > 0) {
+        if (rpos_ == rlen_ && !fill()) return false;
+        size_t take = std::min(n, rlen_ - rpos_);
+        body.append(rbuf_.data() + rpos_, take);
+        rpos_ += take;
+        n     -= take;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// HTTP/1.1 request / response
+// ---------------------------------------------------------------------------
+
+static bool startsWithNoCase(const std::string& s, const char* prefix) {
+    size_t n = std::strlen(prefix);
+    return s.size() >= n && strncasecmp(s.c_str(), prefix, n) == 0;
+}
+
+bool DockerClient::sendRequest(const std::string& target) {
+    sbuf_.clear();
+    sbuf_ += "GET ";
+    sbuf_ += target;
+    sbuf_ += " HTTP/1.1\r\nHost: docker\r\nUser-Agent: serverhealth\r\nAccept: application/json\r\n\r\n";
+
+    for (size_t off = 0; off < sbuf_.size();) {
+        ssize_t n = ::send(fd_, sbuf_.data() + off, sbuf_.size() - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        off += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool DockerClient::readHeaders(int& status, long& contentLength, bool& chunked, bool& closeAfter) {
+    std::string line;
+    if (!readLine(line) || line.size() < 12 || line.compare(0, 5, "HTTP/") != 0) return false;
+    status = std::atoi(line.c_str() + 9);
+
+    contentLength = -1;
+    chunked = closeAfter = false;
+    while (readLine(line)) {
+        if (line.empty()) return true;
+        if (startsWithNoCase(line, "Content-Length:"))
+            contentLength = std::atol(line.c_str() + 15);
+        else if (startsWithNoCase(line, "Transfer-Encoding:") && line.find("chunked") != std::string::npos)
+            chunked = true;
+        else if (startsWithNoCase(line, "Connection:") && line.find("close") != std::string::npos)
+            closeAfter = true;
+    }
+    return false;   // connection dropped inside the headers
+}
+
+bool DockerClient::request(const std::string& target, int& status, std::string& body) {
+    long contentLength;
+    bool chunked, closeAfter;
+    if (!sendRequest(target) || !readHeaders(status, contentLength, chunked, closeAfter))
+        return false;
+
+    std::string line;
+    body.clear();
+    if (chunked) {
+        for (;;) {
+            if (!readLine(line)) return false;
+            size_t size = std::strtoul(line.c_str(), nullptr, 16);
+            if (size == 0) {
+                while (readLine(line) && !line.empty()) {}   // trailers
+                break;
+            }
+            if (!readBody(size, body) || !readLine(line)) return false;
+        }
+    } else if (contentLength >= 0) {
+        if (!readBody(static_cast<size_t>(contentLength), body)) return false;
+    } else if (status != 204 && status != 304) {
+        // no framing: the body runs until the daemon closes the connection
+        body.append(rbuf_.data() + rpos_, rlen_ - rpos_);
+        rpos_ = rlen_;
+        while (fill()) {
+            body.append(rbuf_.data() + rpos_, rlen_ - rpos_);
+            rpos_ = rlen_;
+        }
+        closeAfter = true;
+    }
+
+    if (closeAfter) closeSocket();
+    return true;
+}
+
+int DockerClient::get(const std::string& target, std::string& body) {
+    // a kept-alive connection may have been closed by the daemon since the
+    // last call, so one failure on a reused socket earns a single retry
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        bool reused = fd_ >= 0;
+        if (!reused && !connectSocket()) return -1;
+        int status = 0;
+        if (request(target, status, body)) return status;
+        closeSocket();
+        if (!reused) break;
+    }
+    return -1;
+}
+
+bool DockerClient::listContainers(std::vector<DockerContainer>& out) {
+    std::string body;
+    if (get("/containers/json", body) != 200) return false;
+    return parseContainerList(body, out);
+}
+
+bool DockerClient::inspectContainer(const std::string& id, DockerContainer& out, std::time_t& startedAt) {
+    std::string body;
+    if (get("/containers/" + id + "/json", body) != 200) return false;
+    return parseInspectContainer(body, out, startedAt);
+}
+
+// ---------------------------------------------------------------------------
+// streaming responses
+// ---------------------------------------------------------------------------
+
+bool DockerClient::openStream(const std::string& target) {
+    closeSocket();   // a stream owns its connection for its whole lifetime
+    if (!connectSocket()) return false;
+
+    int  status;
+    long contentLength;
+    bool closeAfter;
+    if (!sendRequest(target) ||
+        !readHeaders(status, contentLength, stream_chunked_, closeAfter) || status != 200) {
+        closeSocket();
+        return false;
+    }
+    stream_remaining_ = 0;
+    return true;
+}
+
+int DockerClient::readStream(std::string& out, int idleMs) {
+    if (fd_ < 0) return -1;
+    if (rpos_ == rlen_) {
+        pollfd pfd{fd_, POLLIN, 0};
+        int r = ::poll(&pfd, 1, idleMs);
+        if (r == 0 || (r < 0 && errno == EINTR)) return 0;
+        if (r < 0 || !fill()) { closeSocket(); return -1; }
+    }
+
+    if (!stream_chunked_) {
+        out.append(rbuf_.data() + rpos_, rlen_ - rpos_);
+        rpos_ = rlen_;
+        return 1;
+    }
+
+    // The daemon flushes each event as one chunk, so a chunk header is
+    // never split across an idle period in practice.
+    if (stream_remaining_ == 0) {
+        std::string line;
+        if (!readLine(line)) { closeSocket(); return -1; }
+        if (line.empty() && !readLine(line)) { closeSocket(); return -1; }   // CRLF after a chunk
+        stream_remaining_ = std::strtoul(line.c_str(), nullptr, 16);
+        if (stream_remaining_ == 0) { closeSocket(); return -1; }
+        if (rpos_ == rlen_ && !fill()) { closeSocket(); return -1; }
+    }
+    size_t take = std::min(stream_remaining_, rlen_ - rpos_);
+    out.append(rbuf_.data() + rpos_, take);
+    rpos_             += take;
+    stream_remaining_ -= take;
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// response parsing
+// ---------------------------------------------------------------------------
+
+std::string extractHealth(const std::string& status) {
+    // State.Health.Status values: "starting", "healthy", "unhealthy";
+    // containers without a health check have no Health object at all.
+    if (status == "healthy")   return "healthy";
+    if (status == "unhealthy") return "unhealthy";
+    if (status == "starting")  return "starting";
+    return "none";
+}
+
+// Read the "Status" member of the object whose BeginObject was just consumed.
+static std::string readHealthObject(JsonReader& r) {
+    std::string status;
+    for (auto t = r.next(); t == JsonReader::Token::Key; t = r.next()) {
+        if (r.str() == "Status") {
+            if (r.next() == JsonReader::Token::String) status = r.str();
+        } else {
+            r.skipValue();
+        }
+    }
+    return status;
+}
+
+bool parseContainerList(std::string_view body, std::vector<DockerContainer>& out) {
+    using T = JsonReader::Token;
+    JsonReader r(body);
+    if (r.next() != T::BeginArray) return false;
+
+    for (auto t = r.next(); t == T::BeginObject; t = r.next()) {
+        DockerContainer c;
+        bool haveHealth = false;
+        for (auto k = r.next(); k == T::Key; k = r.next()) {
+            const std::string& key = r.str();
+            if (key == "Id") {
+                if (r.next() != T::String) continue;
+                c.full_id = r.str();
+                c.id      = c.full_id.substr(0, 12);   // short id, as docker ps
+            } else if (key == "Image") {
+                if (r.next() == T::String) c.image = r.str();
+            } else if (key == "State") {
+                if (r.next() == T::String) c.state = r.str();
+            } else if (key == "Status") {
+                if (r.next() == T::String) c.status = r.str();
+            } else if (key == "Names") {
+                if (r.next() != T::BeginArray) continue;
+                for (auto n = r.next(); n == T::String; n = r.next()) {
+                    std::string_view name = r.str();
+                    if (!name.empty() && name.front() == '/') name.remove_prefix(1);
+                    if (!c.names.empty()) c.names += ',';
+                    c.names += name;
+                }
+            } else if (key == "Health") {
+                // present in container summaries on newer Engine API versions
+                if (r.next() != T::BeginObject) continue;
+                c.health   = extractHealth(readHealthObject(r));
+                haveHealth = true;
+            } else {
+                r.skipValue();
+            }
+        }
+        if (!haveHealth) c.health.clear();   // caller falls back to inspect
+        if (!c.id.empty()) out.push_back(std::move(c));
+    }
+    return !r.failed();
+}
+
+// "2024-05-01T12:34:56.789012345Z" → unix time; Docker reports UTC.
+static std::time_t parseDockerTime(const std::string& s) {
+    std::tm tm{};
+    if (s.size() < 19 ||
+        std::sscanf(s.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d",
+                    &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                    &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+        return 0;
+    if (tm.tm_year < 1971) return 0;   // "0001-01-01T00:00:00Z" = never started
+    tm.tm_year -= 1900;
+    tm.tm_mon  -= 1;
+    return timegm(&tm);
+}
+
+bool parseInspectContainer(std::string_view body, DockerContainer& out, std::time_t& startedAt) {
+    using T = JsonReader::Token;
+    JsonReader r(body);
+    if (r.next() != T::BeginObject) return false;
+
+    std::string health;
+    startedAt = 0;
+    for (auto k = r.next(); k == T::Key; k = r.next()) {
+        const std::string& key = r.str();
+        if (key == "Id") {
+            if (r.next() != T::String) continue;
+            out.full_id = r.str();
+            out.id      = out.full_id.substr(0, 12);
+        } else if (key == "Name") {
+            if (r.next() != T::String) continue;
+            std::string_view name = r.str();
+            if (!name.empty() && name.front() == '/') name.remove_prefix(1);
+            out.names = std::string(name);
+        } else if (key == "Config") {
+            if (r.next() != T::BeginObject) continue;
+            for (auto c = r.next(); c == T::Key; c = r.next()) {
+                if (r.str() != "Image") { r.skipValue(); continue; }
+                if (r.next() == T::String) out.image = r.str();
+            }
+        } else if (key == "State") {
+            if (r.next() != T::BeginObject) continue;
+            for (auto s = r.next(); s == T::Key; s = r.next()) {
+                const std::string& sk = r.str();
+                if (sk == "Status") {
+                    if (r.next() == T::String) out.state = r.str();
+                } else if (sk == "StartedAt") {
+                    if (r.next() == T::String) startedAt = parseDockerTime(r.str());
+                } else if (sk == "Health") {
+                    if (r.next() == T::BeginObject) health = readHealthObject(r);
+                } else {
+                    r.skipValue();
+                }
+            }
+        } else {
+            r.skipValue();
+        }
+    }
+    out.health = extractHealth(health);
+    return !r.failed() && !out.id.empty();
+}
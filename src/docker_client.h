@@ -0,0 +1,64 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct DockerContainer;
+
+// Minimal HTTP/1.1 client for the Docker Engine API on its unix socket.
+// One connection is kept alive between calls and transparently re-opened
+// when the daemon closes it, so a sample costs a write and a read instead
+// of a fork/exec of the docker CLI.
+class DockerClient {
+public:
+    explicit DockerClient(std::string socketPath);
+    ~DockerClient();
+
+    DockerClient(const DockerClient&)            = delete;
+    DockerClient& operator=(const DockerClient&) = delete;
+
+    // GET `target`; returns the HTTP status, or -1 on a transport error.
+    int get(const std::string& target, std::string& body);
+
+    // GET /containers/json  –  running containers, like `docker ps`
+    bool listContainers(std::vector<DockerContainer>& out);
+    // GET /containers/{id}/json
+    bool inspectContainer(const std::string& id, DockerContainer& out, std::time_t& startedAt);
+
+    // Long-lived responses such as /events: openStream() sends the request
+    // and consumes the headers; readStream() then appends body data as it
+    // arrives.  readStream() returns 1 when data was appended, 0 when
+    // nothing arrived within `idleMs`, and -1 once the stream has ended.
+    bool openStream(const std::string& target);
+    int  readStream(std::string& out, int idleMs);
+
+private:
+    bool connectSocket();
+    void closeSocket();
+    bool request(const std::string& target, int& status, std::string& body);
+    bool fill();
+    bool readLine(std::string& line);
+    bool readBody(size_t n, std::string& body);
+    bool sendRequest(const std::string& target);
+    bool readHeaders(int& status, long& contentLength, bool& chunked, bool& closeAfter);
+
+    std::string       socket_path_;
+    int               fd_ = -1;
+    std::string       sbuf_;
+    std::vector<char> rbuf_;
+    size_t            rpos_ = 0;
+    size_t            rlen_ = 0;
+
+    bool              stream_chunked_   = false;
+    size_t            stream_remaining_ = 0;   // bytes left in the current chunk
+};
+
+// Append the containers of a /containers/json response body to `out`.
+bool parseContainerList(std::string_view body, std::vector<DockerContainer>& out);
+// Fill `out` from a /containers/{id}/json response body.  startedAt is
+// State.StartedAt as unix time (0 if unknown).
+bool parseInspectContainer(std::string_view body, DockerContainer& out, std::time_t& startedAt);
+// Normalise a Docker health status to healthy / unhealthy / starting / none.
+std::string extractHealth(const std::string& status);
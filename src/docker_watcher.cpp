@@ -0,0 +1,206 @@
+#include "docker_watcher.h"
+
+#include "json_reader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+// /events?filters={"type":["container"]}
+static const char* kEventsTarget = "/events?filters=%7B%22type%22%3A%5B%22container%22%5D%7D";
+
+DockerWatcher::DockerWatcher(const std::string& socketPath)
+    : api_(socketPath), events_(socketPath), table_(std::make_shared<const Table>()) {}
+
+DockerWatcher::~DockerWatcher() {
+    stop();
+}
+
+void DockerWatcher::start() {
+    if (thread_.joinable()) return;
+    stopping_ = false;
+    thread_ = std::thread([this]() { run(); });
+}
+
+void DockerWatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+std::shared_ptr<const DockerWatcher::Table> DockerWatcher::table() const {
+    return std::atomic_load(&table_);
+}
+
+void DockerWatcher::waitFor(std::chrono::seconds d) {
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_.wait_for(lock, d, [this]() { return stopping_.load(); });
+}
+
+// ---------------------------------------------------------------------------
+// watcher loop  –  subscribe, resync once, then apply events until the
+// stream drops; reconnect with exponential backoff
+// ---------------------------------------------------------------------------
+
+void DockerWatcher::run() {
+    auto backoff = std::chrono::seconds(1);
+    std::string pending;
+    while (!stopping_) {
+        // Subscribe before listing so nothing that happens during the
+        // resync is missed; those events are simply replayed afterwards.
+        if (!events_.openStream(kEventsTarget) || !resync()) {
+            connected_ = false;
+            waitFor(backoff);
+            backoff = std::min(backoff * 2, std::chrono::seconds(30));
+            continue;
+        }
+        connected_ = true;
+        backoff    = std::chrono::seconds(1);
+        pending.clear();
+
+        while (!stopping_) {
+            int r = events_.readStream(pending, 1000);
+            if (r < 0) break;
+            if (r == 0) continue;
+            // the daemon writes one JSON object per line
+            size_t start = 0, nl;
+            while ((nl = pending.find('\n', start)) != std::string::npos) {
+                handleEvent(std::string_view(pending).substr(start, nl - start));
+                start = nl + 1;
+            }
+            pending.erase(0, start);
+        }
+        connected_ = false;
+    }
+}
+
+bool DockerWatcher::resync() {
+    std::vector<DockerContainer> list;
+    if (!api_.listContainers(list)) return false;
+
+    containers_.clear();
+    for (const auto& c : list) {
+        Entry e;
+        e.container = c;
+        // inspect fills the health status and start time the summary lacks
+        api_.inspectContainer(c.id, e.container, e.started_at);
+        e.container.names = c.names;   // the summary lists every name
+        containers_[c.id] = std::move(e);
+    }
+    publish();
+    return true;
+}
+
+void DockerWatcher::refresh(const std::string& id) {
+    Entry e;
+    if (!api_.inspectContainer(id, e.container, e.started_at)) return;
+    if (e.container.state == "running" || e.container.state == "paused")
+        containers_[e.container.id] = std::move(e);
+    else
+        containers_.erase(e.container.id);
+}
+
+void DockerWatcher::handleEvent(std::string_view json) {
+    using T = JsonReader::Token;
+    JsonReader r(json);
+    if (r.next() != T::BeginObject) return;
+
+    std::string action, id, name;
+    for (auto k = r.next(); k == T::Key; k = r.next()) {
+        if (r.str() == "Action") {
+            if (r.next() == T::String) action = r.str();
+        } else if (r.str() == "Actor") {
+            if (r.next() != T::BeginObject) continue;
+            for (auto a = r.next(); a == T::Key; a = r.next()) {
+                if (r.str() == "ID") {
+                    if (r.next() == T::String) id = r.str().substr(0, 12);
+                } else if (r.str() == "Attributes") {
+                    if (r.next() != T::BeginObject) continue;
+                    for (auto at = r.next(); at == T::Key; at = r.next()) {
+                        if (r.str() != "name") { r.skipValue(); continue; }
+                        if (r.next() == T::String) name = r.str();
+                    }
+                } else {
+                    r.skipValue();
+                }
+            }
+        } else {
+            r.skipValue();
+        }
+    }
+    if (id.empty()) return;
+
+    auto it = containers_.find(id);
+    if (action == "start") {
+        refresh(id);
+    } else if (action == "die" || action == "stop" || action == "destroy") {
+        if (it == containers_.end()) return;
+        containers_.erase(it);
+    } else if (action.rfind("health_status", 0) == 0) {
+        // "health_status: healthy"
+        if (it == containers_.end()) return;
+        auto colon = action.find(':');
+        std::string status = colon == std::string::npos ? "" : action.substr(colon + 1);
+        status.erase(0, status.find_first_not_of(' '));
+        it->second.container.health = extractHealth(status);
+    } else if (action == "pause" || action == "unpause") {
+        if (it == containers_.end()) return;
+        it->second.container.state = (action == "pause") ? "paused" : "running";
+    } else if (action == "rename") {
+        if (it == containers_.end() || name.empty()) return;
+        it->second.container.names = name;
+    } else {
+        return;
+    }
+    publish();
+}
+
+void DockerWatcher::publish() {
+    auto table = std::make_shared<Table>();
+    table->reserve(containers_.size());
+    for (const auto& kv : containers_) table->push_back(kv.second);
+    // newest first, like docker ps
+    std::sort(table->begin(), table->end(), [](const Entry& a, const Entry& b) {
+        return a.started_at != b.started_at ? a.started_at > b.started_at
+                                            : a.container.id < b.container.id;
+    });
+    std::atomic_store(&table_, std::shared_ptr<const Table>(std::move(table)));
+}
+
+// ---------------------------------------------------------------------------
+// status text  –  mirrors the Docker CLI's human-readable durations
+// ---------------------------------------------------------------------------
+
+static std::string humanDuration(long seconds) {
+    auto plural = [](long n, const char* unit) {
+        return std::to_string(n) + " " + unit + (n == 1 ? "" : "s");
+    };
+    if (seconds < 1)  return "Less than a second";
+    if (seconds < 60) return plural(seconds, "second");
+    long minutes = seconds / 60;
+    if (minutes == 1) return "About a minute";
+    if (minutes < 60) return plural(minutes, "minute");
+    long hours = (seconds + 1800) / 3600;
+    if (hours == 1)   return "About an hour";
+    if (hours < 48)   return plural(hours, "hour");
+    if (hours < 24 * 7 * 2)   return plural(hours / 24, "day");
+    if (hours < 24 * 30 * 2)  return plural(hours / 24 / 7, "week");
+    if (hours < 24 * 365 * 2) return plural(hours / 24 / 30, "month");
+    return plural(hours / 24 / 365, "year");
+}
+
+std::string formatContainerStatus(const DockerContainer& c, std::time_t startedAt, std::time_t now) {
+    std::string s = "Up";
+    if (startedAt > 0) {
+        s += ' ';
+        s += humanDuration(static_cast<long>(now - startedAt));
+    }
+    if      (c.health == "healthy")   s += " (healthy)";
+    else if (c.health == "unhealthy") s += " (unhealthy)";
+    else if (c.health == "starting")  s += " (health: starting)";
+    if (c.state == "paused") s += " (Paused)";
+    return s;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "docker_client.h"
+#include "health_collector.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Keeps an in-memory table of running containers up to date from the
+// Docker /events stream.  The full list is fetched only when the stream is
+// (re)connected; after that each start/stop/die/health_status event patches
+// a single entry.  Readers get an immutable copy of the table through one
+// atomic shared_ptr load and never wait on the watcher thread.
+class DockerWatcher {
+public:
+    struct Entry {
+        DockerContainer container;        // status is rendered at read time
+        std::time_t     started_at = 0;
+    };
+    using Table = std::vector<Entry>;
+
+    explicit DockerWatcher(const std::string& socketPath);
+    ~DockerWatcher();
+
+    DockerWatcher(const DockerWatcher&)            = delete;
+    DockerWatcher& operator=(const DockerWatcher&) = delete;
+
+    void start();
+    void stop();
+
+    std::shared_ptr<const Table> table() const;
+    bool connected() const { return connected_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    bool resync();
+    void handleEvent(std::string_view json);
+    void refresh(const std::string& id);
+    void publish();
+    void waitFor(std::chrono::seconds d);
+
+    DockerClient api_;      // list / inspect
+    DockerClient events_;   // long-lived /events stream
+
+    // Owned by the watcher thread; keyed by short container id.
+    std::unordered_map<std::string, Entry> containers_;
+
+    // Published with std::atomic_store / read with std::atomic_load.
+    std::shared_ptr<const Table> table_;
+
+    std::atomic<bool>       connected_{false};
+    std::atomic<bool>       stopping_{false};
+    std::mutex              wake_mutex_;
+    std::condition_variable wake_;
+    std::thread             thread_;
+};
+
+// "Up 2 hours (healthy)"  –  the status text `docker ps` would show.
+std::string formatContainerStatus(const DockerContainer& c, std::time_t startedAt, std::time_t now);
@@ -0,0 +1,271 @@
+#include "ebpf_collector.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#ifdef SERVERHEALTH_HAVE_EBPF
+#include "kernel_latency.h"
+#include "kernel_latency.skel.h"
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#endif
+
+EbpfCollector::~EbpfCollector() = default;
+
+bool EbpfCollector::available() const {
+    return impl_ != nullptr;
+}
+
+// "sda" for 8:0, from the /sys/dev/block/<major>:<minor> link
+const std::string& EbpfCollector::deviceName(uint32_t dev) {
+    auto it = device_names_.find(dev);
+    if (it != device_names_.end()) return it->second;
+    std::string link = sys_path_ + "/dev/block/" + std::to_string(dev >> 20) + ":" + std::to_string(dev & 0xfffff);
+    char    target[256];
+    ssize_t n = ::readlink(link.c_str(), target, sizeof(target) - 1);
+    std::string name;
+    if (n > 0) {
+        std::string_view t(target, static_cast<size_t>(n));
+        name.assign(t.substr(t.rfind('/') + 1));
+    }
+    return device_names_.emplace(dev, std::move(name)).first->second;
+}
+
+#ifdef SERVERHEALTH_HAVE_EBPF
+
+static_assert(KL_SLOTS == kLatencyBuckets, "bucket layout differs from the eBPF programs'");
+
+struct EbpfCollector::Impl {
+    kernel_latency_bpf* skel = nullptr;
+    int                 cpus = 0;   // possible CPUs: per-CPU values come in this many
+
+    // scratch for the map reads, kept between samples
+    std::vector<uint32_t> dev_keys;
+    std::vector<uint64_t> cgroup_keys;
+    std::vector<kl_hist>  values;
+    std::vector<uint64_t> counts;
+
+    ~Impl() { kernel_latency_bpf__destroy(skel); }
+};
+
+EbpfCollector::EbpfCollector(std::string sysPath) : sys_path_(std::move(sysPath)) {
+    auto impl = std::make_unique<Impl>();
+    libbpf_set_print(nullptr);   // the reason lands in error()
+    impl->skel = kernel_latency_bpf__open();
+    if (!impl->skel) {
+        error_ = std::string("open: ") + std::strerror(errno);
+        return;
+    }
+    if (int err = kernel_latency_bpf__load(impl->skel)) {
+        error_ = std::string("load: ") + std::strerror(-err);
+        if (err == -EPERM) error_ += " (needs CAP_BPF and CAP_PERFMON, or root)";
+        return;
+    }
+    if (int err = kernel_latency_bpf__attach(impl->skel)) {
+        error_ = std::string("attach: ") + std::strerror(-err);
+        return;
+    }
+    impl->cpus = libbpf_num_possible_cpus();
+    if (impl->cpus <= 0) {
+        error_ = "cannot count the possible CPUs";
+        return;
+    }
+    impl_ = std::move(impl);
+}
+
+// ---------------------------------------------------------------------------
+// distributions  –  cumulative buckets to the figures since the last read
+// ---------------------------------------------------------------------------
+
+static void addHist(const kl_hist& h, LatencyDistribution& d) {
+    for (int i = 0; i < kLatencyBuckets; ++i) d.buckets[i] += h.slots[i];
+    d.sum_us += static_cast<double>(h.sum_ns) / 1e3;
+}
+
+// Latency below which a share `q` of the interval's samples fell,
+// interpolated inside its bucket
+static double quantileUs(const uint64_t (&delta)[kLatencyBuckets], uint64_t count, double q) {
+    double   rank = q * static_cast<double>(count);
+    uint64_t seen = 0;
+    for (int i = 0; i < kLatencyBuckets; ++i) {
+        if (!delta[i]) continue;
+        if (static_cast<double>(seen + delta[i]) >= rank) {
+            double lo = i == 0 ? 0.0 : std::ldexp(1.0, i);
+            double hi = std::ldexp(1.0, i + 1);
+            return lo + (hi - lo) * (rank - static_cast<double>(seen)) / static_cast<double>(delta[i]);
+        }
+        seen += delta[i];
+    }
+    return std::ldexp(1.0, kLatencyBuckets);
+}
+
+// `d` holds a new cumulative reading; fill in the interval since `prev`
+static void finishDistribution(LatencyDistribution& d, const LatencyDistribution* prev) {
+    d.total = 0;
+    for (uint64_t b : d.buckets) d.total += b;
+    // counts that went backwards (a cgroup id or device reused) start over
+    bool reset = !prev || prev->total > d.total;
+    uint64_t delta[kLatencyBuckets];
+    d.count = 0;
+    for (int i = 0; i < kLatencyBuckets; ++i) {
+        delta[i] = reset ? d.buckets[i] : d.buckets[i] - std::min(prev->buckets[i], d.buckets[i]);
+        d.count += delta[i];
+    }
+    d.mean_us = d.p50_us = d.p99_us = 0.0;
+    if (!d.count) return;
+    d.mean_us = (reset ? d.sum_us : d.sum_us - prev->sum_us) / static_cast<double>(d.count);
+    d.p50_us  = quantileUs(delta, d.count, 0.50);
+    d.p99_us  = quantileUs(delta, d.count, 0.99);
+}
+
+// ---------------------------------------------------------------------------
+// map reads
+// ---------------------------------------------------------------------------
+
+// Every entry of hash map `fd`, `perKey` values each: BPF_MAP_LOOKUP_BATCH
+// (one call for the whole table as long as it fits), or walking the keys
+// on kernels before 5.6
+template <typename K>
+static bool readHash(int fd, size_t maxEntries, size_t perKey, std::vector<K>& keys, std::vector<kl_hist>& values) {
+    keys.resize(maxEntries);
+    values.resize(maxEntries * perKey);
+    size_t got   = 0;
+    bool   first = true;
+    K      batch{};
+    for (;;) {
+        __u32 n = static_cast<__u32>(maxEntries - got);
+        int err = bpf_map_lookup_batch(fd, first ? nullptr : &batch, &batch, keys.data() + got,
+                                       values.data() + got * perKey, &n, nullptr);
+        if (err < 0 && errno != ENOENT) {
+            if (!first || (errno != EINVAL && errno != ENOTSUP && errno != EOPNOTSUPP)) return false;
+            break;   // no batch support: walk below
+        }
+        got  += n;
+        first = false;
+        if (err < 0 || got >= maxEntries) {   // ENOENT: that was the last batch
+            keys.resize(got);
+            values.resize(got * perKey);
+            return true;
+        }
+    }
+
+    got = 0;
+    K* prev = nullptr;
+    while (got < maxEntries && bpf_map_get_next_key(fd, prev, &keys[got]) == 0) {
+        if (bpf_map_lookup_elem(fd, &keys[got], values.data() + got * perKey) == 0) {
+            prev = &keys[got];
+            ++got;
+        } else {
+            // deleted between the two calls: carry on from the copy
+            batch = keys[got];
+            prev  = &batch;
+        }
+    }
+    keys.resize(got);
+    values.resize(got * perKey);
+    return true;
+}
+
+void EbpfCollector::read(KernelLatency& out, const std::unordered_map<uint64_t, std::string>& cgroups) {
+    out.available = available();
+    out.error     = error_;
+    if (!impl_) return;
+    Impl&        m   = *impl_;
+    const size_t ncpu = static_cast<size_t>(m.cpus);
+    auto         now = std::chrono::steady_clock::now();
+    uint32_t     zero = 0;
+
+    // block I/O: per-CPU values, summed per disk
+    bpf_map* io = m.skel->maps.io_hist;
+    if (readHash(bpf_map__fd(io), bpf_map__max_entries(io), ncpu, m.dev_keys, m.values)) {
+        for (size_t k = 0; k < m.dev_keys.size(); ++k) {
+            uint32_t dev = m.dev_keys[k];
+            const std::string& name = dev ? deviceName(dev) : std::string();
+            if (name.empty()) continue;
+            DeviceLatency d;
+            d.name = name;
+            for (size_t c = 0; c < ncpu; ++c) addHist(m.values[k * ncpu + c], d.io);
+            LatencyDistribution& prev = prev_block_[dev];
+            finishDistribution(d.io, prev.total ? &prev : nullptr);
+            prev = d.io;
+            out.block.push_back(std::move(d));
+        }
+        std::sort(out.block.begin(), out.block.end(),
+                  [](const DeviceLatency& a, const DeviceLatency& b) { return a.name < b.name; });
+    }
+
+    // run queue: one lookup returns every CPU's histogram
+    m.values.resize(ncpu);
+    if (bpf_map_lookup_elem(bpf_map__fd(m.skel->maps.runq_hist), &zero, m.values.data()) == 0) {
+        prev_cpu_.resize(ncpu);
+        LatencyDistribution all;
+        for (size_t c = 0; c < ncpu; ++c) {
+            CpuLatency cpu;
+            cpu.cpu = static_cast<int>(c);
+            addHist(m.values[c], cpu.runq);
+            addHist(m.values[c], all);
+            finishDistribution(cpu.runq, &prev_cpu_[c]);
+            prev_cpu_[c] = cpu.runq;
+            if (cpu.runq.total) out.cpus.push_back(std::move(cpu));   // possible but never online: left out
+        }
+        finishDistribution(all, &prev_runq_);
+        prev_runq_ = all;
+        out.runq   = all;
+    }
+
+    // cgroups: one shared table, a single value per key
+    if (!cgroups.empty()) {
+        bpf_map* cg = m.skel->maps.cgroup_runq;
+        std::unordered_map<uint64_t, LatencyDistribution> seen;
+        if (readHash(bpf_map__fd(cg), bpf_map__max_entries(cg), 1, m.cgroup_keys, m.values)) {
+            for (size_t k = 0; k < m.cgroup_keys.size(); ++k) {
+                auto name = cgroups.find(m.cgroup_keys[k]);
+                if (name == cgroups.end()) continue;
+                CgroupLatency c;
+                c.name = name->second;
+                addHist(m.values[k], c.runq);
+                auto prev = prev_cgroup_.find(name->first);
+                finishDistribution(c.runq, prev == prev_cgroup_.end() ? nullptr : &prev->second);
+                seen.emplace(name->first, c.runq);
+                out.containers.push_back(std::move(c));
+            }
+            std::sort(out.containers.begin(), out.containers.end(),
+                      [](const CgroupLatency& a, const CgroupLatency& b) { return a.name < b.name; });
+        }
+        prev_cgroup_ = std::move(seen);
+    }
+
+    m.counts.assign(ncpu, 0);
+    if (bpf_map_lookup_elem(bpf_map__fd(m.skel->maps.retransmits), &zero, m.counts.data()) == 0) {
+        uint64_t total = 0;
+        for (uint64_t n : m.counts) total += n;
+        double dt = std::chrono::duration<double>(now - prev_time_).count();
+        if (prev_time_.time_since_epoch().count() && dt > 0.0 && total >= prev_retransmits_)
+            out.tcp_retransmits_per_sec = static_cast<double>(total - prev_retransmits_) / dt;
+        out.tcp_retransmits = total;
+        prev_retransmits_   = total;
+    }
+    prev_time_ = now;
+}
+
+#else  // SERVERHEALTH_HAVE_EBPF
+
+struct EbpfCollector::Impl {};
+
+EbpfCollector::EbpfCollector(std::string sysPath)
+    : sys_path_(std::move(sysPath)), error_("built without SERVERHEALTH_EBPF") {}
+
+void EbpfCollector::read(KernelLatency& out, const std::unordered_map<uint64_t, std::string>&) {
+    out.available = false;
+    out.error     = error_;
+}
+
+#endif  // SERVERHEALTH_HAVE_EBPF
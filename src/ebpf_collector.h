@@ -0,0 +1,57 @@
+#pragma once
+
+#include "health_collector.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Latency histograms kept in the kernel by the eBPF programs of
+// bpf/kernel_latency.bpf.c: block requests from issue to completion per
+// disk, the wait from wakeup to running per CPU and per cgroup, and TCP
+// retransmits.
+//
+// The programs only bump counters in maps (per CPU where the key allows
+// it), so the traced paths pay a map lookup and an increment.  read()
+// fetches each map with one batched lookup, once per sample, and turns the
+// cumulative counts into the distribution since the previous read.
+//
+// Only built with -DSERVERHEALTH_EBPF=ON (libbpf; CO-RE, so the kernel
+// needs BTF); without it, or without CAP_BPF and CAP_PERFMON, available()
+// is false and error() says why.  Sampler thread only.
+class EbpfCollector {
+public:
+    explicit EbpfCollector(std::string sysPath);
+    ~EbpfCollector();
+
+    EbpfCollector(const EbpfCollector&)            = delete;
+    EbpfCollector& operator=(const EbpfCollector&) = delete;
+
+    bool               available() const;
+    const std::string& error() const { return error_; }
+
+    // `cgroups`: cgroup id -> name of the cgroups to report in
+    // out.containers; the others stay in the kernel's table only.
+    void read(KernelLatency& out, const std::unordered_map<uint64_t, std::string>& cgroups);
+
+private:
+    struct Impl;
+
+    const std::string& deviceName(uint32_t dev);
+
+    std::string           sys_path_;
+    std::string           error_;
+    std::unique_ptr<Impl> impl_;
+
+    // previous cumulative readings, for the per-sample distributions
+    std::unordered_map<uint32_t, LatencyDistribution> prev_block_;   // by dev
+    std::unordered_map<uint64_t, LatencyDistribution> prev_cgroup_;  // by cgroup id
+    std::vector<LatencyDistribution>                  prev_cpu_;
+    LatencyDistribution                               prev_runq_;
+    uint64_t                                          prev_retransmits_ = 0;
+    std::chrono::steady_clock::time_point             prev_time_;
+    std::unordered_map<uint32_t, std::string>         device_names_;
+};
@@ -0,0 +1,848 @@
+#include "fleet.h"
+
+#include "cbor_reader.h"
+#include "health_collector.h"
+#include "json_writer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <utility>
+
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Summaries are re-rendered at most this often while answers trickle in
+static constexpr auto kPublishEvery = std::chrono::milliseconds(250);
+static constexpr auto kMaxBackoff   = std::chrono::seconds(30);
+
+// Field that identifies an entry of each list group, as entryKey() in
+// health_collector.cpp; empty for groups that are a single object
+static const char* const kEntryKeys[kMetricGroupCount] = {
+    "", "", "path", "name", "name", "zone", "id", "", "", "pid", "",
+};
+
+struct FleetAggregator::Peer {
+    std::string name;   // as configured, also sent as Host
+    std::string host;
+    std::string port;
+
+    // connection
+    enum class State { Idle, Connecting, Writing, Reading };
+    State             state = State::Idle;
+    int               fd    = -1;
+    bool              reused = false;   // the request went out on a kept-alive connection
+    sockaddr_storage  addr{};
+    socklen_t         addr_len = 0;     // 0: resolve before connecting
+    std::string       request;
+    size_t            sent = 0;
+    std::string       response;
+    Clock::time_point started{};
+    Clock::time_point deadline{};
+    Clock::time_point next_poll{};
+    int               failures_in_row = 0;
+
+    // status, shown in /api/fleet
+    bool        up = false;
+    std::string error = "not polled yet";
+    uint64_t    polls = 0;
+    uint64_t    failures = 0;
+    int64_t     last_seen_ms = -1;
+    double      latency_ms = NAN;
+
+    // merged document: every entry kept as the CBOR it arrived in
+    uint64_t    sequence = 0;   // 0: ask for the whole document
+    uint64_t    instance = 0;
+    std::string timestamp;
+    uint32_t    groups = 0;
+    std::string objects[kMetricGroupCount];                                 // cpu, memory ...
+    std::vector<std::pair<std::string, std::string>> lists[kMetricGroupCount];  // key, entry
+
+    // from the document, refreshed after each change
+    double  cpu_percent = NAN, memory_percent = NAN, memory_total_kb = NAN, disk_max_percent = NAN;
+    double  rx_bytes_per_sec = NAN, tx_bytes_per_sec = NAN, temperature_max = NAN;
+    int64_t containers = -1, containers_running = 0;
+};
+
+// ---------------------------------------------------------------------------
+// peers
+// ---------------------------------------------------------------------------
+
+static bool parsePort(std::string_view s) {
+    unsigned v = 0;
+    auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+    return !s.empty() && r.ec == std::errc() && r.ptr == s.data() + s.size() && v > 0 && v < 65536;
+}
+
+// "[::1]:9091" -> "::1", "9091"; "host" -> "host", "9091"
+static bool splitPeer(std::string_view peer, std::string& host, std::string& port) {
+    std::string_view h = peer, p = "9091";
+    if (!peer.empty() && peer.front() == '[') {
+        size_t close = peer.find(']');
+        if (close == std::string_view::npos) return false;
+        h = peer.substr(1, close - 1);
+        std::string_view rest = peer.substr(close + 1);
+        if (!rest.empty()) {
+            if (rest.front() != ':') return false;
+            p = rest.substr(1);
+        }
+    } else {
+        size_t colon = peer.rfind(':');
+        if (colon != std::string_view::npos) {
+            h = peer.substr(0, colon);
+            p = peer.substr(colon + 1);
+        }
+    }
+    if (h.empty() || !parsePort(p)) return false;
+    host.assign(h);
+    port.assign(p);
+    return true;
+}
+
+bool parseFleetPeers(std::string_view list, std::vector<std::string>& out) {
+    out.clear();
+    std::string host, port;
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view peer = list.substr(0, comma);
+        while (!peer.empty() && peer.front() == ' ') peer.remove_prefix(1);
+        while (!peer.empty() && peer.back()  == ' ') peer.remove_suffix(1);
+        if (!splitPeer(peer, host, port)) return false;
+        out.emplace_back(peer);
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return !out.empty();
+}
+
+FleetAggregator::FleetAggregator(FleetOptions options)
+    : options_(std::move(options)), latest_(std::make_shared<const FleetSnapshot>()) {
+    for (const std::string& name : options_.peers) {
+        auto p  = std::make_unique<Peer>();
+        p->name = name;
+        splitPeer(name, p->host, p->port);
+        peers_.push_back(std::move(p));
+    }
+}
+
+FleetAggregator::~FleetAggregator() {
+    stop();
+}
+
+void FleetAggregator::start() {
+    if (thread_.joinable()) return;
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event ev{};
+    ev.events   = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+    stopping_ = false;
+    thread_ = std::thread([this]() { run(); });
+}
+
+void FleetAggregator::stop() {
+    stopping_ = true;
+    if (wake_fd_ >= 0) {
+        uint64_t one = 1;
+        (void)::write(wake_fd_, &one, sizeof(one));
+    }
+    if (thread_.joinable()) thread_.join();
+    for (auto& p : peers_) closeConnection(*p);
+    if (wake_fd_ >= 0)  ::close(wake_fd_);
+    if (epoll_fd_ >= 0) ::close(epoll_fd_);
+    wake_fd_ = epoll_fd_ = -1;
+}
+
+std::shared_ptr<const FleetSnapshot> FleetAggregator::latest() const {
+    return std::atomic_load(&latest_);
+}
+
+// ---------------------------------------------------------------------------
+// event loop  –  peers are polled on their own schedule, staggered over the
+// first interval so a large fleet is not hit all at once
+// ---------------------------------------------------------------------------
+
+void FleetAggregator::run() {
+    const Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < peers_.size(); ++i)
+        peers_[i]->next_poll = begin + options_.interval * i / peers_.size();
+
+    std::vector<epoll_event> events(std::min<size_t>(peers_.size() + 1, 256));
+    Clock::time_point nextPublish = begin;
+    while (!stopping_) {
+        Clock::time_point now  = Clock::now();
+        Clock::time_point wake = now + options_.interval;
+        for (auto& pp : peers_) {
+            Peer& p = *pp;
+            if (p.state == Peer::State::Idle && p.next_poll <= now) startPoll(p, now);
+            else if (p.state != Peer::State::Idle && p.deadline <= now) fail(p, "timed out", now);
+            wake = std::min(wake, p.state == Peer::State::Idle ? p.next_poll : p.deadline);
+        }
+        if (changed_) {
+            if (now >= nextPublish) {
+                publish();
+                nextPublish = now + kPublishEvery;
+            } else {
+                wake = std::min(wake, nextPublish);
+            }
+        }
+
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count();
+        int n = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()),
+                           static_cast<int>(std::max<int64_t>(ms, 0) + 1));
+        now = Clock::now();
+        for (int i = 0; i < n; ++i) {
+            if (!events[static_cast<size_t>(i)].data.ptr) continue;   // wake_fd_
+            onEvent(*static_cast<Peer*>(events[static_cast<size_t>(i)].data.ptr),
+                    events[static_cast<size_t>(i)].events, now);
+        }
+    }
+}
+
+bool FleetAggregator::connectPeer(Peer& p, std::string& error) {
+    // resolved once and again only after a failure; getaddrinfo blocks the
+    // loop, but only for peers whose address may have changed
+    if (p.addr_len == 0) {
+        addrinfo hints{};
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* res = nullptr;
+        int rc = getaddrinfo(p.host.c_str(), p.port.c_str(), &hints, &res);
+        if (rc != 0 || !res) {
+            error = std::string("cannot resolve: ") + gai_strerror(rc);
+            return false;
+        }
+        std::memcpy(&p.addr, res->ai_addr, res->ai_addrlen);
+        p.addr_len = static_cast<socklen_t>(res->ai_addrlen);
+        freeaddrinfo(res);
+    }
+    p.fd = ::socket(p.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (p.fd < 0 ||
+        (::connect(p.fd, reinterpret_cast<const sockaddr*>(&p.addr), p.addr_len) != 0 && errno != EINPROGRESS)) {
+        error = std::string("cannot connect: ") + std::strerror(errno);
+        if (p.fd >= 0) ::close(p.fd);
+        p.fd = -1;
+        return false;
+    }
+    epoll_event ev{};
+    ev.events   = EPOLLOUT;
+    ev.data.ptr = &p;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, p.fd, &ev);
+    p.state = Peer::State::Connecting;
+    return true;
+}
+
+void FleetAggregator::startPoll(Peer& p, Clock::time_point now) {
+    p.request = "GET /api/health?format=cbor";
+    if (p.sequence) {
+        p.request += "&since=" + std::to_string(p.sequence);
+        p.request += "&instance=" + std::to_string(p.instance);
+    }
+    p.request += " HTTP/1.1\r\nHost: " + p.name +
+                 "\r\nAccept: application/cbor\r\nUser-Agent: serverhealth-fleet\r\n\r\n";
+    p.sent = 0;
+    p.response.clear();
+    p.started  = now;
+    p.deadline = now + options_.timeout;
+    ++p.polls;
+
+    p.reused = p.fd >= 0;
+    if (p.reused) {
+        p.state = Peer::State::Writing;
+        epoll_event ev{};
+        ev.events   = EPOLLOUT;
+        ev.data.ptr = &p;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, p.fd, &ev);
+    } else {
+        std::string error;
+        if (!connectPeer(p, error)) {
+            p.addr_len = 0;
+            fail(p, std::move(error), now);
+        }
+    }
+}
+
+void FleetAggregator::onEvent(Peer& p, uint32_t events, Clock::time_point now) {
+    switch (p.state) {
+        case Peer::State::Idle:
+            // the peer closed a kept-alive connection between polls
+            closeConnection(p);
+            return;
+        case Peer::State::Connecting: {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(p.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err != 0) {
+                p.addr_len = 0;
+                fail(p, std::string("cannot connect: ") + std::strerror(err), now);
+                return;
+            }
+            p.state = Peer::State::Writing;
+            [[fallthrough]];
+        }
+        case Peer::State::Writing: {
+            while (p.sent < p.request.size()) {
+                ssize_t n = ::send(p.fd, p.request.data() + p.sent, p.request.size() - p.sent, MSG_NOSIGNAL);
+                if (n < 0 && errno == EAGAIN) return;
+                if (n <= 0) {
+                    if (p.reused) {   // the peer dropped the idle connection just now
+                        closeConnection(p);
+                        --p.polls;
+                        startPoll(p, now);
+                        return;
+                    }
+                    fail(p, std::string("send: ") + std::strerror(errno), now);
+                    return;
+                }
+                p.sent += static_cast<size_t>(n);
+            }
+            p.state = Peer::State::Reading;
+            epoll_event ev{};
+            ev.events   = EPOLLIN | EPOLLRDHUP;
+            ev.data.ptr = &p;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, p.fd, &ev);
+            return;
+        }
+        case Peer::State::Reading:
+            if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) readResponse(p, now);
+            return;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// HTTP/1.1 response framing  –  Content-Length, chunked, or until close
+// ---------------------------------------------------------------------------
+
+enum class Framing { Incomplete, Done, Bad };
+
+static bool headerIs(std::string_view line, std::string_view name, std::string_view& value) {
+    if (line.size() <= name.size() || line[name.size()] != ':') return false;
+    for (size_t i = 0; i < name.size(); ++i)
+        if (std::tolower(static_cast<unsigned char>(line[i])) != name[i]) return false;
+    value = line.substr(name.size() + 1);
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    return true;
+}
+
+static bool equalsLower(std::string_view s, std::string_view lower) {
+    if (s.size() != lower.size()) return false;
+    for (size_t i = 0; i < s.size(); ++i)
+        if (std::tolower(static_cast<unsigned char>(s[i])) != lower[i]) return false;
+    return true;
+}
+
+static Framing frameResponse(std::string_view in, bool eof, int& status, bool& close, std::string& body) {
+    size_t end = in.find("\r\n\r\n");
+    if (end == std::string_view::npos) return eof ? Framing::Bad : Framing::Incomplete;
+    std::string_view head = in.substr(0, end), rest = in.substr(end + 4);
+
+    size_t lineEnd = head.find("\r\n");
+    std::string_view line = head.substr(0, lineEnd);
+    if (line.size() < 12 || line.substr(0, 5) != "HTTP/") return Framing::Bad;
+    status = std::atoi(std::string(line.substr(9, 3)).c_str());
+    close  = line.substr(0, 8) == "HTTP/1.0";
+
+    long long length  = -1;
+    bool      chunked = false;
+    while (lineEnd != std::string_view::npos) {
+        head.remove_prefix(lineEnd + 2);
+        lineEnd = head.find("\r\n");
+        line = head.substr(0, lineEnd);
+        std::string_view v;
+        if (headerIs(line, "content-length", v))         length = std::atoll(std::string(v).c_str());
+        else if (headerIs(line, "transfer-encoding", v)) chunked = equalsLower(v, "chunked");
+        else if (headerIs(line, "connection", v))        close = equalsLower(v, "close");
+    }
+
+    body.clear();
+    if (chunked) {
+        for (;;) {
+            size_t nl = rest.find("\r\n");
+            if (nl == std::string_view::npos) return eof ? Framing::Bad : Framing::Incomplete;
+            unsigned long long size = 0;
+            auto r = std::from_chars(rest.data(), rest.data() + nl, size, 16);
+            if (r.ptr == rest.data()) return Framing::Bad;
+            rest.remove_prefix(nl + 2);
+            if (size == 0) return Framing::Done;   // trailers are not used
+            if (rest.size() < size + 2) return eof ? Framing::Bad : Framing::Incomplete;
+            body.append(rest.data(), static_cast<size_t>(size));
+            rest.remove_prefix(static_cast<size_t>(size) + 2);
+        }
+    }
+    if (length >= 0) {
+        if (rest.size() < static_cast<unsigned long long>(length)) return eof ? Framing::Bad : Framing::Incomplete;
+        body.assign(rest.data(), static_cast<size_t>(length));
+        return Framing::Done;
+    }
+    if (!eof) return Framing::Incomplete;
+    body.assign(rest.data(), rest.size());
+    close = true;
+    return Framing::Done;
+}
+
+void FleetAggregator::readResponse(Peer& p, Clock::time_point now) {
+    char buf[16384];
+    bool eof = false;
+    for (;;) {
+        ssize_t n = ::recv(p.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            p.response.append(buf, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) break;
+        if (n < 0 && errno == EINTR) continue;
+        eof = true;
+        break;
+    }
+    if (eof && p.response.empty() && p.reused) {   // kept-alive connection closed under us
+        closeConnection(p);
+        --p.polls;
+        startPoll(p, now);
+        return;
+    }
+
+    int         status = 0;
+    bool        close  = false;
+    std::string body;
+    switch (frameResponse(p.response, eof, status, close, body)) {
+        case Framing::Incomplete:
+            return;
+        case Framing::Bad:
+            fail(p, "malformed HTTP response", now);
+            return;
+        case Framing::Done:
+            break;
+    }
+    if (status != 200) {
+        fail(p, "HTTP " + std::to_string(status), now);
+        return;
+    }
+    std::string error;
+    if (!apply(p, body, error)) {
+        {
+            std::lock_guard<std::mutex> lock(docs_mutex_);
+            p.sequence = 0;   // start over from a whole document
+        }
+        fail(p, error, now);
+        return;
+    }
+    if (close) closeConnection(p);
+    finishPoll(p, now);
+}
+
+void FleetAggregator::finishPoll(Peer& p, Clock::time_point now) {
+    if (p.fd >= 0) {   // stay subscribed to hang-ups only until the next poll
+        epoll_event ev{};
+        ev.events   = EPOLLRDHUP;
+        ev.data.ptr = &p;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, p.fd, &ev);
+    }
+    p.state           = Peer::State::Idle;
+    p.up              = true;
+    p.error.clear();
+    p.failures_in_row = 0;
+    p.latency_ms      = std::chrono::duration<double, std::milli>(now - p.started).count();
+    p.last_seen_ms    = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch()).count();
+    p.next_poll       = std::max(p.started + options_.interval, now);
+    p.response.clear();
+    changed_ = true;
+}
+
+void FleetAggregator::fail(Peer& p, std::string error, Clock::time_point now) {
+    closeConnection(p);
+    p.up    = false;
+    p.error = std::move(error);
+    ++p.failures;
+    auto backoff = options_.interval * (1 << std::min(p.failures_in_row, 5));
+    ++p.failures_in_row;
+    p.next_poll = now + std::min<Clock::duration>(backoff, kMaxBackoff);
+    p.response.clear();
+    changed_ = true;
+}
+
+void FleetAggregator::closeConnection(Peer& p) {
+    if (p.fd >= 0) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, p.fd, nullptr);
+        ::close(p.fd);
+    }
+    p.fd    = -1;
+    p.state = Peer::State::Idle;
+}
+
+// ---------------------------------------------------------------------------
+// documents  –  a whole /api/health document replaces what was kept; a
+// delta ({"base", "set", "remove"}) patches it, removals first because a
+// key can leave and come back within one delta
+// ---------------------------------------------------------------------------
+
+// Key of a list entry: the field named in kEntryKeys
+static bool entryKey(std::string_view entry, const char* field, std::string& key) {
+    CborReader r(entry);
+    if (r.next() != CborReader::Token::BeginObject) return false;
+    for (;;) {
+        CborReader::Token t = r.next();
+        if (t != CborReader::Token::Key) return false;
+        if (r.str() != field) {
+            r.skipValue();
+            continue;
+        }
+        CborReader::Token v = r.next();
+        if (v == CborReader::Token::Number && r.isInteger() && !r.isNegative()) {   // processes: pid
+            key = std::to_string(r.uintValue());
+            return true;
+        }
+        if (v != CborReader::Token::String) return false;
+        key = r.str();
+        return true;
+    }
+}
+
+bool FleetAggregator::apply(Peer& p, std::string_view body, std::string& error) {
+    struct Set {
+        int              group;
+        std::string_view value;   // object, or array of entries
+    };
+    uint64_t                  sequence = 0, instance = 0, base = 0;
+    bool                      delta = false;
+    std::string               timestamp;
+    std::vector<Set>          sets;
+    std::vector<std::pair<int, std::string>> removals;
+
+    using Token = CborReader::Token;
+    CborReader r(body);
+    error = "malformed CBOR document";
+    if (r.next() != Token::BeginObject) return false;
+    for (;;) {
+        Token t = r.next();
+        if (t == Token::EndObject) break;
+        if (t != Token::Key) return false;
+        std::string k = r.str();
+        if (k == "sequence" || k == "instance" || k == "base") {
+            if (r.next() != Token::Number || !r.isInteger() || r.isNegative()) return false;
+            (k == "sequence" ? sequence : k == "instance" ? instance : base) = r.uintValue();
+            delta |= k == "base";
+        } else if (k == "timestamp") {
+            if (r.next() != Token::String) return false;
+            timestamp = r.str();
+        } else if (k == "set") {
+            if (r.next() != Token::BeginObject) return false;
+            while ((t = r.next()) == Token::Key) {
+                int g = metricGroupIndex(r.str());
+                std::string_view v = r.rawValue();
+                if (v.empty()) return false;
+                if (g >= 0) sets.push_back(Set{g, v});
+            }
+            if (t != Token::EndObject) return false;
+        } else if (k == "remove") {
+            if (r.next() != Token::BeginObject) return false;
+            while ((t = r.next()) == Token::Key) {
+                int g = metricGroupIndex(r.str());
+                if (r.next() != Token::BeginArray) return false;
+                while ((t = r.next()) == Token::String)
+                    if (g >= 0) removals.emplace_back(g, r.str());
+                if (t != Token::EndArray) return false;
+            }
+            if (t != Token::EndObject) return false;
+        } else {
+            int g = metricGroupIndex(k);
+            std::string_view v = r.rawValue();
+            if (v.empty()) return false;
+            if (g >= 0) sets.push_back(Set{g, v});
+        }
+    }
+    if (delta && base != p.sequence) {
+        error = "delta against sequence " + std::to_string(base) + ", expected " + std::to_string(p.sequence);
+        return false;
+    }
+
+    // check and split every entry before touching the kept document
+    struct Entry {
+        int              group;
+        std::string      key;
+        std::string_view value;
+    };
+    std::vector<Entry> entries;
+    for (const Set& s : sets) {
+        const char* keyField = kEntryKeys[s.group];
+        CborReader e(s.value);
+        Token first = e.next();
+        if (!*keyField) {
+            if (first != Token::BeginObject) return false;
+            entries.push_back(Entry{s.group, std::string(), s.value});
+            continue;
+        }
+        if (first != Token::BeginArray) return false;
+        for (;;) {
+            std::string_view v = e.rawValue();
+            if (v.empty()) {
+                if (e.failed()) return false;
+                break;   // end of the array
+            }
+            Entry entry{s.group, std::string(), v};
+            if (!entryKey(v, keyField, entry.key)) return false;
+            entries.push_back(std::move(entry));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(docs_mutex_);
+    if (!delta) {
+        p.groups = 0;
+        for (int g = 0; g < kMetricGroupCount; ++g) {
+            p.objects[g].clear();
+            p.lists[g].clear();
+        }
+        for (const Set& s : sets) p.groups |= 1u << s.group;   // also the empty lists
+    }
+    for (const auto& removal : removals) {
+        const std::string& key = removal.second;
+        auto& list = p.lists[removal.first];
+        list.erase(std::remove_if(list.begin(), list.end(), [&key](const auto& e) { return e.first == key; }),
+                   list.end());
+    }
+    for (Entry& e : entries) {
+        p.groups |= 1u << e.group;
+        if (!*kEntryKeys[e.group]) {
+            p.objects[e.group].assign(e.value);
+            continue;
+        }
+        auto& list = p.lists[e.group];
+        auto it = std::find_if(list.begin(), list.end(), [&e](const auto& x) { return x.first == e.key; });
+        if (it != list.end()) it->second.assign(e.value);
+        else                  list.emplace_back(std::move(e.key), std::string(e.value));
+    }
+    p.sequence  = sequence;
+    p.instance  = instance;
+    p.timestamp = std::move(timestamp);
+    summarize(p);
+    return true;
+}
+
+// A top-level number / string field of an encoded object
+static double numberField(std::string_view object, std::string_view name) {
+    CborReader r(object);
+    if (r.next() != CborReader::Token::BeginObject) return NAN;
+    while (r.next() == CborReader::Token::Key) {
+        if (r.str() != name) {
+            r.skipValue();
+            continue;
+        }
+        return r.next() == CborReader::Token::Number ? r.number() : NAN;
+    }
+    return NAN;
+}
+
+static bool stringField(std::string_view object, std::string_view name, std::string& out) {
+    CborReader r(object);
+    if (r.next() != CborReader::Token::BeginObject) return false;
+    while (r.next() == CborReader::Token::Key) {
+        if (r.str() != name) {
+            r.skipValue();
+            continue;
+        }
+        if (r.next() != CborReader::Token::String) return false;
+        out = r.str();
+        return true;
+    }
+    return false;
+}
+
+// NaN-aware max / sum: a missing value leaves the other
+static double maxOf(double a, double b) { return std::isnan(a) ? b : std::isnan(b) ? a : std::max(a, b); }
+static double sumOf(double a, double b) { return std::isnan(a) ? b : std::isnan(b) ? a : a + b; }
+
+void FleetAggregator::summarize(Peer& p) {
+    auto has = [&p](uint32_t bit) { return (p.groups & bit) != 0; };
+    const int cpu = 0, memory = 1, disks = 2, network = 3, temperature = 5, docker = 6;
+
+    p.cpu_percent     = has(kGroupCpu)    ? numberField(p.objects[cpu], "usage_percent")    : NAN;
+    p.memory_percent  = has(kGroupMemory) ? numberField(p.objects[memory], "usage_percent") : NAN;
+    p.memory_total_kb = has(kGroupMemory) ? numberField(p.objects[memory], "total_kb")      : NAN;
+
+    p.disk_max_percent = NAN;
+    for (const auto& e : p.lists[disks])
+        p.disk_max_percent = maxOf(p.disk_max_percent, numberField(e.second, "usage_percent"));
+
+    p.rx_bytes_per_sec = p.tx_bytes_per_sec = has(kGroupNetwork) ? 0.0 : NAN;
+    for (const auto& e : p.lists[network]) {
+        p.rx_bytes_per_sec = sumOf(p.rx_bytes_per_sec, numberField(e.second, "rx_bytes_per_sec"));
+        p.tx_bytes_per_sec = sumOf(p.tx_bytes_per_sec, numberField(e.second, "tx_bytes_per_sec"));
+    }
+
+    p.temperature_max = NAN;
+    for (const auto& e : p.lists[temperature])
+        p.temperature_max = maxOf(p.temperature_max, numberField(e.second, "temperature_celsius"));
+
+    p.containers         = has(kGroupDocker) ? static_cast<int64_t>(p.lists[docker].size()) : -1;
+    p.containers_running = 0;
+    std::string state;
+    for (const auto& e : p.lists[docker])
+        if (stringField(e.second, "state", state) && state == "running") ++p.containers_running;
+}
+
+// ---------------------------------------------------------------------------
+// rendering
+// ---------------------------------------------------------------------------
+
+// Keys come from peers, and JsonWriter writes keys unescaped
+static bool plainKey(const std::string& k) {
+    for (char c : k)
+        if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_')) return false;
+    return !k.empty();
+}
+
+// Copy one CBOR value, whose first token is `t`, to JSON.
+static bool copyValue(CborReader& r, CborReader::Token t, JsonWriter& w) {
+    using Token = CborReader::Token;
+    switch (t) {
+        case Token::BeginObject:
+            w.beginObject();
+            while ((t = r.next()) == Token::Key) {
+                if (!plainKey(r.str())) return false;
+                w.key(r.str());
+                if (!copyValue(r, r.next(), w)) return false;
+            }
+            if (t != Token::EndObject) return false;
+            w.endObject();
+            return true;
+        case Token::BeginArray:
+            w.beginArray();
+            while ((t = r.next()) != Token::EndArray)
+                if (!copyValue(r, t, w)) return false;
+            w.endArray();
+            return true;
+        case Token::String: w.value(r.str()); return true;
+        case Token::True:   w.value(true);    return true;
+        case Token::False:  w.value(false);   return true;
+        case Token::Null:   w.null();         return true;
+        case Token::Number:
+            if (r.isSingle())        w.value(static_cast<float>(r.number()));   // prints as it was sampled
+            else if (!r.isInteger()) w.value(r.number());
+            else if (r.isNegative()) w.value(r.intValue());
+            else                     w.value(r.uintValue());
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool copyCbor(std::string_view cbor, JsonWriter& w) {
+    CborReader r(cbor);
+    return copyValue(r, r.next(), w);
+}
+
+bool FleetAggregator::peerJson(std::string_view name, std::string& out) const {
+    auto it = std::find_if(peers_.begin(), peers_.end(), [name](const auto& p) { return p->name == name; });
+    if (it == peers_.end()) return false;
+    const Peer& p = **it;
+
+    std::lock_guard<std::mutex> lock(docs_mutex_);
+    if (p.timestamp.empty()) return false;
+    JsonWriter w(out, true);
+    w.beginObject();
+    w.field("peer",      p.name);
+    w.field("sequence",  p.sequence);
+    w.field("timestamp", p.timestamp);
+    for (int g = 0; g < kMetricGroupCount; ++g) {
+        if (!(p.groups & (1u << g))) continue;
+        w.key(metricGroupName(g));
+        if (!*kEntryKeys[g]) {
+            if (!copyCbor(p.objects[g], w)) return false;
+            continue;
+        }
+        w.beginArray();
+        for (const auto& e : p.lists[g])
+            if (!copyCbor(e.second, w)) return false;
+        w.endArray();
+    }
+    w.endObject();
+    return true;
+}
+
+void FleetAggregator::publish() {
+    auto snap = std::make_shared<FleetSnapshot>();
+    snap->sequence = ++sequence_;
+
+    size_t  up = 0, polled = 0;
+    double  cpu = 0.0, memory = 0.0, diskMax = NAN, rx = NAN, tx = NAN;
+    int64_t containers = 0, running = 0;
+    for (const auto& pp : peers_) {
+        const Peer& p = *pp;
+        if (!p.up) continue;
+        ++up;
+        if (!std::isnan(p.cpu_percent)) {
+            cpu += p.cpu_percent;
+            memory += std::isnan(p.memory_percent) ? 0.0 : p.memory_percent;
+            ++polled;
+        }
+        diskMax = maxOf(diskMax, p.disk_max_percent);
+        rx      = sumOf(rx, p.rx_bytes_per_sec);
+        tx      = sumOf(tx, p.tx_bytes_per_sec);
+        if (p.containers > 0) {
+            containers += p.containers;
+            running    += p.containers_running;
+        }
+    }
+
+    JsonWriter w(snap->json.text, false);
+    w.beginObject();
+    w.field("timestamp",   HealthCollector::isoTimestamp(std::time(nullptr)));
+    w.field("interval_ms", static_cast<int64_t>(options_.interval.count()));
+    w.field("peers_total", static_cast<uint64_t>(peers_.size()));
+    w.field("peers_up",    static_cast<uint64_t>(up));
+    w.key("totals");
+    w.beginObject();
+    w.field("cpu_percent_avg",    polled ? cpu / static_cast<double>(polled) : NAN);
+    w.field("memory_percent_avg", polled ? memory / static_cast<double>(polled) : NAN);
+    w.field("disk_max_percent",   diskMax);
+    w.field("rx_bytes_per_sec",   rx);
+    w.field("tx_bytes_per_sec",   tx);
+    w.field("containers",         containers);
+    w.field("containers_running", running);
+    w.endObject();
+
+    w.key("peers");
+    w.beginArray();
+    for (const auto& pp : peers_) {
+        const Peer& p = *pp;
+        w.beginObject();
+        w.field("peer",     p.name);
+        w.field("up",       p.up);
+        w.field("error",    p.error);
+        w.field("polls",    p.polls);
+        w.field("failures", p.failures);
+        w.key("last_seen_ms");
+        if (p.last_seen_ms < 0) w.null();
+        else                    w.value(p.last_seen_ms);
+        w.field("latency_ms", p.latency_ms);
+        w.field("sequence",   p.sequence);
+        w.field("timestamp",  p.timestamp);
+        w.field("cpu_percent",             p.cpu_percent);
+        w.field("memory_percent",          p.memory_percent);
+        w.field("memory_total_kb",         p.memory_total_kb);
+        w.field("disk_max_percent",        p.disk_max_percent);
+        w.field("rx_bytes_per_sec",        p.rx_bytes_per_sec);
+        w.field("tx_bytes_per_sec",        p.tx_bytes_per_sec);
+        w.field("temperature_max_celsius", p.temperature_max);
+        w.key("containers");
+        if (p.containers < 0) w.null();
+        else                  w.value(p.containers);
+        w.field("containers_running", p.containers_running);
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+
+    prepareBody(snap->json, gzip_);
+    std::atomic_store(&latest_, std::shared_ptr<const FleetSnapshot>(std::move(snap)));
+    changed_ = false;
+}
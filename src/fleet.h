@@ -0,0 +1,94 @@
+#pragma once
+
+#include "prepared_body.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct FleetOptions {
+    std::vector<std::string>  peers;   // "host:port", as given in FLEET_PEERS
+    std::chrono::milliseconds interval{1000};
+    std::chrono::milliseconds timeout{5000};
+};
+
+// Split "host:port,[v6addr]:port,host" (port defaults to 9091) into peer
+// names.  False on an empty element or a bad port.
+bool parseFleetPeers(std::string_view list, std::vector<std::string>& out);
+
+// /api/fleet as published by the aggregator; handlers serve it as is.
+struct FleetSnapshot {
+    uint64_t     sequence = 0;
+    PreparedBody json;
+};
+
+// Federation mode: one thread polls every peer serverhealth instance over
+// a kept-alive HTTP/1.1 connection and merges their documents.
+//
+// All sockets are non-blocking and driven by a single epoll loop, so a
+// hundred peers cost a hundred file descriptors, not a hundred threads.
+// Each poll asks for `/api/health?format=cbor&since=<last sequence>`, so
+// after the first document a peer only sends the entries that changed;
+// the aggregator keeps every entry of every peer as the CBOR bytes it
+// arrived in and patches them.  The fleet summary is re-rendered at most a
+// few times per interval, not once per answer.
+//
+// A peer that fails is retried with exponential backoff (up to 30 s) and
+// shown as down with its last error; its last document is kept.
+class FleetAggregator {
+public:
+    explicit FleetAggregator(FleetOptions options);
+    ~FleetAggregator();
+
+    FleetAggregator(const FleetAggregator&)            = delete;
+    FleetAggregator& operator=(const FleetAggregator&) = delete;
+
+    void start();
+    void stop();
+
+    std::shared_ptr<const FleetSnapshot> latest() const;
+
+    // The last merged health document of peer `name`, as JSON.  False if
+    // there is no such peer or nothing has been received from it yet.
+    bool peerJson(std::string_view name, std::string& out) const;
+
+private:
+    struct Peer;
+    using Clock = std::chrono::steady_clock;
+
+    void run();
+    void startPoll(Peer& p, Clock::time_point now);
+    bool connectPeer(Peer& p, std::string& error);
+    void onEvent(Peer& p, uint32_t events, Clock::time_point now);
+    void readResponse(Peer& p, Clock::time_point now);
+    void finishPoll(Peer& p, Clock::time_point now);
+    void fail(Peer& p, std::string error, Clock::time_point now);
+    void closeConnection(Peer& p);
+    bool apply(Peer& p, std::string_view body, std::string& error);
+    void summarize(Peer& p);
+    void publish();
+
+    FleetOptions                       options_;
+    std::vector<std::unique_ptr<Peer>> peers_;
+    int                                epoll_fd_ = -1;
+    int                                wake_fd_  = -1;   // eventfd; stop() writes to it
+    bool                               changed_  = true;
+    uint64_t                           sequence_ = 0;
+    GzipEncoder                        gzip_;
+
+    // Peer documents are patched by the loop thread under docs_mutex_ and
+    // read by peerJson(); everything else about a peer is the loop's own.
+    mutable std::mutex docs_mutex_;
+
+    // Published with std::atomic_store / read with std::atomic_load.
+    std::shared_ptr<const FleetSnapshot> latest_;
+
+    std::atomic<bool> stopping_{false};
+    std::thread       thread_;
+};
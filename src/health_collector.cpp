@@ -1,17 +1,34 @@
 #include "health_collector.h"
 
-#include <cctype>
+#include "cbor_writer.h"
+#include "docker_watcher.h"
+#include "ebpf_collector.h"
+#include "json_writer.h"
+#include "netlink_stats.h"
+#include "proc_parsers.h"
+#include "process_table.h"
+#include "self_metrics.h"
+#include "speed_test.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <charconv>
 #include <chrono>
+#include <condition_variable>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <filesystem>
-#include <fstream>
 #include <mutex>
-#include <sstream>
 #include <string>
-#include <thread>
+#include <iterator>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include <poll.h>
+#include <sys/stat.h>
 #include <sys/statvfs.h>
 
 namespace fs = std::filesystem;
@@ -20,44 +37,6 @@ namespace fs = std::filesystem;
 // helpers
 // ---------------------------------------------------------------------------
 
-static std::string readFile(const std::string& path) {
-    std::ifstream f(path);
-    if (!f.is_open()) return "";
-    std::ostringstream ss;
-    ss << f.rdbuf();
-    return ss.str();
-}
-
-static std::string escapeJson(const std::string& s) {
-    std::string out;
-    out.reserve(s.size());
-    for (char c : s) {
-        if (c == '"') out += "\\\"";
-        else if (c == '\\') out += "\\\\";
-        else if (c == '\n') out += "\\n";
-        else out += c;
-    }
-    return out;
-}
-
-static std::string decodeMountField(const std::string& s) {
-    std::string out;
-    out.reserve(s.size());
-    for (size_t i = 0; i < s.size(); ++i) {
-        if (s[i] == '\\' && i + 3 < s.size() &&
-            std::isdigit(static_cast<unsigned char>(s[i + 1])) &&
-            std::isdigit(static_cast<unsigned char>(s[i + 2])) &&
-            std::isdigit(static_cast<unsigned char>(s[i + 3]))) {
-            int v = (s[i + 1] - '0') * 64 + (s[i + 2] - '0') * 8 + (s[i + 3] - '0');
-            out.push_back(static_cast<char>(v));
-            i += 3;
-            continue;
-        }
-        out.push_back(s[i]);
-    }
-    return out;
-}
-
 static std::string hostPathForMount(const std::string& hostRoot, const std::string& mountPath) {
     if (hostRoot.empty() || hostRoot == "/") return mountPath;
     if (mountPath == "/") return hostRoot;
@@ -68,452 +47,1053 @@ static std::string hostPathForMount(const std::string& hostRoot, const std::stri
 // constructor
 // ---------------------------------------------------------------------------
 
-HealthCollector::HealthCollector() {
+// Docker Engine socket: DOCKER_HOST=unix:///path overrides the default.
+static std::string dockerSocketPath() {
+    const char* host = std::getenv("DOCKER_HOST");
+    if (host && std::strncmp(host, "unix://", 7) == 0) return host + 7;
+    return "/var/run/docker.sock";
+}
+
+static long envPositive(const char* name, long fallback) {
+    const char* v = std::getenv(name);
+    long n = v ? std::strtol(v, nullptr, 10) : 0;
+    return n > 0 ? n : fallback;
+}
+
+HealthCollector::HealthCollector(uint32_t groups)
+    : groups_(groups), docker_(std::make_unique<DockerWatcher>(dockerSocketPath())) {
     const char* proc = std::getenv("PROC_PATH");
     const char* sys  = std::getenv("SYS_PATH");
     const char* root = std::getenv("HOST_ROOT_PATH");
     proc_path_ = proc ? proc : "/proc";
     sys_path_  = sys  ? sys  : "/sys";
     host_root_path_ = root ? root : "";
+    source_deadline_ = std::chrono::milliseconds(envPositive("SOURCE_DEADLINE_MS", 1000));
+
+    NetBackend netBackend = NetBackend::Auto;
+    const char* net = std::getenv("NET_BACKEND");
+    if (net) parseNetBackend(net, netBackend);   // main rejects bad values
+    if ((groups_ & kGroupNetwork) && netBackend != NetBackend::Procfs)
+        netlink_ = std::make_unique<NetlinkLinkDump>();
+    netlink_fallback_ = netBackend == NetBackend::Auto;
+    if (groups_ & kGroupDisks) {
+        slow_pool_  = std::make_unique<WorkerPool>(static_cast<size_t>(envPositive("SLOW_SOURCE_THREADS", 4)));
+        probe_sync_ = std::make_shared<ProbeSync>();
+    }
+    stat_src_      = MetricSource(proc_path_ + "/stat");
+    meminfo_src_   = MetricSource(proc_path_ + "/meminfo");
+    netdev_src_    = MetricSource(proc_path_ + "/net/dev");
+    diskstats_src_ = MetricSource(proc_path_ + "/diskstats");
+    mounts_src_    = MetricSource(proc_path_ + "/mounts");
+    vmstat_src_    = MetricSource(proc_path_ + "/vmstat");
+    pressure_srcs_[0] = MetricSource(proc_path_ + "/pressure/cpu");
+    pressure_srcs_[1] = MetricSource(proc_path_ + "/pressure/memory");
+    pressure_srcs_[2] = MetricSource(proc_path_ + "/pressure/io");
+    if (groups_ & kGroupProcesses) {
+        ProcessScanOptions po;
+        po.top_n   = static_cast<size_t>(envPositive("PROCESS_TOP_N", 10));
+        po.budget  = static_cast<size_t>(envPositive("PROCESS_SCAN_BUDGET", 1000));
+        po.threads = static_cast<size_t>(envPositive("PROCESS_SCAN_THREADS", 1));
+        processes_ = std::make_unique<ProcessScanner>(proc_path_, po);
+    }
+    if (groups_ & kGroupLatency) ebpf_ = std::make_unique<EbpfCollector>(sys_path_);
+    if (groups_ & kGroupSpeed) {
+        SpeedTestOptions so;
+        const char* down = std::getenv("SPEEDTEST_DOWNLOAD_URL");
+        const char* up   = std::getenv("SPEEDTEST_UPLOAD_URL");
+        if (down) so.download_url = down;   // main rejects bad URLs
+        if (up)   so.upload_url   = up;
+        so.interval     = std::chrono::seconds(envPositive("SPEEDTEST_INTERVAL_S", 3600));
+        so.jitter       = std::chrono::seconds(envPositive("SPEEDTEST_JITTER_S", 300));
+        so.max_bytes    = static_cast<uint64_t>(envPositive("SPEEDTEST_MAX_BYTES", 40000000));
+        so.max_duration = std::chrono::seconds(envPositive("SPEEDTEST_MAX_SECONDS", 10));
+        so.streams      = static_cast<size_t>(envPositive("SPEEDTEST_STREAMS", 4));
+        speed_ = std::make_unique<SpeedTester>(std::move(so));
+        speed_->start();
+    }
+    if (groups_ & kGroupDocker) {
+        const char* cgroup = std::getenv("CGROUP_PATH");
+        std::string cgroupRoot = cgroup ? cgroup : sys_path_ + "/fs/cgroup";
+        // the unified hierarchy is the only one with cgroup.controllers
+        std::error_code ec;
+        if (fs::exists(cgroupRoot + "/cgroup.controllers", ec)) cgroup_root_ = std::move(cgroupRoot);
+        docker_->start();
+    }
 }
 
+HealthCollector::~HealthCollector() = default;
+
 // ---------------------------------------------------------------------------
-// CPU  –  two /proc/stat snapshots 200 ms apart
+// CPU  –  /proc/stat delta against the previous sample
+//
+// The collector is long-lived (owned by the sampler), so usage is measured
+// over the real interval between two collections.  The very first call has
+// no previous sample and reports the average since boot.
 // ---------------------------------------------------------------------------
 
-CpuInfo HealthCollector::getCpuInfo() {
-    auto sample = [&]() -> std::vector<long> {
-        std::string line;
-        std::ifstream f(proc_path_ + "/stat");
-        std::getline(f, line);               // first line: "cpu ..."
-        std::istringstream ss(line);
-        std::string label;
-        ss >> label;                          // skip "cpu"
-        std::vector<long> vals;
-        long v;
-        while (ss >> v) vals.push_back(v);
-        return vals;
+// Fill the percentage fields shared by CpuInfo and CpuCoreInfo from the
+// delta between two readings; returns the idle percentage.
+template <typename T>
+static float fillCpuPercentages(const CpuTimes& cur, const CpuTimes& prev, T& out) {
+    // a counter going backwards means the cpu was hot-plugged: use since-boot
+    const CpuTimes& base = (cur.total() >= prev.total()) ? prev : CpuTimes{};
+    uint64_t d_total = cur.total() - base.total();
+    if (d_total == 0) return 0.0f;
+
+    auto pct = [d_total](uint64_t now, uint64_t before) {
+        return now >= before ? 100.0f * (now - before) / d_total : 0.0f;
     };
+    float idle          = pct(cur.idle, base.idle);
+    out.usage_percent   = 100.0f - idle;
+    out.user_percent    = pct(cur.user + cur.nice, base.user + base.nice);
+    out.system_percent  = pct(cur.system,  base.system);
+    out.iowait_percent  = pct(cur.iowait,  base.iowait);
+    out.irq_percent     = pct(cur.irq,     base.irq);
+    out.softirq_percent = pct(cur.softirq, base.softirq);
+    out.steal_percent   = pct(cur.steal,   base.steal);
+    return idle;
+}
 
-    auto v1 = sample();
-    std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    auto v2 = sample();
-
+CpuInfo HealthCollector::getCpuInfo() {
     CpuInfo info{};
-    if (v1.size() < 4 || v2.size() < 4) return info;
+    if (!parseProcStat(stat_src_.read(), cpu_total_, cpu_cores_))
+        return info;
+
+    info.idle_percent = fillCpuPercentages(cpu_total_, prev_cpu_total_, info);
+    prev_cpu_total_   = cpu_total_;
+
+    info.cores.resize(cpu_cores_.size());
+    for (size_t i = 0; i < cpu_cores_.size(); ++i) {
+        const CpuTimes& cur = cpu_cores_[i];
+        size_t id = static_cast<size_t>(cur.cpu);
+        if (id >= prev_cpu_cores_.size()) prev_cpu_cores_.resize(id + 1);
+
+        CpuCoreInfo& core = info.cores[i];
+        core    = CpuCoreInfo{};
+        core.id = cur.cpu;
+        fillCpuPercentages(cur, prev_cpu_cores_[id], core);
+        prev_cpu_cores_[id] = cur;
+    }
+    return info;
+}
+
+// ---------------------------------------------------------------------------
+// Disk space  –  statvfs on mount points found in /proc/mounts
+//
+// Every call goes to the worker pool and the sample waits for the answers
+// up to the source deadline.  A mount that is still busy after that keeps
+// its last good figures, marked stale, and gets no new call until the
+// stuck one returns, so a dead NFS server ties up at most one worker per
+// mount instead of the sampler.
+// ---------------------------------------------------------------------------
+
+struct HealthCollector::ProbeSync {
+    std::mutex              mutex;
+    std::condition_variable done;
+};
+
+// Fields after stat_path are guarded by ProbeSync::mutex.
+struct HealthCollector::MountProbe {
+    std::string    stat_path;
+    bool           busy  = false;   // a statvfs() call is outstanding
+    bool           fresh = false;   // ... has returned and not been looked at yet
+    bool           ok    = false;
+    struct statvfs st{};
+    DiskInfo       last{};
+    bool           have_last = false;
+
+    // Turn a returned call into the last reading; an error hides the
+    // mount, as a failed statvfs() always has.
+    void absorb(const std::string& mount) {
+        if (!fresh) return;
+        fresh     = false;
+        have_last = ok;
+        if (!ok) return;
+        last.path          = mount;
+        last.total_kb      = (long)((st.f_blocks * st.f_frsize) / 1024);
+        last.free_kb       = (long)((st.f_bfree  * st.f_frsize) / 1024);
+        last.used_kb       = last.total_kb - last.free_kb;
+        last.usage_percent = (last.total_kb > 0)
+                           ? 100.0f * last.used_kb / last.total_kb : 0.0f;
+        last.inodes_total  = st.f_files;
+        last.inodes_free   = st.f_ffree <= st.f_files ? st.f_ffree : st.f_files;
+        last.inodes_used   = last.inodes_total - last.inodes_free;
+        last.inodes_usage_percent = (last.inodes_total > 0)
+                                  ? 100.0f * last.inodes_used / last.inodes_total : 0.0f;
+        last.stale         = false;
+    }
+};
+
+// procfs raises POLLPRI (and POLLERR) on an open mounts file once the
+// mount table has changed since it was opened or last polled, so the
+// listing, which runs to thousands of overlay and bind mounts on container
+// hosts, is only read and parsed again after a mount or unmount.  A plain
+// file (PROC_PATH fixtures) never signals and is parsed once.
+bool HealthCollector::refreshMountPoints() {
+    if (mounts_known_ && mounts_src_.fd() >= 0) {
+        pollfd pfd{mounts_src_.fd(), POLLPRI, 0};
+        ++threadIoCounters().syscalls;
+        if (::poll(&pfd, 1, 0) != 1 || !(pfd.revents & (POLLPRI | POLLERR))) return false;
+    }
+    std::vector<MountEntry> mounts;
+    parseMounts(mounts_src_.read(), mounts);
+    // a path mounted over, or bound twice, is listed once: statvfs() only
+    // sees the top mount, and the path is what identifies the entry
+    mount_points_.clear();
+    std::unordered_set<std::string> seen;
+    for (auto& m : mounts)
+        if (seen.insert(m.mount).second) mount_points_.push_back(std::move(m.mount));
+    mounts_known_ = true;
+    return true;
+}
+
+std::vector<DiskInfo> HealthCollector::getDiskInfo() {
+    const bool changed = refreshMountPoints();
+    const std::vector<std::string>& mounts = mount_points_;
+
+    std::vector<std::shared_ptr<MountProbe>> round;
+    std::vector<MountProbe*>                 submitted;
+    round.reserve(mounts.size());
+    const auto deadline = std::chrono::steady_clock::now() + source_deadline_;
+    std::unique_lock<std::mutex> lock(probe_sync_->mutex);
+    for (const auto& m : mounts) {
+        std::shared_ptr<MountProbe>& probe = probes_[m];
+        if (!probe) {
+            probe = std::make_shared<MountProbe>();
+            probe->stat_path = hostPathForMount(host_root_path_, m);
+        }
+        round.push_back(probe);
+        if (probe->busy) continue;
+        probe->absorb(m);   // a late answer from an earlier sample
+        probe->busy = true;
+        submitted.push_back(probe.get());
+        slow_pool_->submit([probe, sync = probe_sync_]() {
+            struct statvfs st{};
+            bool ok = statvfs(probe->stat_path.c_str(), &st) == 0;
+            {
+                std::lock_guard<std::mutex> lock(sync->mutex);
+                probe->st    = st;
+                probe->ok    = ok;
+                probe->busy  = false;
+                probe->fresh = true;
+            }
+            sync->done.notify_all();
+        });
+    }
+    threadIoCounters().syscalls += submitted.size();
 
-    // indices: user(0) nice(1) system(2) idle(3) iowait(4) ...
-    long idle1 = v1[3], idle2 = v2[3];
-    long total1 = 0, total2 = 0;
-    for (auto x : v1) total1 += x;
-    for (auto x : v2) total2 += x;
+    // a mount already stuck from an earlier sample is not waited for again
+    probe_sync_->done.wait_until(lock, deadline, [&submitted]() {
+        return std::none_of(submitted.begin(), submitted.end(), [](const MountProbe* p) { return p->busy; });
+    });
 
-    long d_total = total2 - total1;
-    long d_idle  = idle2  - idle1;
+    std::vector<DiskInfo> result;
+    result.reserve(mounts.size());
+    for (size_t i = 0; i < mounts.size(); ++i) {
+        MountProbe& probe = *round[i];
+        probe.absorb(mounts[i]);
+        if (probe.busy) {
+            if (!probe.have_last) {
+                probe.last      = DiskInfo{};
+                probe.last.path = mounts[i];
+            }
+            result.push_back(probe.last);
+            result.back().stale = true;
+        } else if (probe.have_last) {
+            result.push_back(probe.last);
+        }
+    }
 
-    if (d_total > 0) {
-        info.idle_percent  = 100.0f * d_idle / d_total;
-        info.usage_percent = 100.0f - info.idle_percent;
+    // forget unmounted paths, unless a call on them is still stuck; with an
+    // unchanged table there is nothing to forget but those stuck calls
+    if (!changed && probes_.size() == mounts.size()) return result;
+    for (auto it = probes_.begin(); it != probes_.end();) {
+        bool listed = std::find(mounts.begin(), mounts.end(), it->first) != mounts.end();
+        if (!listed && !it->second->busy) it = probes_.erase(it);
+        else ++it;
     }
-    return info;
+    return result;
 }
 
 // ---------------------------------------------------------------------------
-// Memory  –  /proc/meminfo
+// Counter rates  –  shared by memory, network and disk I/O
+//
+// The kernel exports these as unsigned long, which is 32 bits wide on
+// 32-bit kernels, so a counter may legitimately wrap.  A value that went
+// backwards from the upper half of the 32-bit range is taken as a wrap;
+// anything else means the device was re-created and its counters reset.
 // ---------------------------------------------------------------------------
 
-MemoryInfo HealthCollector::getMemoryInfo() {
-    MemoryInfo info{};
-    std::ifstream f(proc_path_ + "/meminfo");
-    std::string line;
-    while (std::getline(f, line)) {
-        std::istringstream ss(line);
-        std::string key; long val; std::string unit;
-        ss >> key >> val >> unit;
-        if      (key == "MemTotal:")     info.total_kb     = val;
-        else if (key == "MemFree:")      info.free_kb      = val;
-        else if (key == "MemAvailable:") info.available_kb = val;
-    }
-    info.used_kb = info.total_kb - info.free_kb;
-    if (info.total_kb > 0)
-        info.usage_percent = 100.0f * (info.total_kb - info.available_kb) / info.total_kb;
-    return info;
+static bool counterDelta(uint64_t cur, uint64_t prev, uint64_t& delta) {
+    if (cur >= prev) { delta = cur - prev; return true; }
+    if (prev >= (1ULL << 31) && prev <= 0xFFFFFFFFULL) {
+        delta = cur + (1ULL << 32) - prev;
+        return true;
+    }
+    return false;
+}
+
+// `hint` is the entry's index in the new reading: devices rarely change
+// order between samples, so with thousands of them the lookup is usually
+// a single compare instead of a scan.
+template <typename T>
+static const T* findByName(const std::vector<T>& v, const std::string& name, size_t hint) {
+    if (hint < v.size() && v[hint].name == name) return &v[hint];
+    for (const auto& e : v) if (e.name == name) return &e;
+    return nullptr;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point prev,
+                           std::chrono::steady_clock::time_point now) {
+    return std::chrono::duration<double>(now - prev).count();
 }
 
 // ---------------------------------------------------------------------------
-// Disk space  –  statvfs on mount points found in /proc/mounts
+// Network  –  rtnetlink RTM_GETLINK dump, or /proc/net/dev
+//
+// Both fill net_ in place; it is swapped with prev_net_ afterwards so the
+// two tables are reused from sample to sample.
 // ---------------------------------------------------------------------------
 
-std::vector<DiskInfo> HealthCollector::getDiskInfo() {
-    std::vector<DiskInfo> result;
-    std::ifstream f(proc_path_ + "/mounts");
-    std::string line;
-    while (std::getline(f, line)) {
-        std::istringstream ss(line);
-        std::string dev, mount, fstype;
-        ss >> dev >> mount >> fstype;
-        mount = decodeMountField(mount);
-        // skip pseudo filesystems
-        if (fstype == "proc" || fstype == "sysfs" || fstype == "tmpfs" ||
-            fstype == "devtmpfs" || fstype == "cgroup" || fstype == "cgroup2" ||
-            fstype == "devpts" || fstype == "overlay" || fstype == "none")
+// sysfs link speed in Mb/s; 0 for links that are down or have none (veth
+// reports a nominal 10000).
+static int64_t readLinkSpeed(const std::string& sysPath, const std::string& name) {
+    MetricSource src(sysPath + "/class/net/" + name + "/speed");
+    std::string_view text = src.read();
+    int64_t speed = 0;
+    std::from_chars(text.data(), text.data() + text.size(), speed);
+    return speed > 0 ? speed : 0;
+}
+
+std::vector<NetworkInterface> HealthCollector::getNetworkInterfaces() {
+    if (!netlink_ || !netlink_->dump(net_)) {
+        if (netlink_ && !netlink_fallback_) net_.clear();   // NET_BACKEND=netlink only
+        else parseNetDev(netdev_src_.read(), net_);
+    }
+    auto   now = std::chrono::steady_clock::now();
+    double dt  = secondsSince(prev_net_time_, now);
+
+    for (size_t i = 0; i < net_.size(); ++i) {
+        NetworkInterface& n = net_[i];
+        const NetworkInterface* prev = findByName(prev_net_, n.name, i);
+        // the speed only changes with the link state, so it is read for new
+        // interfaces and on state changes (never again for /proc/net/dev)
+        n.speed_mbps = (prev && prev->state == n.state) ? prev->speed_mbps : readLinkSpeed(sys_path_, n.name);
+        if (!prev || dt <= 0.0) continue;   // new interface: rates start next sample
+        uint64_t rxb, txb, rxp, txp;
+        if (!counterDelta(n.rx_bytes, prev->rx_bytes, rxb) ||
+            !counterDelta(n.tx_bytes, prev->tx_bytes, txb) ||
+            !counterDelta(n.rx_packets, prev->rx_packets, rxp) ||
+            !counterDelta(n.tx_packets, prev->tx_packets, txp))
             continue;
-        if (dev.rfind("/dev/", 0) != 0) continue;
+        n.rx_bytes_per_sec   = rxb / dt;
+        n.tx_bytes_per_sec   = txb / dt;
+        n.rx_packets_per_sec = rxp / dt;
+        n.tx_packets_per_sec = txp / dt;
+    }
+    // the swap also forgets interfaces that went away
+    std::vector<NetworkInterface> result = net_;
+    std::swap(net_, prev_net_);
+    prev_net_time_ = now;
+    return result;
+}
 
-        struct statvfs st{};
-        std::string statPath = hostPathForMount(host_root_path_, mount);
-        if (statvfs(statPath.c_str(), &st) != 0) continue;
+std::vector<DiskIO> HealthCollector::getDiskIOStats() {
+    std::vector<DiskIO> result;
+    parseDiskstats(diskstats_src_.read(), result);
+    auto   now = std::chrono::steady_clock::now();
+    double dt  = secondsSince(prev_disk_io_time_, now);
+
+    for (size_t i = 0; i < result.size(); ++i) {
+        DiskIO& io = result[i];
+        const DiskIO* prev = findByName(prev_disk_io_, io.name, i);
+        if (!prev || dt <= 0.0) continue;
+        uint64_t reads, writes, rsect, wsect, rms, wms, busy, weighted;
+        if (!counterDelta(io.reads_completed,  prev->reads_completed,  reads)  ||
+            !counterDelta(io.writes_completed, prev->writes_completed, writes) ||
+            !counterDelta(io.read_sectors,     prev->read_sectors,     rsect)  ||
+            !counterDelta(io.write_sectors,    prev->write_sectors,    wsect)  ||
+            !counterDelta(io.ms_reading,       prev->ms_reading,       rms)    ||
+            !counterDelta(io.ms_writing,       prev->ms_writing,       wms)    ||
+            !counterDelta(io.ms_io,            prev->ms_io,            busy)   ||
+            !counterDelta(io.weighted_ms_io,   prev->weighted_ms_io,   weighted))
+            continue;
 
-        DiskInfo di;
-        di.path         = mount;
-        di.total_kb     = (long)((st.f_blocks * st.f_frsize) / 1024);
-        di.free_kb      = (long)((st.f_bfree  * st.f_frsize) / 1024);
-        di.used_kb      = di.total_kb - di.free_kb;
-        di.usage_percent = (di.total_kb > 0)
-                         ? 100.0f * di.used_kb / di.total_kb : 0.0f;
-        result.push_back(di);
+        const double dtMs = dt * 1000.0;
+        io.reads_per_sec       = reads / dt;
+        io.writes_per_sec      = writes / dt;
+        io.read_bytes_per_sec  = rsect * 512.0 / dt;   // diskstats sectors are always 512 B
+        io.write_bytes_per_sec = wsect * 512.0 / dt;
+        io.read_latency_ms     = reads  ? static_cast<double>(rms) / reads  : 0.0;
+        io.write_latency_ms    = writes ? static_cast<double>(wms) / writes : 0.0;
+        io.queue_depth         = weighted / dtMs;
+        io.util_percent        = std::min(100.0, 100.0 * busy / dtMs);
     }
+    prev_disk_io_      = result;
+    prev_disk_io_time_ = now;
     return result;
 }
 
 // ---------------------------------------------------------------------------
-// Network  –  /proc/net/dev
+// Memory  –  /proc/meminfo, plus fault and swap rates from /proc/vmstat
 // ---------------------------------------------------------------------------
 
-std::vector<NetworkInterface> HealthCollector::getNetworkInterfaces() {
-    std::vector<NetworkInterface> result;
-    std::ifstream f(proc_path_ + "/net/dev");
-    std::string line;
-    int lineno = 0;
-    while (std::getline(f, line)) {
-        if (++lineno <= 2) continue;   // skip two header lines
-        std::istringstream ss(line);
-        std::string name;
-        ss >> name;
-        if (!name.empty() && name.back() == ':')
-            name.pop_back();
-        if (name == "lo") continue;
-
-        NetworkInterface ni;
-        ni.name = name;
-        long dummy;
-        ss >> ni.rx_bytes >> ni.rx_packets
-           >> dummy >> dummy >> dummy >> dummy >> dummy >> dummy
-           >> ni.tx_bytes >> ni.tx_packets;
-        result.push_back(ni);
+MemoryInfo HealthCollector::getMemoryInfo() {
+    MemoryInfo info{};
+    parseMeminfo(meminfo_src_.read(), info);
+
+    VmStat cur;
+    parseVmstat(vmstat_src_.read(), cur);
+    auto   now = std::chrono::steady_clock::now();
+    double dt  = secondsSince(prev_vmstat_time_, now);
+    info.oom_kills = cur.oom_kill;
+    uint64_t faults, major, in, out;
+    if (have_vmstat_ && dt > 0.0 &&
+        counterDelta(cur.pgfault,    prev_vmstat_.pgfault,    faults) &&
+        counterDelta(cur.pgmajfault, prev_vmstat_.pgmajfault, major)  &&
+        counterDelta(cur.pswpin,     prev_vmstat_.pswpin,     in)     &&
+        counterDelta(cur.pswpout,    prev_vmstat_.pswpout,    out)) {
+        info.page_faults_per_sec  = faults / dt;
+        info.major_faults_per_sec = major / dt;
+        info.swap_in_per_sec      = in / dt;
+        info.swap_out_per_sec     = out / dt;
     }
-    return result;
+    prev_vmstat_      = cur;
+    prev_vmstat_time_ = now;
+    have_vmstat_      = true;
+    return info;
 }
 
 // ---------------------------------------------------------------------------
-// Disk I/O  –  /proc/diskstats
+// Pressure  –  /proc/pressure/{cpu,memory,io}
+//
+// The kernel keeps the averages itself, so a sample is three reads.  A
+// kernel built without PSI (or booted with psi=0) has no such files, and
+// the group then reports available: false.
 // ---------------------------------------------------------------------------
 
-std::vector<DiskIO> HealthCollector::getDiskIOStats() {
-    std::vector<DiskIO> result;
-    std::ifstream f(proc_path_ + "/diskstats");
-    std::string line;
-    while (std::getline(f, line)) {
-        std::istringstream ss(line);
-        long major, minor;
-        std::string name;
-        ss >> major >> minor >> name;
-        // skip partitions (sda1, sdb2, …) and loop/ram devices
-        if (name.rfind("loop", 0) == 0 || name.rfind("ram", 0) == 0) continue;
-        bool hasDigit = false;
-        for (char c : name) if (std::isdigit(c)) { hasDigit = true; break; }
-        if (hasDigit) continue;
-
-        DiskIO di;
-        di.name = name;
-        long dummy;
-        ss >> di.reads_completed >> dummy >> di.read_sectors >> dummy
-           >> di.writes_completed >> dummy >> di.write_sectors;
-        result.push_back(di);
-    }
-    return result;
+PressureInfo HealthCollector::getPressureInfo() {
+    PressureInfo info;
+    PressureResource* const into[] = {&info.cpu, &info.memory, &info.io};
+    bool any = false;
+    for (size_t i = 0; i < std::size(into); ++i)
+        any |= parsePressure(pressure_srcs_[i].read(), *into[i]);
+    info.available = any;
+    return info;
+}
+
+// ---------------------------------------------------------------------------
+// Processes  –  top N by CPU, resident memory and I/O (see ProcessScanner)
+// ---------------------------------------------------------------------------
+
+std::vector<ProcessInfo> HealthCollector::getProcesses() {
+    return processes_->scan();
+}
+
+// ---------------------------------------------------------------------------
+// Kernel latency  –  histograms from the eBPF programs (see EbpfCollector)
+// ---------------------------------------------------------------------------
+
+KernelLatency HealthCollector::getKernelLatency() {
+    KernelLatency info;
+    cgroup_names_.clear();
+    for (const auto& c : cgroups_)
+        if (c.second.id) cgroup_names_.emplace(c.second.id, c.second.name);
+    ebpf_->read(info, cgroup_names_);
+    return info;
 }
 
 // ---------------------------------------------------------------------------
 // Temperature  –  /sys/class/thermal/thermal_zone*/temp
+//
+// Zones are discovered once; each temp file then stays open.  A zone that
+// stops answering triggers a rescan on the next call.
 // ---------------------------------------------------------------------------
 
-std::vector<ThermalZone> HealthCollector::getThermalZones() {
-    std::vector<ThermalZone> result;
+void HealthCollector::scanThermalZones() {
+    thermal_srcs_.clear();
     std::string base = sys_path_ + "/class/thermal";
     std::error_code ec;
     for (auto& entry : fs::directory_iterator(base, ec)) {
         std::string dir = entry.path().string();
         if (dir.find("thermal_zone") == std::string::npos) continue;
 
-        std::string typeFile = dir + "/type";
-        std::string tempFile = dir + "/temp";
-
-        std::ifstream tf(tempFile);
-        if (!tf.is_open()) continue;
+        ThermalSource zone;
+        zone.temp = MetricSource(dir + "/temp");
+        if (!zone.temp.open()) continue;
+
+        // the type never changes, so it is read once here
+        MetricSource type(dir + "/type");
+        std::string_view t = type.read();
+        while (!t.empty() && (t.back() == '\n' || t.back() == ' ')) t.remove_suffix(1);
+        zone.zone = entry.path().filename().string();
+        zone.name = t.empty() ? zone.zone : std::string(t);
+        thermal_srcs_.push_back(std::move(zone));
+    }
+    thermal_scanned_ = true;
+}
 
-        long raw = 0;
-        tf >> raw;
+std::vector<ThermalZone> HealthCollector::getThermalZones() {
+    if (!thermal_scanned_) scanThermalZones();
 
-        std::string typeName = entry.path().filename().string();
-        std::ifstream tyf(typeFile);
-        if (tyf.is_open()) std::getline(tyf, typeName);
+    std::vector<ThermalZone> result;
+    result.reserve(thermal_srcs_.size());
+    bool lost = false;
+    for (auto& zone : thermal_srcs_) {
+        std::string_view v = zone.temp.read();
+        if (v.empty()) { lost = true; continue; }
 
+        long raw = 0;
+        std::from_chars(v.data(), v.data() + v.size(), raw);
         ThermalZone tz;
-        tz.name                = typeName;
+        tz.zone                = zone.zone;
+        tz.name                = zone.name;
         tz.temperature_celsius = raw / 1000.0f;
         result.push_back(tz);
     }
+    if (lost) thermal_scanned_ = false;
     return result;
 }
 
 // ---------------------------------------------------------------------------
-// Static member definitions
+// Docker containers  –  table maintained from the Engine API /events stream
 // ---------------------------------------------------------------------------
 
-SpeedTestResult HealthCollector::s_speedResult;
-std::mutex      HealthCollector::s_speedMutex;
+std::vector<DockerContainer> HealthCollector::getDockerContainers() {
+    auto table = docker_->table();
+    std::time_t now = std::time(nullptr);
+    // while the watcher reconnects the table is the last state it saw
+    bool connected = docker_->connected();
+
+    std::vector<DockerContainer> result;
+    result.reserve(table->size());
+    for (const auto& e : *table) {
+        result.push_back(e.container);
+        result.back().status = formatContainerStatus(e.container, e.started_at, now);
+        result.back().stale  = !connected;
+    }
+    if (!cgroup_root_.empty()) readContainerStats(result);
+    return result;
+}
 
 // ---------------------------------------------------------------------------
-// Docker containers  –  `docker ps`
+// Container resources  –  cgroup v2 cpu.stat / memory.* / io.stat
+//
+// Four small reads per container per sample on files that stay open.  The
+// directory depends on Docker's cgroup driver: systemd puts containers in
+// system.slice/docker-<id>.scope, cgroupfs in docker/<id>.
 // ---------------------------------------------------------------------------
 
-// Extract a value from a tab-separated field produced by docker ps --format
-static std::string extractHealth(const std::string& status) {
-    // Status examples:
-    //   "Up 2 hours (healthy)"
-    //   "Up 3 minutes (unhealthy)"
-    //   "Up 5 minutes (health: starting)"
-    //   "Up 2 hours"  → no health check
-    //   "Exited (0) ..."
-    auto lp = status.find('(');
-    if (lp == std::string::npos) return "none";
-    auto rp = status.find(')', lp);
-    std::string inner = status.substr(lp + 1, rp == std::string::npos ? std::string::npos : rp - lp - 1);
-    if (inner == "healthy")   return "healthy";
-    if (inner == "unhealthy") return "unhealthy";
-    if (inner.rfind("health:", 0) == 0) return "starting";
-    return "none";
+static bool openCgroup(const std::string& root, const std::string& fullId, MetricSource& cpuStat, std::string& dir) {
+    const std::string candidates[] = {
+        root + "/system.slice/docker-" + fullId + ".scope",
+        root + "/docker/" + fullId,
+    };
+    for (const auto& c : candidates) {
+        cpuStat = MetricSource(c + "/cpu.stat");
+        if (cpuStat.open()) { dir = c; return true; }
+    }
+    return false;
 }
 
-std::vector<DockerContainer> HealthCollector::getDockerContainers() {
-    std::vector<DockerContainer> result;
-    // Use tab-separated format to avoid needing a JSON parser
-    FILE* fp = popen(
-        "docker ps --format \"{{.ID}}\\t{{.Image}}\\t{{.Names}}\\t{{.Status}}\\t{{.State}}\" 2>/dev/null",
-        "r");
-    if (!fp) return result;
-
-    char buf[1024];
-    while (fgets(buf, sizeof(buf), fp)) {
-        std::string line(buf);
-        // strip trailing newline
-        if (!line.empty() && line.back() == '\n') line.pop_back();
-
-        std::istringstream ss(line);
-        DockerContainer c;
-        std::getline(ss, c.id,     '\t');
-        std::getline(ss, c.image,  '\t');
-        std::getline(ss, c.names,  '\t');
-        std::getline(ss, c.status, '\t');
-        std::getline(ss, c.state,  '\t');
-        c.health = extractHealth(c.status);
-        if (!c.id.empty()) result.push_back(c);
-    }
-    pclose(fp);
-    return result;
+void HealthCollector::readContainerStats(std::vector<DockerContainer>& containers) {
+    auto now = std::chrono::steady_clock::now();
+    ++cgroup_pass_;
+    for (auto& c : containers) {
+        if (c.full_id.empty()) continue;
+        auto it = cgroups_.find(c.full_id);
+        if (it == cgroups_.end()) {
+            // not there yet while the container starts: retried next sample
+            CgroupSource src;
+            std::string  dir;
+            if (!openCgroup(cgroup_root_, c.full_id, src.cpu_stat, dir)) continue;
+            src.memory_current = MetricSource(dir + "/memory.current");
+            src.memory_stat    = MetricSource(dir + "/memory.stat");
+            src.io_stat        = MetricSource(dir + "/io.stat");
+            struct stat st;
+            if (::stat(dir.c_str(), &st) == 0) src.id = st.st_ino;
+            it = cgroups_.emplace(c.full_id, std::move(src)).first;
+        }
+        CgroupSource& src = it->second;
+
+        std::string_view cpu = src.cpu_stat.read();
+        if (cpu.empty()) { cgroups_.erase(it); continue; }   // removed under us
+        ContainerStats& s = c.resources;
+        parseCgroupCpuStat(cpu, s);
+        std::string_view mem = src.memory_current.read();
+        std::from_chars(mem.data(), mem.data() + mem.size(), s.memory_bytes);
+        parseCgroupMemoryStat(src.memory_stat.read(), s);
+        parseCgroupIoStat(src.io_stat.read(), s);
+        s.available = true;
+
+        double dt = secondsSince(src.prev_time, now);
+        if (src.seen && dt > 0.0) {
+            uint64_t cpuUs, rb, wb;
+            if (counterDelta(s.cpu_usage_usec, src.prev.cpu_usage_usec, cpuUs))
+                s.cpu_percent = 100.0 * cpuUs / (dt * 1e6);
+            // io.stat drops a device's line when it goes away, so each sum
+            // can shrink on its own
+            if (counterDelta(s.io_read_bytes, src.prev.io_read_bytes, rb))   s.io_read_bytes_per_sec  = rb / dt;
+            if (counterDelta(s.io_write_bytes, src.prev.io_write_bytes, wb)) s.io_write_bytes_per_sec = wb / dt;
+        }
+        src.prev      = s;
+        src.prev_time = now;
+        src.seen      = cgroup_pass_;
+        src.name      = c.names;
+    }
+    for (auto i = cgroups_.begin(); i != cgroups_.end();) {
+        if (i->second.seen != cgroup_pass_) i = cgroups_.erase(i);
+        else ++i;
+    }
 }
 
 // ---------------------------------------------------------------------------
-// Internet speed test  –  cached, refreshed every 1 h from a background thread
-// Uses speedtest-cli if available, otherwise falls back to curl download test.
+// Assemble JSON
 // ---------------------------------------------------------------------------
 
-static std::string runCommand(const char* cmd) {
-    FILE* fp = popen(cmd, "r");
-    if (!fp) return "";
-    char buf[256];
+// Run one collector, charging its wall time and I/O to group `bit`.
+template <typename Fn>
+static auto measured(uint32_t bit, Fn fn) {
+    IoCounters& io     = threadIoCounters();
+    IoCounters  before = io;
+    auto        start  = std::chrono::steady_clock::now();
+    auto        result = fn();
+    auto        ns     = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+    SourceStats& stats = selfMetrics().source(__builtin_ctz(bit));
+    stats.wall.record(static_cast<uint64_t>(ns.count()));
+    stats.syscalls.fetch_add(io.syscalls - before.syscalls, std::memory_order_relaxed);
+    stats.bytes_read.fetch_add(io.bytes_read - before.bytes_read, std::memory_order_relaxed);
+    return result;
+}
+
+HealthData HealthCollector::collect(uint32_t groups) {
+    HealthData d;
+    d.timestamp = std::time(nullptr);
+    d.groups    = groups & groups_;
+    d.refreshed = d.groups;
+    if (d.groups & kGroupCpu)         d.cpu         = measured(kGroupCpu,         [this] { return getCpuInfo(); });
+    if (d.groups & kGroupMemory)      d.memory      = measured(kGroupMemory,      [this] { return getMemoryInfo(); });
+    if (d.groups & kGroupDisks)       d.disks       = measured(kGroupDisks,       [this] { return getDiskInfo(); });
+    if (d.groups & kGroupNetwork)     d.network     = measured(kGroupNetwork,     [this] { return getNetworkInterfaces(); });
+    if (d.groups & kGroupDiskIO)      d.disk_io     = measured(kGroupDiskIO,      [this] { return getDiskIOStats(); });
+    if (d.groups & kGroupTemperature) d.temperature = measured(kGroupTemperature, [this] { return getThermalZones(); });
+    if (d.groups & kGroupDocker)      d.docker      = measured(kGroupDocker,      [this] { return getDockerContainers(); });
+    if (d.groups & kGroupPressure)    d.pressure    = measured(kGroupPressure,    [this] { return getPressureInfo(); });
+    if (d.groups & kGroupProcesses)   d.processes   = measured(kGroupProcesses,   [this] { return getProcesses(); });
+    // after docker, whose cgroups name the per-container entries
+    if (d.groups & kGroupLatency)     d.latency     = measured(kGroupLatency,     [this] { return getKernelLatency(); });
+
+    // last result of the speed test thread
+    if (d.groups & kGroupSpeed) d.speed = speed_->latest();
+    return d;
+}
+
+std::string HealthCollector::getHealthJson() {
+    return toJson(collect());
+}
+
+std::string HealthCollector::toJson(const HealthData& d, bool pretty) {
     std::string out;
-    while (fgets(buf, sizeof(buf), fp)) out += buf;
-    pclose(fp);
-    // strip trailing whitespace
-    while (!out.empty() && (out.back() == '\n' || out.back() == '\r' || out.back() == ' '))
-        out.pop_back();
+    writeJson(d, out, pretty);
     return out;
 }
 
-void HealthCollector::updateSpeedTestCache() {
-    SpeedTestResult res;
-
-    // Prefer speedtest-cli (pip install speedtest-cli)
-    std::string which = runCommand("which speedtest-cli 2>/dev/null");
-    if (!which.empty()) {
-        // speedtest-cli --simple outputs:
-        //   Ping: X ms
-        //   Download: X Mbit/s
-        //   Upload: X Mbit/s
-        std::string out = runCommand("speedtest-cli --simple 2>/dev/null");
-        std::istringstream ss(out);
-        std::string line;
-        while (std::getline(ss, line)) {
-            if (line.rfind("Download:", 0) == 0) {
-                std::istringstream ls(line.substr(9));
-                ls >> res.download_mbps;
-            } else if (line.rfind("Upload:", 0) == 0) {
-                std::istringstream ls(line.substr(7));
-                ls >> res.upload_mbps;
-            }
-        }
-        res.available = (res.download_mbps > 0.0f || res.upload_mbps > 0.0f);
-    }
-
-    // Fallback: curl download test against Cloudflare speed endpoint
-    if (!res.available) {
-        std::string out = runCommand(
-            "curl -s --max-time 20 -o /dev/null "
-            "-w \"%{speed_download}\" "
-            "https://speed.cloudflare.com/__down?bytes=5000000 2>/dev/null");
-        if (!out.empty()) {
-            try {
-                float bytesPerSec = std::stof(out);
-                res.download_mbps = bytesPerSec * 8.0f / 1e6f;
-                res.available = (res.download_mbps > 0.0f);
-            } catch (...) {}
-        }
+// ---------------------------------------------------------------------------
+// Groups  –  one writer per top-level key, for JsonWriter and CborWriter
+//
+// List groups are written one entry at a time so the CBOR renderer can
+// note where each disk, interface, container ... starts.
+// ---------------------------------------------------------------------------
+
+template <typename W, typename T>
+static void writeCpuPercentages(W& w, const T& c) {
+    w.field("usage_percent",   c.usage_percent);
+    if constexpr (std::is_same_v<T, CpuInfo>) w.field("idle_percent", c.idle_percent);
+    w.field("user_percent",    c.user_percent);
+    w.field("system_percent",  c.system_percent);
+    w.field("iowait_percent",  c.iowait_percent);
+    w.field("irq_percent",     c.irq_percent);
+    w.field("softirq_percent", c.softirq_percent);
+    w.field("steal_percent",   c.steal_percent);
+}
+
+template <typename W>
+static void writeCpu(W& w, const CpuInfo& cpu) {
+    w.beginObject();
+    writeCpuPercentages(w, cpu);
+    w.key("cores");
+    w.beginArray();
+    for (const auto& c : cpu.cores) {
+        w.beginObject();
+        w.field("id", c.id);
+        writeCpuPercentages(w, c);
+        w.endObject();
     }
+    w.endArray();
+    w.endObject();
+}
 
-    // Timestamp
-    std::time_t now = std::time(nullptr);
-    char tsBuf[32];
-    std::strftime(tsBuf, sizeof(tsBuf), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
-    res.timestamp = tsBuf;
+template <typename W>
+static void writeMemory(W& w, const MemoryInfo& mem) {
+    w.beginObject();
+    w.field("total_kb",      mem.total_kb);
+    w.field("used_kb",       mem.used_kb);
+    w.field("free_kb",       mem.free_kb);
+    w.field("available_kb",  mem.available_kb);
+    w.field("usage_percent", mem.usage_percent);
+    w.field("buffers_kb",    mem.buffers_kb);
+    w.field("cached_kb",     mem.cached_kb);
+    w.field("swap_total_kb", mem.swap_total_kb);
+    w.field("swap_used_kb",  mem.swap_used_kb);
+    w.field("swap_free_kb",  mem.swap_free_kb);
+    w.field("dirty_kb",      mem.dirty_kb);
+    w.field("writeback_kb",  mem.writeback_kb);
+    w.field("page_faults_per_sec",  mem.page_faults_per_sec);
+    w.field("major_faults_per_sec", mem.major_faults_per_sec);
+    w.field("swap_in_per_sec",      mem.swap_in_per_sec);
+    w.field("swap_out_per_sec",     mem.swap_out_per_sec);
+    w.field("oom_kills",            mem.oom_kills);
+    w.endObject();
+}
+
+template <typename W>
+static void writeEntry(W& w, const DiskInfo& d) {
+    w.beginObject();
+    w.field("path",          d.path);
+    w.field("total_kb",      d.total_kb);
+    w.field("used_kb",       d.used_kb);
+    w.field("free_kb",       d.free_kb);
+    w.field("usage_percent", d.usage_percent);
+    w.field("inodes_total",  d.inodes_total);
+    w.field("inodes_used",   d.inodes_used);
+    w.field("inodes_free",   d.inodes_free);
+    w.field("inodes_usage_percent", d.inodes_usage_percent);
+    w.field("stale",         d.stale);
+    w.endObject();
+}
+
+template <typename W>
+static void writeEntry(W& w, const NetworkInterface& n) {
+    w.beginObject();
+    w.field("name",               n.name);
+    w.field("rx_bytes",           n.rx_bytes);
+    w.field("tx_bytes",           n.tx_bytes);
+    w.field("rx_packets",         n.rx_packets);
+    w.field("tx_packets",         n.tx_packets);
+    w.field("rx_errors",          n.rx_errors);
+    w.field("tx_errors",          n.tx_errors);
+    w.field("rx_dropped",         n.rx_dropped);
+    w.field("tx_dropped",         n.tx_dropped);
+    w.field("rx_bytes_per_sec",   n.rx_bytes_per_sec);
+    w.field("tx_bytes_per_sec",   n.tx_bytes_per_sec);
+    w.field("rx_packets_per_sec", n.rx_packets_per_sec);
+    w.field("tx_packets_per_sec", n.tx_packets_per_sec);
+    w.field("state",              n.state);
+    w.field("speed_mbps",         n.speed_mbps);
+    w.endObject();
+}
 
-    std::lock_guard<std::mutex> lock(s_speedMutex);
-    s_speedResult = res;
+template <typename W>
+static void writeEntry(W& w, const DiskIO& io) {
+    w.beginObject();
+    w.field("name",                io.name);
+    w.field("reads_completed",     io.reads_completed);
+    w.field("writes_completed",    io.writes_completed);
+    w.field("read_sectors",        io.read_sectors);
+    w.field("write_sectors",       io.write_sectors);
+    w.field("in_flight",           io.ios_in_progress);
+    w.field("reads_per_sec",       io.reads_per_sec);
+    w.field("writes_per_sec",      io.writes_per_sec);
+    w.field("read_bytes_per_sec",  io.read_bytes_per_sec);
+    w.field("write_bytes_per_sec", io.write_bytes_per_sec);
+    w.field("read_latency_ms",     io.read_latency_ms);
+    w.field("write_latency_ms",    io.write_latency_ms);
+    w.field("queue_depth",         io.queue_depth);
+    w.field("util_percent",        io.util_percent);
+    w.endObject();
 }
 
+template <typename W>
+static void writeEntry(W& w, const ThermalZone& t) {
+    w.beginObject();
+    w.field("zone",                t.zone);
+    w.field("name",                t.name);
+    w.field("temperature_celsius", t.temperature_celsius);
+    w.endObject();
+}
 
+template <typename W>
+static void writeEntry(W& w, const DockerContainer& c) {
+    w.beginObject();
+    w.field("id",     c.id);
+    w.field("image",  c.image);
+    w.field("names",  c.names);
+    w.field("status", c.status);
+    w.field("state",  c.state);
+    w.field("health", c.health);
+    w.field("stale",  c.stale);
+    const ContainerStats& r = c.resources;
+    w.key("resources");
+    w.beginObject();
+    w.field("available",              r.available);
+    w.field("cpu_percent",            r.cpu_percent);
+    w.field("cpu_usage_usec",         r.cpu_usage_usec);
+    w.field("cpu_user_usec",          r.cpu_user_usec);
+    w.field("cpu_system_usec",        r.cpu_system_usec);
+    w.field("cpu_throttled_usec",     r.cpu_throttled_usec);
+    w.field("cpu_nr_throttled",       r.cpu_nr_throttled);
+    w.field("memory_bytes",           r.memory_bytes);
+    w.field("memory_anon_bytes",      r.memory_anon_bytes);
+    w.field("memory_file_bytes",      r.memory_file_bytes);
+    w.field("io_read_bytes",          r.io_read_bytes);
+    w.field("io_write_bytes",         r.io_write_bytes);
+    w.field("io_read_ops",            r.io_read_ops);
+    w.field("io_write_ops",           r.io_write_ops);
+    w.field("io_read_bytes_per_sec",  r.io_read_bytes_per_sec);
+    w.field("io_write_bytes_per_sec", r.io_write_bytes_per_sec);
+    w.endObject();
+    w.endObject();
+}
+
+template <typename W>
+static void writeSpeed(W& w, const SpeedTestResult& speed) {
+    w.beginObject();
+    w.field("available",     speed.available);
+    w.field("download_mbps", speed.download_mbps);
+    w.field("upload_mbps",   speed.upload_mbps);
+    w.field("latency_ms",    speed.latency_ms);
+    w.field("jitter_ms",     speed.jitter_ms);
+    w.field("bytes_used",    speed.bytes_used);
+    w.field("last_checked",  speed.timestamp);
+    w.field("stale",         speed.stale);
+    w.endObject();
+}
+
+template <typename W>
+static void writeEntry(W& w, const ProcessInfo& p) {
+    w.beginObject();
+    w.field("pid",           p.pid);
+    w.field("name",          p.name);
+    w.field("state",         p.state);
+    w.field("threads",       p.threads);
+    w.field("cpu_percent",   p.cpu_percent);
+    w.field("rss_bytes",     p.rss_bytes);
+    w.field("virtual_bytes", p.virtual_bytes);
+    w.field("io_read_bytes_per_sec",  p.io_read_bytes_per_sec);
+    w.field("io_write_bytes_per_sec", p.io_write_bytes_per_sec);
+    w.endObject();
+}
+
+template <typename W>
+static void writePressureLine(W& w, const char* name, const PressureLine& l) {
+    w.key(name);
+    w.beginObject();
+    w.field("avg10",      l.avg10);
+    w.field("avg60",      l.avg60);
+    w.field("avg300",     l.avg300);
+    w.field("total_usec", l.total_usec);
+    w.endObject();
+}
+
+// count and quantiles since the previous sample, into the open object
+template <typename W>
+static void writeDistribution(W& w, const LatencyDistribution& l) {
+    w.field("count",   l.count);
+    w.field("mean_us", l.mean_us);
+    w.field("p50_us",  l.p50_us);
+    w.field("p99_us",  l.p99_us);
+}
+
+template <typename W>
+static void writeLatency(W& w, const KernelLatency& k) {
+    w.beginObject();
+    w.field("available", k.available);
+    if (!k.available) {
+        w.field("error", k.error);
+        w.endObject();
+        return;
+    }
+    w.key("runq");
+    w.beginObject();
+    writeDistribution(w, k.runq);
+    w.endObject();
+    w.key("cpus");
+    w.beginArray();
+    for (const auto& c : k.cpus) {
+        w.beginObject();
+        w.field("cpu", c.cpu);
+        writeDistribution(w, c.runq);
+        w.endObject();
+    }
+    w.endArray();
+    w.key("block");
+    w.beginArray();
+    for (const auto& d : k.block) {
+        w.beginObject();
+        w.field("name", d.name);
+        writeDistribution(w, d.io);
+        w.endObject();
+    }
+    w.endArray();
+    w.key("containers");
+    w.beginArray();
+    for (const auto& c : k.containers) {
+        w.beginObject();
+        w.field("name", c.name);
+        writeDistribution(w, c.runq);
+        w.endObject();
+    }
+    w.endArray();
+    w.field("tcp_retransmits",         k.tcp_retransmits);
+    w.field("tcp_retransmits_per_sec", k.tcp_retransmits_per_sec);
+    w.endObject();
+}
+
+template <typename W>
+static void writePressure(W& w, const PressureInfo& p) {
+    w.beginObject();
+    w.field("available", p.available);
+    const std::pair<const char*, const PressureResource*> resources[] = {
+        {"cpu", &p.cpu}, {"memory", &p.memory}, {"io", &p.io},
+    };
+    for (const auto& r : resources) {
+        w.key(r.first);
+        w.beginObject();
+        writePressureLine(w, "some", r.second->some);
+        writePressureLine(w, "full", r.second->full);
+        w.endObject();
+    }
+    w.endObject();
+}
 
 // ---------------------------------------------------------------------------
-// Assemble JSON
+// Groups
 // ---------------------------------------------------------------------------
 
-std::string HealthCollector::getHealthJson() {
-    auto cpu    = getCpuInfo();
-    auto mem    = getMemoryInfo();
-    auto disks  = getDiskInfo();
-    auto nets   = getNetworkInterfaces();
-    auto ios    = getDiskIOStats();
-    auto temps  = getThermalZones();
-    auto dockers = getDockerContainers();
-
-    // Snapshot cached speed result
-    SpeedTestResult speed;
-    {
-        std::lock_guard<std::mutex> lock(s_speedMutex);
-        speed = s_speedResult;
-    }
-
-    // ISO-8601 timestamp
-    std::time_t now = std::time(nullptr);
-    char tsBuf[32];
-    std::strftime(tsBuf, sizeof(tsBuf), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
-
-    std::ostringstream j;
-    j << "{\n";
-    j << "  \"timestamp\": \"" << tsBuf << "\",\n";
-
-    // CPU
-    j << "  \"cpu\": {\n"
-      << "    \"usage_percent\": " << cpu.usage_percent << ",\n"
-      << "    \"idle_percent\": "  << cpu.idle_percent  << "\n"
-      << "  },\n";
-
-    // Memory
-    j << "  \"memory\": {\n"
-      << "    \"total_kb\": "     << mem.total_kb     << ",\n"
-      << "    \"used_kb\": "      << mem.used_kb      << ",\n"
-      << "    \"free_kb\": "      << mem.free_kb      << ",\n"
-      << "    \"available_kb\": " << mem.available_kb << ",\n"
-      << "    \"usage_percent\": "<< mem.usage_percent<< "\n"
-      << "  },\n";
-
-    // Disks
-    j << "  \"disks\": [\n";
-    for (size_t i = 0; i < disks.size(); ++i) {
-        const auto& d = disks[i];
-        j << "    {\n"
-          << "      \"path\": \""          << escapeJson(d.path)   << "\",\n"
-          << "      \"total_kb\": "        << d.total_kb           << ",\n"
-          << "      \"used_kb\": "         << d.used_kb            << ",\n"
-          << "      \"free_kb\": "         << d.free_kb            << ",\n"
-          << "      \"usage_percent\": "   << d.usage_percent      << "\n"
-          << "    }" << (i + 1 < disks.size() ? "," : "") << "\n";
-    }
-    j << "  ],\n";
-
-    // Network
-    j << "  \"network\": [\n";
-    for (size_t i = 0; i < nets.size(); ++i) {
-        const auto& n = nets[i];
-        j << "    {\n"
-          << "      \"name\": \""      << escapeJson(n.name) << "\",\n"
-          << "      \"rx_bytes\": "    << n.rx_bytes         << ",\n"
-          << "      \"tx_bytes\": "    << n.tx_bytes         << ",\n"
-          << "      \"rx_packets\": "  << n.rx_packets       << ",\n"
-          << "      \"tx_packets\": "  << n.tx_packets       << "\n"
-          << "    }" << (i + 1 < nets.size() ? "," : "") << "\n";
-    }
-    j << "  ],\n";
-
-    // Disk I/O
-    j << "  \"disk_io\": [\n";
-    for (size_t i = 0; i < ios.size(); ++i) {
-        const auto& io = ios[i];
-        j << "    {\n"
-          << "      \"name\": \""             << escapeJson(io.name)     << "\",\n"
-          << "      \"reads_completed\": "    << io.reads_completed      << ",\n"
-          << "      \"writes_completed\": "   << io.writes_completed     << ",\n"
-          << "      \"read_sectors\": "       << io.read_sectors         << ",\n"
-          << "      \"write_sectors\": "      << io.write_sectors        << "\n"
-          << "    }" << (i + 1 < ios.size() ? "," : "") << "\n";
-    }
-    j << "  ],\n";
-
-    // Temperature
-    j << "  \"temperature\": [\n";
-    for (size_t i = 0; i < temps.size(); ++i) {
-        const auto& t = temps[i];
-        j << "    {\n"
-          << "      \"name\": \""               << escapeJson(t.name) << "\",\n"
-          << "      \"temperature_celsius\": "  << t.temperature_celsius << "\n"
-          << "    }" << (i + 1 < temps.size() ? "," : "") << "\n";
-    }
-    j << "  ],\n";
-
-    // Docker containers
-    j << "  \"docker\": [\n";
-    for (size_t i = 0; i < dockers.size(); ++i) {
-        const auto& c = dockers[i];
-        j << "    {\n"
-          << "      \"id\": \""     << escapeJson(c.id)     << "\",\n"
-          << "      \"image\": \""  << escapeJson(c.image)  << "\",\n"
-          << "      \"names\": \""  << escapeJson(c.names)  << "\",\n"
-          << "      \"status\": \"" << escapeJson(c.status) << "\",\n"
-          << "      \"state\": \""  << escapeJson(c.state)  << "\",\n"
-          << "      \"health\": \"" << escapeJson(c.health) << "\"\n"
-          << "    }" << (i + 1 < dockers.size() ? "," : "") << "\n";
-    }
-    j << "  ],\n";
-
-    // Internet speed (cached)
-    j << "  \"internet_speed\": {\n"
-      << "    \"available\": "       << (speed.available ? "true" : "false") << ",\n"
-      << "    \"download_mbps\": "   << speed.download_mbps                  << ",\n"
-      << "    \"upload_mbps\": "     << speed.upload_mbps                    << ",\n"
-      << "    \"last_checked\": \""  << escapeJson(speed.timestamp)          << "\"\n"
-      << "  }\n";
-
-    j << "}\n";
-    return j.str();
+static const char* const kGroupNames[kMetricGroupCount] = {
+    "cpu", "memory", "disks", "network", "disk_io", "temperature", "docker", "internet_speed", "pressure",
+    "processes", "latency",
+};
+
+const char* metricGroupName(int index) {
+    return (index >= 0 && index < kMetricGroupCount) ? kGroupNames[index] : "";
+}
+
+int metricGroupIndex(std::string_view name) {
+    for (int i = 0; i < kMetricGroupCount; ++i)
+        if (name == kGroupNames[i]) return i;
+    return -1;
+}
+
+bool parseMetricGroups(std::string_view list, uint32_t& mask) {
+    mask = 0;
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view name = list.substr(0, comma);
+        if (!name.empty()) {
+            int i = metricGroupIndex(name);
+            if (i < 0) return false;
+            mask |= 1u << i;
+        }
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return true;
+}
+
+template <typename W, typename T>
+static void writeList(W& w, const std::vector<T>& entries) {
+    w.beginArray();
+    for (const auto& e : entries) writeEntry(w, e);
+    w.endArray();
+}
+
+template <typename W>
+static void writeGroup(W& w, const HealthData& d, int index) {
+    switch (1u << index) {
+    case kGroupCpu:         writeCpu(w, d.cpu);              break;
+    case kGroupMemory:      writeMemory(w, d.memory);        break;
+    case kGroupDisks:       writeList(w, d.disks);           break;
+    case kGroupNetwork:     writeList(w, d.network);         break;
+    case kGroupDiskIO:      writeList(w, d.disk_io);         break;
+    case kGroupTemperature: writeList(w, d.temperature);     break;
+    case kGroupDocker:      writeList(w, d.docker);          break;
+    case kGroupSpeed:       writeSpeed(w, d.speed);          break;
+    case kGroupPressure:    writePressure(w, d.pressure);    break;
+    case kGroupProcesses:   writeList(w, d.processes);       break;
+    case kGroupLatency:     writeLatency(w, d.latency);      break;
+    }
+}
+
+// What identifies an entry of a list group across samples
+static const std::string& entryKey(const DiskInfo& d)         { return d.path; }
+static const std::string& entryKey(const NetworkInterface& n) { return n.name; }
+static const std::string& entryKey(const DiskIO& io)          { return io.name; }
+static const std::string& entryKey(const ThermalZone& t)      { return t.zone; }
+static const std::string& entryKey(const DockerContainer& c)  { return c.id; }
+static const std::string& entryKey(const ProcessInfo& p)      { return p.key; }
+
+template <typename T>
+static void writeCborList(CborWriter& w, int index, const std::vector<T>& list, std::vector<CborEntry>* entries) {
+    w.beginArray();
+    for (const auto& e : list) {
+        size_t start = w.size();
+        writeEntry(w, e);
+        if (entries) entries->push_back(CborEntry{index, entryKey(e), start, w.size() - start});
+    }
+    w.endArray();
+}
+
+std::string HealthCollector::isoTimestamp(std::time_t t) {
+    char buf[32];
+    std::tm tm{};
+    gmtime_r(&t, &tm);
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    return buf;
+}
+
+void HealthCollector::writeJson(const HealthData& d, std::string& out, bool pretty) {
+    JsonWriter w(out, pretty);
+    w.beginObject();
+    w.field("timestamp", isoTimestamp(d.timestamp));
+    for (int i = 0; i < kMetricGroupCount; ++i) {
+        if (!(d.groups & (1u << i))) continue;
+        w.key(kGroupNames[i]);
+        writeGroup(w, d, i);
+    }
+    w.endObject();
+}
+
+void HealthCollector::writeGroupJson(const HealthData& d, int index, std::string& out) {
+    JsonWriter w(out, false);
+    writeGroup(w, d, index);
+}
+
+void HealthCollector::writeCbor(const HealthData& d, uint64_t sequence, uint64_t instance, std::string& out,
+                                std::vector<CborEntry>* entries) {
+    if (entries) entries->clear();
+    CborWriter w(out);
+    w.beginObject();
+    w.field("sequence",  sequence);
+    w.field("instance",  instance);
+    w.field("timestamp", isoTimestamp(d.timestamp));
+    for (int i = 0; i < kMetricGroupCount; ++i) {
+        if (!(d.groups & (1u << i))) continue;
+        w.key(kGroupNames[i]);
+        switch (1u << i) {
+        case kGroupDisks:       writeCborList(w, i, d.disks,       entries); break;
+        case kGroupNetwork:     writeCborList(w, i, d.network,     entries); break;
+        case kGroupDiskIO:      writeCborList(w, i, d.disk_io,     entries); break;
+        case kGroupTemperature: writeCborList(w, i, d.temperature, entries); break;
+        case kGroupDocker:      writeCborList(w, i, d.docker,      entries); break;
+        case kGroupProcesses:   writeCborList(w, i, d.processes,   entries); break;
+        default: {
+            size_t start = w.size();
+            writeGroup(w, d, i);
+            if (entries) entries->push_back(CborEntry{i, {}, start, w.size() - start});
+        }
+        }
+    }
+    w.endObject();
 }
@@ -1,88 +1,475 @@
 #pragma once
 
+#include "metric_source.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+// stale: statvfs() did not answer within the source deadline (a hung
+// network mount); the figures are the last ones that did, or 0.
 struct DiskInfo {
     std::string path;
     long total_kb;
     long used_kb;
     long free_kb;
     float usage_percent;
+    // 0 on filesystems without a fixed inode table (btrfs, some FUSE)
+    uint64_t inodes_total = 0;
+    uint64_t inodes_used  = 0;
+    uint64_t inodes_free  = 0;
+    float    inodes_usage_percent = 0.0f;
+    bool stale = false;
+};
+
+// Raw jiffies of one "cpu" / "cpuN" line of /proc/stat.  guest/guest_nice
+// are already accounted inside user/nice and are therefore not kept.
+struct CpuTimes {
+    int      cpu     = -1;   // -1 for the aggregate "cpu" line
+    uint64_t user    = 0;
+    uint64_t nice    = 0;
+    uint64_t system  = 0;
+    uint64_t idle    = 0;
+    uint64_t iowait  = 0;
+    uint64_t irq     = 0;
+    uint64_t softirq = 0;
+    uint64_t steal   = 0;
+
+    uint64_t total() const {
+        return user + nice + system + idle + iowait + irq + softirq + steal;
+    }
+};
+
+// Per-core breakdown; all percentages are of that core's time since the
+// previous sample.  user includes nice.
+struct CpuCoreInfo {
+    int   id;
+    float usage_percent;
+    float user_percent;
+    float system_percent;
+    float iowait_percent;
+    float irq_percent;
+    float softirq_percent;
+    float steal_percent;
 };
 
 struct CpuInfo {
     float usage_percent;
     float idle_percent;
+    float user_percent;
+    float system_percent;
+    float iowait_percent;
+    float irq_percent;
+    float softirq_percent;
+    float steal_percent;
+    std::vector<CpuCoreInfo> cores;
 };
 
+// /proc/meminfo figures, plus page fault and swap rates from the
+// /proc/vmstat counters over the interval since the previous sample (0 on
+// the first).  Rates are in pages per second.
 struct MemoryInfo {
     long total_kb;
     long used_kb;
     long free_kb;
     long available_kb;
     float usage_percent;
+    long buffers_kb    = 0;
+    long cached_kb     = 0;
+    long swap_total_kb = 0;
+    long swap_free_kb  = 0;
+    long swap_used_kb  = 0;
+    long dirty_kb      = 0;
+    long writeback_kb  = 0;
+
+    double   page_faults_per_sec  = 0.0;
+    double   major_faults_per_sec = 0.0;
+    double   swap_in_per_sec      = 0.0;
+    double   swap_out_per_sec     = 0.0;
+    uint64_t oom_kills            = 0;   // since boot
+};
+
+// Raw /proc/vmstat counters MemoryInfo's rates are computed from.
+struct VmStat {
+    uint64_t pgfault    = 0;
+    uint64_t pgmajfault = 0;
+    uint64_t pswpin     = 0;
+    uint64_t pswpout    = 0;
+    uint64_t oom_kill   = 0;
 };
 
+// Cumulative counters as read from rtnetlink or /proc/net/dev, plus rates
+// over the interval since the previous sample (0 on the first sample of a
+// device).  state is the operstate ("up", "down", ...; empty when read from
+// /proc/net/dev) and speed_mbps the link speed from sysfs (0 if unknown).
 struct NetworkInterface {
     std::string name;
-    long rx_bytes;
-    long tx_bytes;
-    long rx_packets;
-    long tx_packets;
+    uint64_t rx_bytes   = 0;
+    uint64_t tx_bytes   = 0;
+    uint64_t rx_packets = 0;
+    uint64_t tx_packets = 0;
+    uint64_t rx_errors  = 0;
+    uint64_t tx_errors  = 0;
+    uint64_t rx_dropped = 0;
+    uint64_t tx_dropped = 0;
+
+    std::string state;
+    int64_t     speed_mbps = 0;
+
+    double rx_bytes_per_sec   = 0.0;
+    double tx_bytes_per_sec   = 0.0;
+    double rx_packets_per_sec = 0.0;
+    double tx_packets_per_sec = 0.0;
 };
 
+// Cumulative counters as read from /proc/diskstats, plus iostat-style
+// figures over the interval since the previous sample.
 struct DiskIO {
     std::string name;
-    long reads_completed;
-    long writes_completed;
-    long read_sectors;
-    long write_sectors;
+    uint64_t reads_completed  = 0;
+    uint64_t writes_completed = 0;
+    uint64_t read_sectors     = 0;
+    uint64_t write_sectors    = 0;
+    uint64_t ms_reading       = 0;
+    uint64_t ms_writing       = 0;
+    uint64_t ios_in_progress  = 0;   // instantaneous, not a counter
+    uint64_t ms_io            = 0;
+    uint64_t weighted_ms_io   = 0;
+
+    double reads_per_sec       = 0.0;
+    double writes_per_sec      = 0.0;
+    double read_bytes_per_sec  = 0.0;
+    double write_bytes_per_sec = 0.0;
+    double read_latency_ms     = 0.0;   // average time per completed read
+    double write_latency_ms    = 0.0;
+    double queue_depth         = 0.0;   // average requests in flight
+    double util_percent        = 0.0;   // share of the interval the device was busy
 };
 
+// `name` is the zone's type (acpitz, x86_pkg_temp ...), which several
+// zones may share; `zone` is its sysfs directory and identifies it.
 struct ThermalZone {
+    std::string zone;   // thermal_zone0 ...
     std::string name;
     float temperature_celsius;
 };
 
+// Resource usage of one container from its cgroup v2 directory: raw
+// counters as read from cpu.stat, memory.current, memory.stat and io.stat
+// (io summed over devices), plus rates since the previous sample.
+// available is false when the cgroup was not found (cgroup v1 host, or a
+// container that is still starting).  cpu_percent is of one core, as
+// `docker stats` reports it.
+struct ContainerStats {
+    bool     available          = false;
+    uint64_t cpu_usage_usec     = 0;
+    uint64_t cpu_user_usec      = 0;
+    uint64_t cpu_system_usec    = 0;
+    uint64_t cpu_throttled_usec = 0;
+    uint64_t cpu_nr_throttled   = 0;
+    uint64_t memory_bytes       = 0;
+    uint64_t memory_anon_bytes  = 0;
+    uint64_t memory_file_bytes  = 0;
+    uint64_t io_read_bytes      = 0;
+    uint64_t io_write_bytes     = 0;
+    uint64_t io_read_ops        = 0;
+    uint64_t io_write_ops       = 0;
+
+    double cpu_percent            = 0.0;
+    double io_read_bytes_per_sec  = 0.0;
+    double io_write_bytes_per_sec = 0.0;
+};
+
 struct DockerContainer {
     std::string id;
+    std::string full_id;   // 64 hex digits; names the cgroup directory
     std::string image;
     std::string names;
     std::string status;
     std::string state;
     std::string health;   // healthy / unhealthy / starting / none
+    bool        stale = false;   // watcher is disconnected; last known state
+    ContainerStats resources;
+};
+
+// One process of the top-N table.  cpu_percent is of one core over the
+// interval since the process was last read; rates are 0 until it has been
+// read twice, and the I/O ones stay 0 without permission to read
+// /proc/[pid]/io (another user's process, unless running as root).
+struct ProcessInfo {
+    int         pid = 0;
+    std::string key;     // pid in decimal: identifies the entry across samples
+    std::string name;    // comm
+    std::string state;   // R, S, D, Z ...
+    uint64_t    threads       = 0;
+    double      cpu_percent   = 0.0;
+    uint64_t    rss_bytes     = 0;
+    uint64_t    virtual_bytes = 0;
+    double      io_read_bytes_per_sec  = 0.0;
+    double      io_write_bytes_per_sec = 0.0;
+};
+
+// Pressure stall information from /proc/pressure/{cpu,memory,io}: the
+// share of wall time in which some (or all: "full") non-idle tasks were
+// stalled on the resource, averaged over 10 s, 60 s and 300 s, and the
+// cumulative stall time.  available is false on kernels without PSI.
+struct PressureLine {
+    float    avg10      = 0.0f;
+    float    avg60      = 0.0f;
+    float    avg300     = 0.0f;
+    uint64_t total_usec = 0;
+};
+struct PressureResource {
+    PressureLine some;
+    PressureLine full;   // cpu has no full line before Linux 5.13: all 0
+};
+struct PressureInfo {
+    bool             available = false;
+    PressureResource cpu;
+    PressureResource memory;
+    PressureResource io;
+};
+
+// Latency histogram kept by the eBPF programs: log2 buckets in
+// microseconds, bucket i counting [2^i, 2^(i+1)) (bucket 0 also < 1 us, the
+// last one everything longer).  The buckets are cumulative; count and the
+// quantiles cover the time since the previous sample.
+constexpr int kLatencyBuckets = 27;
+struct LatencyDistribution {
+    uint64_t buckets[kLatencyBuckets] = {};
+    uint64_t total   = 0;     // cumulative count
+    double   sum_us  = 0.0;   // cumulative
+    uint64_t count   = 0;
+    double   mean_us = 0.0;
+    double   p50_us  = 0.0;
+    double   p99_us  = 0.0;
+};
+struct DeviceLatency {
+    std::string         name;   // as in /proc/diskstats
+    LatencyDistribution io;     // request issue to completion
+};
+struct CpuLatency {
+    int                 cpu = 0;
+    LatencyDistribution runq;   // wakeup to running
+};
+struct CgroupLatency {
+    std::string         name;   // container
+    LatencyDistribution runq;
+};
+// eBPF collector (built with SERVERHEALTH_EBPF); available is false
+// without it, on kernels without BTF or without CAP_BPF / CAP_PERFMON.
+struct KernelLatency {
+    bool                       available = false;
+    std::string                error;   // why not, when unavailable
+    LatencyDistribution        runq;    // all CPUs
+    std::vector<CpuLatency>    cpus;
+    std::vector<DeviceLatency> block;
+    std::vector<CgroupLatency> containers;   // needs the docker group
+    uint64_t                   tcp_retransmits = 0;   // since the programs were loaded
+    double                     tcp_retransmits_per_sec = 0.0;
 };
 
 struct SpeedTestResult {
     float   download_mbps = 0.0f;
     float   upload_mbps   = 0.0f;
+    float   latency_ms    = 0.0f;   // median TCP connect time to the test server
+    float   jitter_ms     = 0.0f;   // mean difference between consecutive connects
+    uint64_t bytes_used   = 0;      // payload moved by the run
     std::string timestamp;
     bool    available     = false;
+    bool    stale         = false;   // last run failed or timed out; previous result
+};
+
+// Top-level groups of the health document.  Collection and serialization
+// take a mask of these, and groups outside the mask are skipped entirely.
+enum MetricGroup : uint32_t {
+    kGroupCpu         = 1u << 0,
+    kGroupMemory      = 1u << 1,
+    kGroupDisks       = 1u << 2,
+    kGroupNetwork     = 1u << 3,
+    kGroupDiskIO      = 1u << 4,
+    kGroupTemperature = 1u << 5,
+    kGroupDocker      = 1u << 6,
+    kGroupSpeed       = 1u << 7,
+    kGroupPressure    = 1u << 8,
+    kGroupProcesses   = 1u << 9,
+    kGroupLatency     = 1u << 10,
+};
+constexpr int      kMetricGroupCount = 11;
+constexpr uint32_t kAllGroups        = (1u << kMetricGroupCount) - 1;
+// Groups that are one object rather than a list of entries
+constexpr uint32_t kObjectGroups     = kGroupCpu | kGroupMemory | kGroupSpeed | kGroupPressure | kGroupLatency;
+
+// JSON key of group `index` (bit 1 << index): "cpu", "memory", ... "latency"
+const char* metricGroupName(int index);
+// Index of the group called `name`, or -1.
+int         metricGroupIndex(std::string_view name);
+// Mask for a comma-separated list of group names; false on an unknown name.
+bool        parseMetricGroups(std::string_view list, uint32_t& mask);
+
+// Everything one collection produced.
+struct HealthData {
+    std::time_t                   timestamp = 0;
+    uint32_t                      groups    = 0;   // which of the fields below are present
+    uint32_t                      refreshed = 0;   // ... and which of those were collected just now
+    CpuInfo                       cpu{};
+    MemoryInfo                    memory{};
+    std::vector<DiskInfo>         disks;
+    std::vector<NetworkInterface> network;
+    std::vector<DiskIO>           disk_io;
+    std::vector<ThermalZone>      temperature;
+    std::vector<DockerContainer>  docker;
+    SpeedTestResult               speed;
+    PressureInfo                  pressure;
+    std::vector<ProcessInfo>      processes;
+    KernelLatency                 latency;
+};
+
+// Where one part of a CBOR snapshot lies: an entry of a list group (a
+// disk, interface, container ... identified by `key`), or a whole scalar
+// group (cpu, memory, internet_speed, pressure, latency; empty key).
+struct CborEntry {
+    int         group;    // index, as for metricGroupName()
+    std::string key;
+    size_t      offset;
+    size_t      length;
 };
 
+class DockerWatcher;
+class EbpfCollector;
+class NetlinkLinkDump;
+class ProcessScanner;
+class SpeedTester;
+class WorkerPool;
+
 class HealthCollector {
 public:
-    HealthCollector();
-    std::string getHealthJson();
+    // Only the collectors in `groups` are ever run; the Docker watcher and
+    // the speed test are not started at all without their groups.
+    explicit HealthCollector(uint32_t groups = kAllGroups);
+    ~HealthCollector();
 
-    // Run a speed test and cache the result (called from a background thread)
-    static void updateSpeedTestCache();
+    uint32_t           groups() const { return groups_; }
+    // Runs the collectors in `groups` (intersected with the constructor's).
+    HealthData         collect(uint32_t groups = kAllGroups);
+    // Render the collected groups of `data` into `out` (cleared first,
+    // capacity kept).
+    static void        writeJson(const HealthData& data, std::string& out, bool pretty);
+    // Render just the value of group `index`, compact, into `out`.
+    static void        writeGroupJson(const HealthData& data, int index, std::string& out);
+    // CBOR (RFC 8949) with the same keys and nesting as writeJson, plus
+    // "sequence" and "instance" (which run of the agent produced it).  When `entries` is given the byte range of every list
+    // entry and scalar group is recorded in it, so deltas can be cut from
+    // the document without encoding anything again.
+    static void        writeCbor(const HealthData& data, uint64_t sequence, uint64_t instance, std::string& out,
+                                 std::vector<CborEntry>* entries = nullptr);
+    static std::string toJson(const HealthData& data, bool pretty = true);
+    // "2024-01-31T12:00:00Z"
+    static std::string isoTimestamp(std::time_t t);
+    std::string        getHealthJson();
 
 private:
+    uint32_t    groups_;
     std::string proc_path_;
     std::string sys_path_;
     std::string host_root_path_;
 
+    // Files read on every sample, kept open between samples
+    MetricSource stat_src_;
+    MetricSource meminfo_src_;
+    MetricSource netdev_src_;
+    MetricSource diskstats_src_;
+    MetricSource mounts_src_;
+    MetricSource vmstat_src_;
+    MetricSource pressure_srcs_[3];   // cpu, memory, io
+
+    // Mount points of the real block-device mounts, rebuilt only when the
+    // kernel flags a change of the mount table on mounts_src_'s fd
+    std::vector<std::string> mount_points_;
+    bool                     mounts_known_ = false;
+
+    struct ThermalSource {
+        std::string  zone;   // directory name, thermal_zoneN
+        std::string  name;   // contents of the zone's "type" file
+        MetricSource temp;
+    };
+    std::vector<ThermalSource> thermal_srcs_;
+    bool                       thermal_scanned_ = false;
+
+    // /proc/stat state kept between getCpuInfo() calls; reused so
+    // steady-state sampling does not allocate
+    CpuTimes              cpu_total_;
+    CpuTimes              prev_cpu_total_;
+    std::vector<CpuTimes> cpu_cores_;
+    std::vector<CpuTimes> prev_cpu_cores_;   // indexed by cpu id
+
+    // Previous counter readings for rate computation, matched by device
+    // name so hot-plugged devices neither inherit nor lose another's state
+    std::vector<NetworkInterface>         net_;        // current reading, reused
+    std::vector<NetworkInterface>         prev_net_;
+    std::vector<DiskIO>                   prev_disk_io_;
+    std::chrono::steady_clock::time_point prev_net_time_;
+    std::chrono::steady_clock::time_point prev_disk_io_time_;
+    VmStat                                prev_vmstat_;
+    std::chrono::steady_clock::time_point prev_vmstat_time_;
+    bool                                  have_vmstat_ = false;
+
+    std::unique_ptr<DockerWatcher> docker_;
+
+    // cgroup v2 files of each running container, kept open; found under
+    // cgroup_root_ on first sight of the container and forgotten when it
+    // is gone
+    struct CgroupSource {
+        MetricSource                          cpu_stat;
+        MetricSource                          memory_current;
+        MetricSource                          memory_stat;
+        MetricSource                          io_stat;
+        ContainerStats                        prev;
+        std::chrono::steady_clock::time_point prev_time;
+        uint64_t                              seen = 0;   // last cgroup_pass_ that found it
+        uint64_t                              id   = 0;   // inode of the directory: the kernel's cgroup id
+        std::string                           name;       // container name, for the latency group
+    };
+    std::string                                   cgroup_root_;   // empty: not a cgroup v2 host
+    std::unordered_map<std::string, CgroupSource> cgroups_;       // by full container id
+    uint64_t                                      cgroup_pass_ = 0;
+
+    std::unique_ptr<ProcessScanner> processes_;
+    std::unique_ptr<SpeedTester>    speed_;
+    std::unique_ptr<EbpfCollector>  ebpf_;
+    std::unordered_map<uint64_t, std::string> cgroup_names_;   // cgroup id -> container, rebuilt per read
+
+    // NET_BACKEND: rtnetlink dump (null when procfs is forced)
+    std::unique_ptr<NetlinkLinkDump> netlink_;
+    bool                             netlink_fallback_ = true;   // use /proc/net/dev when it fails
+
+    // statvfs() runs on a small pool so one hung mount cannot stall the
+    // sample; each mount keeps its last good reading for when it does
+    struct MountProbe;
+    struct ProbeSync;
+    std::unique_ptr<WorkerPool>                                  slow_pool_;
+    std::shared_ptr<ProbeSync>                                   probe_sync_;
+    std::unordered_map<std::string, std::shared_ptr<MountProbe>> probes_;   // by mount point
+    std::chrono::milliseconds                                    source_deadline_{1000};
+
+    bool                          refreshMountPoints();   // true if mount_points_ was rebuilt
     std::vector<DiskInfo>         getDiskInfo();
     CpuInfo                       getCpuInfo();
     MemoryInfo                    getMemoryInfo();
+    PressureInfo                  getPressureInfo();
+    std::vector<ProcessInfo>      getProcesses();
+    KernelLatency                 getKernelLatency();
     std::vector<NetworkInterface> getNetworkInterfaces();
     std::vector<DiskIO>           getDiskIOStats();
     std::vector<ThermalZone>      getThermalZones();
     std::vector<DockerContainer>  getDockerContainers();
+    void                          readContainerStats(std::vector<DockerContainer>& containers);
 
-    static SpeedTestResult  s_speedResult;
-    static std::mutex       s_speedMutex;
+    void scanThermalZones();
 };
@@ -0,0 +1,328 @@
+#include "history.h"
+
+#include "json_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static const float kNoData = std::numeric_limits<float>::quiet_NaN();
+
+// Rollup tiers: resolution and how long each is kept.
+static const int64_t kRollupResMs[]    = {60 * 1000, 5 * 60 * 1000, 60 * 60 * 1000};
+static const int64_t kRollupRetainMs[] = {24LL * 3600 * 1000, 7LL * 24 * 3600 * 1000, 90LL * 24 * 3600 * 1000};
+
+// Eviction: how often series are swept, and how long one must have gone
+// unwritten before the series cap may drop it (groups with long periods
+// are written only every few minutes).
+static constexpr int64_t kSweepMs      = 60 * 1000;
+static constexpr int64_t kEvictGraceMs = 10 * 60 * 1000;
+
+MetricHistory::MetricHistory(std::chrono::milliseconds sampleInterval, std::chrono::hours rawRetention,
+                             const std::string& dataDir, std::chrono::hours diskRetention, size_t maxSeries)
+    : max_series_(maxSeries) {
+    if (!dataDir.empty()) store_ = std::make_unique<SeriesStore>(dataDir, diskRetention);
+    started_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::system_clock::now().time_since_epoch()).count();
+    int64_t rawRes = std::max<int64_t>(sampleInterval.count(), 1);
+    int64_t rawRetain = std::chrono::duration_cast<std::chrono::milliseconds>(rawRetention).count();
+    tier_res_ms_.push_back(rawRes);
+    tier_capacity_.push_back(static_cast<size_t>(std::max<int64_t>(rawRetain / rawRes, 1)));
+    for (size_t i = 0; i < 3; ++i) {
+        tier_res_ms_.push_back(kRollupResMs[i]);
+        tier_capacity_.push_back(static_cast<size_t>(kRollupRetainMs[i] / kRollupResMs[i]));
+    }
+    for (size_t i = 0; i < tier_res_ms_.size(); ++i)
+        kept_ms_ = std::max(kept_ms_, tier_res_ms_[i] * static_cast<int64_t>(tier_capacity_[i]));
+}
+
+MetricHistory::~MetricHistory() = default;
+
+// ---------------------------------------------------------------------------
+// ring  –  bucket b lives in slot b % capacity
+// ---------------------------------------------------------------------------
+
+void MetricHistory::Ring::put(int64_t bucket, float v) {
+    const int64_t cap = static_cast<int64_t>(values.size());
+    if (newest >= 0 && bucket <= newest - cap) return;   // older than the ring
+    if (bucket > newest) {
+        // clear the slots of any buckets that were skipped
+        int64_t first = std::max(newest + 1, bucket - cap + 1);
+        for (int64_t b = first; b < bucket; ++b) values[static_cast<size_t>(b % cap)] = kNoData;
+        newest = bucket;
+    }
+    values[static_cast<size_t>(bucket % cap)] = v;
+}
+
+// Raw tiers store the sample as is; rollup tiers keep a running average of
+// the open bucket, so the slot is always ready to be read.
+void MetricHistory::Ring::add(int64_t tMs, float v) {
+    int64_t bucket = tMs / res_ms;
+    if (bucket != acc_bucket) {
+        acc_bucket = bucket;
+        acc_sum    = 0.0;
+        acc_count  = 0;
+    }
+    acc_sum += v;
+    ++acc_count;
+    put(bucket, static_cast<float>(acc_sum / acc_count));
+}
+
+float MetricHistory::Ring::at(int64_t bucket) const {
+    const int64_t cap = static_cast<int64_t>(values.size());
+    if (newest < 0 || bucket > newest || bucket <= newest - cap || bucket < 0) return kNoData;
+    return values[static_cast<size_t>(bucket % cap)];
+}
+
+int64_t MetricHistory::Ring::oldest() const {
+    return newest - static_cast<int64_t>(values.size()) + 1;
+}
+
+// ---------------------------------------------------------------------------
+// recording
+// ---------------------------------------------------------------------------
+
+MetricHistory::Series& MetricHistory::series(const std::string& name) {
+    auto it = series_.find(name);
+    if (it != series_.end()) return it->second;
+
+    Series s;
+    s.tiers.resize(tier_res_ms_.size());
+    for (size_t i = 0; i < s.tiers.size(); ++i) {
+        s.tiers[i].res_ms = tier_res_ms_[i];
+        s.tiers[i].values.assign(tier_capacity_[i], kNoData);
+    }
+    return series_.emplace(name, std::move(s)).first->second;
+}
+
+void MetricHistory::add(const std::string& name, int64_t tMs, float v) {
+    if (!std::isfinite(v)) return;
+    Series& s = series(name);
+    for (auto& ring : s.tiers) ring.add(tMs, v);
+    s.last_ms = tMs;
+    if (store_) store_->append(name, tMs, v);
+}
+
+void MetricHistory::record(const HealthData& d) {
+    // HealthData carries whole seconds; the raw tier may be finer than that
+    const int64_t t = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::system_clock::now().time_since_epoch()).count();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // only groups collected for this sample: the others would repeat an old
+    // value (or a zero) instead of leaving a gap
+    if (d.refreshed & kGroupCpu) {
+        add("cpu.usage_percent",  t, d.cpu.usage_percent);
+        add("cpu.iowait_percent", t, d.cpu.iowait_percent);
+        add("cpu.steal_percent",  t, d.cpu.steal_percent);
+        for (const auto& c : d.cpu.cores)
+            add("cpu.cores[" + std::to_string(c.id) + "].usage_percent", t, c.usage_percent);
+    }
+    if (d.refreshed & kGroupMemory) {
+        add("memory.usage_percent", t, d.memory.usage_percent);
+        add("memory.available_kb",  t, static_cast<float>(d.memory.available_kb));
+        add("memory.swap_used_kb",  t, static_cast<float>(d.memory.swap_used_kb));
+        add("memory.major_faults_per_sec", t, static_cast<float>(d.memory.major_faults_per_sec));
+        add("memory.swap_out_per_sec",     t, static_cast<float>(d.memory.swap_out_per_sec));
+    }
+
+    if (d.refreshed & kGroupDisks)
+        for (const auto& disk : d.disks) {
+            if (disk.stale) continue;
+            add("disks[" + disk.path + "].usage_percent", t, disk.usage_percent);
+            if (disk.inodes_total > 0)
+                add("disks[" + disk.path + "].inodes_usage_percent", t, disk.inodes_usage_percent);
+        }
+
+    // rates rather than the cumulative counters, which do not fit a float
+    if (d.refreshed & kGroupNetwork)
+        for (const auto& n : d.network) {
+            const std::string p = "network[" + n.name + "].";
+            add(p + "rx_bytes_per_sec", t, static_cast<float>(n.rx_bytes_per_sec));
+            add(p + "tx_bytes_per_sec", t, static_cast<float>(n.tx_bytes_per_sec));
+        }
+    if (d.refreshed & kGroupDiskIO)
+        for (const auto& io : d.disk_io) {
+            const std::string p = "disk_io[" + io.name + "].";
+            add(p + "reads_per_sec",       t, static_cast<float>(io.reads_per_sec));
+            add(p + "writes_per_sec",      t, static_cast<float>(io.writes_per_sec));
+            add(p + "read_bytes_per_sec",  t, static_cast<float>(io.read_bytes_per_sec));
+            add(p + "write_bytes_per_sec", t, static_cast<float>(io.write_bytes_per_sec));
+            add(p + "queue_depth",         t, static_cast<float>(io.queue_depth));
+            add(p + "util_percent",        t, static_cast<float>(io.util_percent));
+        }
+    if (d.refreshed & kGroupTemperature)
+        for (const auto& tz : d.temperature)
+            add("temperature[" + tz.zone + "].temperature_celsius", t, tz.temperature_celsius);
+
+    if (d.refreshed & kGroupDocker) {
+        int unhealthy = 0;
+        for (const auto& c : d.docker) if (c.health == "unhealthy") ++unhealthy;
+        add("docker.containers", t, static_cast<float>(d.docker.size()));
+        add("docker.unhealthy",  t, static_cast<float>(unhealthy));
+    }
+
+    if ((d.refreshed & kGroupSpeed) && d.speed.available && !d.speed.stale) {
+        add("internet_speed.download_mbps", t, d.speed.download_mbps);
+        add("internet_speed.upload_mbps",   t, d.speed.upload_mbps);
+        add("internet_speed.latency_ms",    t, d.speed.latency_ms);
+        add("internet_speed.jitter_ms",     t, d.speed.jitter_ms);
+    }
+
+    if ((d.refreshed & kGroupPressure) && d.pressure.available) {
+        add("pressure.cpu.some.avg10",    t, d.pressure.cpu.some.avg10);
+        add("pressure.memory.some.avg10", t, d.pressure.memory.some.avg10);
+        add("pressure.memory.full.avg10", t, d.pressure.memory.full.avg10);
+        add("pressure.io.some.avg10",     t, d.pressure.io.some.avg10);
+        add("pressure.io.full.avg10",     t, d.pressure.io.full.avg10);
+    }
+
+    if ((d.refreshed & kGroupLatency) && d.latency.available) {
+        add("latency.runq.p99_us",             t, static_cast<float>(d.latency.runq.p99_us));
+        add("latency.tcp_retransmits_per_sec", t, static_cast<float>(d.latency.tcp_retransmits_per_sec));
+        for (const auto& dev : d.latency.block)
+            add("latency.block[" + dev.name + "].p99_us", t, static_cast<float>(dev.io.p99_us));
+    }
+
+    if (t - last_sweep_ms_ >= kSweepMs) evict(t);
+}
+
+// Drop series whose rings no longer hold anything, then, above the cap,
+// the least recently written of those idle for kEvictGraceMs.
+void MetricHistory::evict(int64_t nowMs) {
+    last_sweep_ms_ = nowMs;
+    std::vector<std::unordered_map<std::string, Series>::iterator> idle;
+    for (auto it = series_.begin(); it != series_.end();) {
+        if (it->second.last_ms <= nowMs - kept_ms_) {
+            it = series_.erase(it);
+            continue;
+        }
+        if (it->second.last_ms <= nowMs - kEvictGraceMs) idle.push_back(it);
+        ++it;
+    }
+    if (series_.size() <= max_series_) return;
+
+    const size_t n = std::min(series_.size() - max_series_, idle.size());
+    std::nth_element(idle.begin(), idle.begin() + static_cast<std::ptrdiff_t>(n), idle.end(),
+                     [](const auto& a, const auto& b) { return a->second.last_ms < b->second.last_ms; });
+    for (size_t i = 0; i < n; ++i) series_.erase(idle[i]);   // the others stay valid
+}
+
+// ---------------------------------------------------------------------------
+// queries
+// ---------------------------------------------------------------------------
+
+// {"metric", "step", "start", "values"}, compact, since the value arrays run
+// to thousands of points; value(i) is NaN for a gap.
+template <typename Fn>
+static void writeSeriesJson(std::string& out, const std::string& metric, int64_t stepMs, int64_t startMs,
+                            size_t count, Fn value) {
+    JsonWriter w(out, false);
+    w.beginObject();
+    w.field("metric", metric);
+    w.field("step",   stepMs / 1000.0);
+    w.field("start",  startMs / 1000.0);
+    w.key("values");
+    w.beginArray();
+    for (size_t i = 0; i < count; ++i) w.value(value(i));   // NaN renders as null
+    w.endArray();
+    w.endObject();
+}
+
+bool MetricHistory::queryJson(const std::string& metric, int64_t from, int64_t to, double stepSeconds,
+                              std::string& out) const {
+    const int64_t fromMs = from * 1000;
+    const int64_t toMs   = to * 1000;
+    const int64_t stepMs = static_cast<int64_t>(stepSeconds * 1000.0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = series_.find(metric);
+    if (it == series_.end()) {
+        lock.unlock();
+        return store_ && queryStoreJson(metric, fromMs, toMs, stepMs, out);
+    }
+    const auto& tiers = it->second.tiers;
+
+    // finest tier that is coarse enough for the step and still reaches back
+    // to `from`; fall back to the coarsest one
+    size_t tier = tiers.size() - 1;
+    for (size_t i = 0; i < tiers.size(); ++i) {
+        const Ring& r = tiers[i];
+        if (r.res_ms < stepMs) continue;
+        if (r.newest >= 0 && r.oldest() * r.res_ms > fromMs && i + 1 < tiers.size()) continue;
+        tier = i;
+        break;
+    }
+    const Ring& r = tiers[tier];
+
+    // older than any ring reaches: the store has it at full resolution
+    const int64_t covered = std::max(r.oldest() * r.res_ms, started_ms_);
+    if (store_ && (r.newest < 0 || covered > fromMs)) {
+        int64_t stored = store_->oldest(metric);
+        if (stored >= 0 && (r.newest < 0 || stored < covered)) {
+            lock.unlock();
+            return queryStoreJson(metric, fromMs, toMs, stepMs, out);
+        }
+    }
+
+    int64_t first = std::max<int64_t>(fromMs / r.res_ms, r.oldest());
+    int64_t last  = std::min<int64_t>(toMs / r.res_ms, r.newest);
+
+    writeSeriesJson(out, metric, r.res_ms, first * r.res_ms, static_cast<size_t>(std::max<int64_t>(last - first + 1, 0)),
+                    [&](size_t i) { return r.at(first + static_cast<int64_t>(i)); });
+    return true;
+}
+
+// Points decoded from the mapped segments and averaged per step (never finer
+// than the sampling interval, and at most kMaxStoreBuckets of them).
+static constexpr int64_t kMaxStoreBuckets = 100000;
+
+bool MetricHistory::queryStoreJson(const std::string& metric, int64_t fromMs, int64_t toMs, int64_t stepMs,
+                                   std::string& out) const {
+    int64_t step = std::max(stepMs, tier_res_ms_[0]);
+    if (toMs >= fromMs) step = std::max(step, (toMs - fromMs) / kMaxStoreBuckets + 1);
+    const int64_t first = fromMs / step;
+    const int64_t last  = std::max(toMs / step, first - 1);
+
+    std::vector<double>   sums(static_cast<size_t>(last - first + 1), 0.0);
+    std::vector<uint32_t> counts(sums.size(), 0);
+    bool known = store_->scan(metric, first * step, (last + 1) * step - 1, [&](int64_t t, float v) {
+        size_t b = static_cast<size_t>(t / step - first);
+        sums[b] += v;
+        ++counts[b];
+    });
+    if (!known) return false;
+
+    writeSeriesJson(out, metric, step, first * step, sums.size(), [&](size_t b) {
+        return counts[b] ? static_cast<float>(sums[b] / counts[b]) : kNoData;
+    });
+    return true;
+}
+
+std::string MetricHistory::catalogJson() const {
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        names.reserve(series_.size());
+        for (const auto& kv : series_) names.push_back(kv.first);
+    }
+    // series only the store still has (not seen since the restart)
+    if (store_)
+        for (auto& name : store_->names()) names.push_back(std::move(name));
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    std::string out;
+    JsonWriter  w(out, true);
+    w.beginObject();
+    w.key("steps");
+    w.beginArray();
+    for (int64_t res : tier_res_ms_) w.value(res / 1000.0);
+    w.endArray();
+    w.key("metrics");
+    w.beginArray();
+    for (const auto& name : names) w.value(name);
+    w.endArray();
+    w.endObject();
+    return out;
+}
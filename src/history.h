@@ -0,0 +1,99 @@
+#pragma once
+
+#include "health_collector.h"
+#include "series_store.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Fixed-capacity in-memory time series of the sampled metrics.
+//
+// Every series keeps one ring per resolution tier: the raw sampling
+// interval plus 1 min / 5 min / 1 h rollups.  A ring is a plain float
+// array indexed by time bucket, so timestamps are implicit (no per-point
+// time column) and gaps are stored as NaN.  Rollups are averaged as the
+// samples arrive, which lets a query copy a slice of one ring without
+// recomputing anything.
+//
+// With a data directory every raw sample is also appended to a
+// SeriesStore.  Ranges the rings no longer (or, after a restart, do not
+// yet) cover are then answered from the store, averaged to the step.
+//
+// Metric names follow the JSON layout: "cpu.usage_percent",
+// "disks[/home].usage_percent", "network[eth0].rx_bytes", ...  Names come
+// and go with interfaces and containers, so a series is dropped once its
+// rings hold nothing any more, and beyond `maxSeries` the least recently
+// written ones that have been idle for a while go first.  The store keeps
+// answering for dropped series.  Each series holds every tier's ring
+// (about 36 KB with an hour of raw samples at 1 s), so `maxSeries` bounds
+// memory to about 36 MB at the default, plus series not yet idle long
+// enough to go.
+class MetricHistory {
+public:
+    // `dataDir` empty: memory only.
+    MetricHistory(std::chrono::milliseconds sampleInterval, std::chrono::hours rawRetention,
+                  const std::string& dataDir = {}, std::chrono::hours diskRetention = std::chrono::hours(24 * 30),
+                  size_t maxSeries = 1024);
+    ~MetricHistory();
+
+    // False if a data directory was given but cannot be used.
+    bool storeUsable() const { return !store_ || store_->ok(); }
+
+    // Append one sample of every tracked metric (sampler thread).
+    void record(const HealthData& data);
+
+    // Render {"metric", "step", "start", "values": [...]} for `metric` from
+    // unix time `from` to `to`, using the finest tier whose resolution is at
+    // least `stepSeconds` and that still covers `from`.  Returns false if
+    // the metric is unknown.
+    bool queryJson(const std::string& metric, int64_t from, int64_t to, double stepSeconds,
+                   std::string& out) const;
+
+    // {"metrics": [...], "steps": [...]}
+    std::string catalogJson() const;
+
+private:
+    bool queryStoreJson(const std::string& metric, int64_t fromMs, int64_t toMs, int64_t stepMs,
+                        std::string& out) const;
+
+    struct Ring {
+        int64_t            res_ms = 0;
+        std::vector<float> values;          // capacity slots, NaN = no data
+        int64_t            newest = -1;     // bucket number held by the newest slot
+        // open bucket of a rollup tier
+        int64_t            acc_bucket = -1;
+        double             acc_sum    = 0.0;
+        uint32_t           acc_count  = 0;
+
+        void   put(int64_t bucket, float v);
+        void   add(int64_t tMs, float v);
+        float  at(int64_t bucket) const;
+        int64_t oldest() const;
+    };
+
+    struct Series {
+        std::vector<Ring> tiers;
+        int64_t           last_ms = 0;   // newest sample
+    };
+
+    Series& series(const std::string& name);
+    void    add(const std::string& name, int64_t tMs, float v);
+    void    evict(int64_t nowMs);
+
+    std::vector<int64_t> tier_res_ms_;
+    std::vector<size_t>  tier_capacity_;
+    int64_t              kept_ms_ = 0;         // span of the longest tier
+    size_t               max_series_;
+    int64_t              last_sweep_ms_ = 0;
+
+    mutable std::mutex                      mutex_;
+    std::unordered_map<std::string, Series> series_;
+
+    std::unique_ptr<SeriesStore> store_;        // null without a data directory
+    int64_t                      started_ms_;   // the rings hold nothing older
+};
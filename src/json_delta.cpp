@@ -0,0 +1,115 @@
+#include "json_delta.h"
+
+#include "json_reader.h"
+
+#include <algorithm>
+#include <charconv>
+
+// ---------------------------------------------------------------------------
+// flatten
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct Flattener {
+    JsonReader              reader;
+    std::vector<FlatField>& out;
+    size_t                  count = 0;
+    std::string             path;
+
+    FlatField& emit() {
+        if (count == out.size()) out.emplace_back();
+        FlatField& f = out[count++];
+        f.path = path;
+        return f;
+    }
+
+    bool value(JsonReader::Token t) {
+        using Token = JsonReader::Token;
+        switch (t) {
+        case Token::BeginObject: {
+            bool empty = true;
+            for (t = reader.next(); t != Token::EndObject; t = reader.next()) {
+                if (t != Token::Key) return false;
+                size_t len = path.size();
+                if (len) path += '.';
+                path += reader.str();
+                if (!value(reader.next())) return false;
+                path.resize(len);
+                empty = false;
+            }
+            if (empty) emit().value = "{}";
+            return true;
+        }
+        case Token::BeginArray: {
+            size_t index = 0;
+            for (t = reader.next(); t != Token::EndArray; t = reader.next()) {
+                size_t len = path.size();
+                char buf[24];
+                auto r = std::to_chars(buf, buf + sizeof(buf), index++);
+                path += '[';
+                path.append(buf, static_cast<size_t>(r.ptr - buf));
+                path += ']';
+                if (!value(t)) return false;
+                path.resize(len);
+            }
+            if (index == 0) emit().value = "[]";
+            return true;
+        }
+        case Token::String: {
+            FlatField& f = emit();
+            f.value.clear();
+            appendJsonString(f.value, reader.str());
+            return true;
+        }
+        case Token::Number: emit().value = reader.raw(); return true;
+        case Token::True:   emit().value = "true";       return true;
+        case Token::False:  emit().value = "false";      return true;
+        case Token::Null:   emit().value = "null";       return true;
+        default:            return false;
+        }
+    }
+};
+
+} // namespace
+
+bool flattenJson(std::string_view json, std::vector<FlatField>& out) {
+    Flattener f{JsonReader(json), out, 0, {}};
+    bool ok = f.value(f.reader.next());
+    out.resize(f.count);
+    std::sort(out.begin(), out.end(),
+              [](const FlatField& a, const FlatField& b) { return a.path < b.path; });
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// delta  –  merge walk over the two sorted lists
+// ---------------------------------------------------------------------------
+
+void writeJsonDelta(JsonWriter& w, const std::vector<FlatField>& prev, const std::vector<FlatField>& cur) {
+    w.key("set");
+    w.beginObject();
+    size_t i = 0, j = 0;
+    while (j < cur.size()) {
+        if (i < prev.size() && prev[i].path < cur[j].path) { ++i; continue; }
+        bool same = i < prev.size() && prev[i].path == cur[j].path && prev[i].value == cur[j].value;
+        if (i < prev.size() && prev[i].path == cur[j].path) ++i;
+        if (!same) {
+            w.key(cur[j].path);
+            w.rawValue(cur[j].value);
+        }
+        ++j;
+    }
+    w.endObject();
+
+    w.key("remove");
+    w.beginArray();
+    i = 0, j = 0;
+    while (i < prev.size()) {
+        if (j < cur.size() && cur[j].path < prev[i].path) { ++j; continue; }
+        if (j < cur.size() && cur[j].path == prev[i].path) { ++i; ++j; continue; }
+        w.value(prev[i].path);
+        ++i;
+    }
+    w.endArray();
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "json_writer.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One leaf of a flattened JSON document: path in "a.b[2].c" form and the
+// value as JSON text.  Empty objects and arrays are leaves themselves
+// ("docker" -> "[]"), so unflattening restores them.
+struct FlatField {
+    std::string path;
+    std::string value;
+};
+
+// Flatten `json` into `out`, sorted by path.  Existing entries are
+// overwritten in place so a vector kept between calls stops allocating.
+// Returns false if the document is malformed.
+bool flattenJson(std::string_view json, std::vector<FlatField>& out);
+
+// Write {"set": {path: value, ...}, "remove": [path, ...]} turning `prev`
+// into `cur` into the object the writer is currently inside.  Both inputs
+// must come from flattenJson.
+void writeJsonDelta(JsonWriter& w, const std::vector<FlatField>& prev, const std::vector<FlatField>& cur);
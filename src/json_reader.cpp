@@ -0,0 +1,150 @@
+#include "json_reader.h"
+
+#include <charconv>
+
+// ---------------------------------------------------------------------------
+// helpers
+// ---------------------------------------------------------------------------
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void appendUtf8(std::string& out, unsigned cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// tokenizer
+// ---------------------------------------------------------------------------
+
+// Separators carry no information for a pull reader, so ',' is treated as
+// whitespace and ':' is consumed when a string turns out to be a key.
+void JsonReader::skipWs() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r' || *p_ == ','))
+        ++p_;
+}
+
+bool JsonReader::parseString() {
+    ++p_;   // opening quote
+    str_.clear();
+    while (p_ < end_) {
+        char c = *p_++;
+        if (c == '"') return true;
+        if (c != '\\') { str_.push_back(c); continue; }
+        if (p_ >= end_) break;
+        char e = *p_++;
+        switch (e) {
+            case '"':  str_.push_back('"');  break;
+            case '\\': str_.push_back('\\'); break;
+            case '/':  str_.push_back('/');  break;
+            case 'b':  str_.push_back('\b'); break;
+            case 'f':  str_.push_back('\f'); break;
+            case 'n':  str_.push_back('\n'); break;
+            case 'r':  str_.push_back('\r'); break;
+            case 't':  str_.push_back('\t'); break;
+            case 'u': {
+                auto hex4 = [this](unsigned& v) {
+                    if (end_ - p_ < 4) return false;
+                    v = 0;
+                    for (int i = 0; i < 4; ++i) {
+                        int h = hexValue(p_[i]);
+                        if (h < 0) return false;
+                        v = v * 16 + static_cast<unsigned>(h);
+                    }
+                    p_ += 4;
+                    return true;
+                };
+                unsigned cp;
+                if (!hex4(cp)) return false;
+                if (cp >= 0xD800 && cp < 0xDC00 && end_ - p_ >= 6 && p_[0] == '\\' && p_[1] == 'u') {
+                    p_ += 2;
+                    unsigned lo;
+                    if (!hex4(lo)) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                appendUtf8(str_, cp);
+                break;
+            }
+            default: return false;
+        }
+    }
+    return false;
+}
+
+JsonReader::Token JsonReader::next() {
+    if (failed_) return Token::Error;
+    skipWs();
+    if (p_ >= end_) return Token::End;
+
+    switch (*p_) {
+        case '{': ++p_; return Token::BeginObject;
+        case '}': ++p_; return Token::EndObject;
+        case '[': ++p_; return Token::BeginArray;
+        case ']': ++p_; return Token::EndArray;
+        case '"': {
+            if (!parseString()) { failed_ = true; return Token::Error; }
+            while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) ++p_;
+            if (p_ < end_ && *p_ == ':') { ++p_; return Token::Key; }
+            return Token::String;
+        }
+        case 't':
+            if (end_ - p_ >= 4 && std::string_view(p_, 4) == "true")  { p_ += 4; return Token::True; }
+            break;
+        case 'f':
+            if (end_ - p_ >= 5 && std::string_view(p_, 5) == "false") { p_ += 5; return Token::False; }
+            break;
+        case 'n':
+            if (end_ - p_ >= 4 && std::string_view(p_, 4) == "null")  { p_ += 4; return Token::Null; }
+            break;
+        default: {
+            const char* start = p_;
+            while (p_ < end_ && (*p_ == '-' || *p_ == '+' || *p_ == '.' || *p_ == 'e' || *p_ == 'E' ||
+                                 (*p_ >= '0' && *p_ <= '9')))
+                ++p_;
+            if (p_ == start) break;
+            raw_ = std::string_view(start, static_cast<size_t>(p_ - start));
+            return Token::Number;
+        }
+    }
+    failed_ = true;
+    return Token::Error;
+}
+
+double JsonReader::number() const {
+    double v = 0.0;
+    std::from_chars(raw_.data(), raw_.data() + raw_.size(), v);
+    return v;
+}
+
+void JsonReader::skipValue(bool inside) {
+    int depth = inside ? 1 : 0;
+    do {
+        switch (next()) {
+            case Token::BeginObject:
+            case Token::BeginArray:  ++depth; break;
+            case Token::EndObject:
+            case Token::EndArray:    --depth; break;
+            case Token::End:
+            case Token::Error:       return;
+            default:                 break;
+        }
+    } while (depth > 0);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Pull-style JSON tokenizer over a borrowed buffer.  No document tree is
+// built: callers walk the tokens and pick out the fields they need, calling
+// skipValue() for everything else.  Decoded strings are written into one
+// reused buffer, so scanning a large response does not allocate per field.
+class JsonReader {
+public:
+    enum class Token {
+        BeginObject, EndObject, BeginArray, EndArray,
+        Key, String, Number, True, False, Null,
+        End, Error
+    };
+
+    explicit JsonReader(std::string_view text) : p_(text.data()), end_(text.data() + text.size()) {}
+
+    Token next();
+
+    // Value of the last Key/String token (unescaped).
+    const std::string& str() const { return str_; }
+    // Raw text of the last Number token.
+    std::string_view  raw() const { return raw_; }
+    double            number() const;
+
+    // Skip the value that follows the last Key token (or the remainder of
+    // the container whose Begin token was just returned when `inside`).
+    void skipValue(bool inside = false);
+
+    bool failed() const { return failed_; }
+
+private:
+    bool parseString();
+    void skipWs();
+
+    const char*      p_;
+    const char*      end_;
+    std::string      str_;
+    std::string_view raw_;
+    bool             failed_ = false;
+};
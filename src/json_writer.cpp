@@ -0,0 +1,158 @@
+#include "json_writer.h"
+
+#include <charconv>
+#include <cmath>
+
+JsonWriter::JsonWriter(std::string& out, bool pretty) : out_(out), pretty_(pretty) {
+    out_.clear();
+}
+
+// ---------------------------------------------------------------------------
+// structure  –  separators and indentation
+// ---------------------------------------------------------------------------
+
+void JsonWriter::newline() {
+    if (!pretty_) return;
+    out_ += '\n';
+    out_.append(static_cast<size_t>(depth_) * 2, ' ');
+}
+
+// Everything that starts a value goes through here: after a key the value
+// follows directly, inside an array it needs its own separator.
+void JsonWriter::prefix() {
+    if (after_key_) {
+        after_key_ = false;
+        return;
+    }
+    if (depth_ == 0) return;
+    if (!first_[depth_ - 1]) out_ += ',';
+    first_[depth_ - 1] = false;
+    newline();
+}
+
+void JsonWriter::beginObject() {
+    prefix();
+    out_ += '{';
+    if (depth_ < kMaxDepth) first_[depth_] = true;
+    ++depth_;
+}
+
+void JsonWriter::endObject() {
+    --depth_;
+    if (depth_ < kMaxDepth && !first_[depth_]) newline();
+    out_ += '}';
+    if (depth_ == 0 && pretty_) out_ += '\n';
+}
+
+void JsonWriter::beginArray() {
+    prefix();
+    out_ += '[';
+    if (depth_ < kMaxDepth) first_[depth_] = true;
+    ++depth_;
+}
+
+void JsonWriter::endArray() {
+    --depth_;
+    if (depth_ < kMaxDepth && !first_[depth_]) newline();
+    out_ += ']';
+    if (depth_ == 0 && pretty_) out_ += '\n';
+}
+
+void JsonWriter::key(std::string_view k) {
+    prefix();
+    out_ += '"';
+    out_ += k;
+    out_ += pretty_ ? "\": " : "\":";
+    after_key_ = true;
+}
+
+// ---------------------------------------------------------------------------
+// values
+// ---------------------------------------------------------------------------
+
+static inline bool needsEscape(char c) {
+    return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+static void appendEscaped(std::string& out, std::string_view s) {
+    static const char kHex[] = "0123456789abcdef";
+    size_t run = 0;   // start of the pending unescaped run
+    for (size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (!needsEscape(c)) continue;
+        out.append(s.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n";  break;
+        case '\r': out += "\\r";  break;
+        case '\t': out += "\\t";  break;
+        case '\b': out += "\\b";  break;
+        case '\f': out += "\\f";  break;
+        default:
+            out += "\\u00";
+            out += kHex[(static_cast<unsigned char>(c) >> 4) & 0xF];
+            out += kHex[static_cast<unsigned char>(c) & 0xF];
+        }
+    }
+    out.append(s.data() + run, s.size() - run);
+}
+
+void appendJsonString(std::string& out, std::string_view s) {
+    out += '"';
+    appendEscaped(out, s);
+    out += '"';
+}
+
+void JsonWriter::value(std::string_view s) {
+    prefix();
+    appendJsonString(out_, s);
+}
+
+// JSON has no NaN/Infinity; those become null.
+void JsonWriter::value(double v) {
+    prefix();
+    if (!std::isfinite(v)) { out_ += "null"; return; }
+    char buf[32];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out_.append(buf, static_cast<size_t>(r.ptr - buf));
+}
+
+// Formatted as float so 12.3f prints as 12.3, not 12.300000190734863.
+void JsonWriter::value(float v) {
+    prefix();
+    if (!std::isfinite(v)) { out_ += "null"; return; }
+    char buf[32];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out_.append(buf, static_cast<size_t>(r.ptr - buf));
+}
+
+void JsonWriter::value(int64_t v) {
+    prefix();
+    char buf[24];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out_.append(buf, static_cast<size_t>(r.ptr - buf));
+}
+
+void JsonWriter::value(uint64_t v) {
+    prefix();
+    char buf[24];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out_.append(buf, static_cast<size_t>(r.ptr - buf));
+}
+
+void JsonWriter::value(bool v) {
+    prefix();
+    out_ += v ? "true" : "false";
+}
+
+void JsonWriter::null() {
+    prefix();
+    out_ += "null";
+}
+
+void JsonWriter::rawValue(std::string_view json) {
+    prefix();
+    out_ += json;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Append `s` as a quoted JSON string.
+void appendJsonString(std::string& out, std::string_view s);
+
+// Streaming JSON writer that appends to a caller-owned string.  The caller
+// keeps that string between documents, so once it has grown to the usual
+// document size rendering does not allocate.  Numbers go through
+// std::to_chars (locale independent, shortest round-trip form) and commas
+// and indentation are tracked here instead of by the caller.
+//
+// Keys are written as given: they are expected to be literals that need no
+// escaping.  String values are escaped, with a fast path for the common
+// case of a string that contains nothing to escape.
+class JsonWriter {
+public:
+    // Clears `out` (keeping its capacity).  `pretty` indents by two spaces
+    // per level and ends the document with a newline.
+    JsonWriter(std::string& out, bool pretty);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    void key(std::string_view k);
+
+    void value(std::string_view s);
+    void value(const char* s) { value(std::string_view(s)); }
+    void value(const std::string& s) { value(std::string_view(s)); }
+    void value(double v);
+    void value(float v);
+    void value(int64_t v);
+    void value(uint64_t v);
+    void value(int v) { value(static_cast<int64_t>(v)); }
+    // Any other integer type (long / unsigned long are not int64_t /
+    // uint64_t on ILP32 targets such as armhf)
+    template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    void value(T v) {
+        if constexpr (std::is_signed_v<T>) value(static_cast<int64_t>(v));
+        else                               value(static_cast<uint64_t>(v));
+    }
+    void value(bool v);
+    void null();
+
+    // Already rendered JSON (e.g. a cached fragment) written as one value.
+    void rawValue(std::string_view json);
+
+    template <typename T>
+    void field(std::string_view k, const T& v) {
+        key(k);
+        value(v);
+    }
+
+private:
+    void prefix();
+    void newline();
+
+    static constexpr int kMaxDepth = 32;
+
+    std::string& out_;
+    bool         pretty_;
+    bool         after_key_ = false;
+    int          depth_     = 0;
+    bool         first_[kMaxDepth] = {};
+};
@@ -0,0 +1,50 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+
+// Values below kSubBuckets get a bucket each; above that, the top set bit
+// picks the power of two and the next kSubBits bits the sub-bucket.
+int LatencyHistogram::bucketOf(uint64_t ns) {
+    if (ns < kSubBuckets) return static_cast<int>(ns);
+    int msb = 63 - __builtin_clzll(ns);
+    return (msb - kSubBits + 1) * kSubBuckets + static_cast<int>((ns >> (msb - kSubBits)) & (kSubBuckets - 1));
+}
+
+uint64_t LatencyHistogram::upperBound(int bucket) {
+    if (bucket < kSubBuckets) return static_cast<uint64_t>(bucket);
+    int      shift = bucket / kSubBuckets - 1;
+    uint64_t lower = static_cast<uint64_t>(kSubBuckets + bucket % kSubBuckets) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets_[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t seen = max_.load(std::memory_order_relaxed);
+    while (ns > seen && !max_.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {}
+}
+
+LatencyHistogram::Summary LatencyHistogram::summary() const {
+    Summary s;
+    s.sum_ns = sum_.load(std::memory_order_relaxed);
+    s.max_ns = max_.load(std::memory_order_relaxed);
+
+    uint64_t counts[kBuckets];
+    for (int i = 0; i < kBuckets; ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        s.count += counts[i];
+    }
+    if (s.count == 0) return s;
+
+    // ranks of the three quantiles, found in one pass
+    const uint64_t ranks[3] = {(s.count * 50 + 99) / 100, (s.count * 90 + 99) / 100, (s.count * 99 + 99) / 100};
+    uint64_t*      out[3]   = {&s.p50_ns, &s.p90_ns, &s.p99_ns};
+    uint64_t seen = 0;
+    int      q    = 0;
+    for (int i = 0; i < kBuckets && q < 3; ++i) {
+        seen += counts[i];
+        while (q < 3 && seen >= ranks[q]) *out[q++] = std::min(upperBound(i), s.max_ns);
+    }
+    return s;
+}
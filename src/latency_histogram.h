@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Latency histogram in the style of HdrHistogram: buckets are log-linear
+// (8 sub-buckets per power of two, so any value is within 12.5% of its
+// bucket's bounds) over the whole uint64_t nanosecond range, in a fixed
+// array.  record() is a handful of relaxed atomic adds, so any number of
+// threads can record while another reads a summary, without locks.
+class LatencyHistogram {
+public:
+    struct Summary {
+        uint64_t count  = 0;
+        uint64_t sum_ns = 0;
+        uint64_t max_ns = 0;
+        uint64_t p50_ns = 0;
+        uint64_t p90_ns = 0;
+        uint64_t p99_ns = 0;
+    };
+
+    void record(uint64_t ns);
+
+    // Quantiles are the upper bound of the bucket they fall in (capped at
+    // the maximum); a summary taken during concurrent recording may be off
+    // by the samples in flight.
+    Summary summary() const;
+
+private:
+    static constexpr int kSubBits    = 3;
+    static constexpr int kSubBuckets = 1 << kSubBits;
+    static constexpr int kBuckets    = (64 - kSubBits + 1) * kSubBuckets;
+
+    static int      bucketOf(uint64_t ns);
+    static uint64_t upperBound(int bucket);
+
+    std::atomic<uint64_t> buckets_[kBuckets] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
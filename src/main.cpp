@@ -1,12 +1,24 @@
+#include "fleet.h"
 #include "health_collector.h"
+#include "json_writer.h"
+#include "netlink_stats.h"
+#include "prepared_body.h"
+#include "sampler.h"
+#include "self_metrics.h"
 
 #include "httplib.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <string_view>
 #include <thread>
 #include <chrono>
+#include <ctime>
+#include <memory>
 
 static std::string readHtmlFile(const std::string& path) {
     std::ifstream f(path);
@@ -16,37 +28,479 @@ static std::string readHtmlFile(const std::string& path) {
     return ss.str();
 }
 
+// ---------------------------------------------------------------------------
+// conditional / compressed responses for pre-rendered bodies
+// ---------------------------------------------------------------------------
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back()  == ' ' || s.back()  == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+// Calls fn(element) for each comma-separated element of a header value.
+template <typename Fn>
+static bool anyListElement(std::string_view header, Fn fn) {
+    while (!header.empty()) {
+        size_t comma = header.find(',');
+        if (fn(trim(header.substr(0, comma)))) return true;
+        if (comma == std::string_view::npos) break;
+        header.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// "gzip" listed without q=0
+static bool acceptsGzip(const httplib::Request& req) {
+    return anyListElement(req.get_header_value("Accept-Encoding"), [](std::string_view e) {
+        size_t semi = e.find(';');
+        if (trim(e.substr(0, semi)) != "gzip") return false;
+        if (semi == std::string_view::npos) return true;
+        std::string_view q = trim(e.substr(semi + 1));
+        return !(q.rfind("q=0", 0) == 0 && q.find_first_not_of("q=0.") == std::string_view::npos);
+    });
+}
+
+// If-None-Match uses the weak comparison, so a W/ prefix is ignored.
+static bool etagMatches(const httplib::Request& req, const std::string& etag) {
+    if (!req.has_header("If-None-Match")) return false;
+    return anyListElement(req.get_header_value("If-None-Match"), [&etag](std::string_view t) {
+        if (t == "*") return true;
+        if (t.rfind("W/", 0) == 0) t.remove_prefix(2);
+        return t == etag;
+    });
+}
+
+// Answer with 304 if the client already has this representation, otherwise
+// stream the plain or gzip buffer.  `owner` keeps the buffers alive until
+// the response has been written, so nothing is copied.
+static void servePrepared(const httplib::Request& req, httplib::Response& res,
+                          std::shared_ptr<const void> owner, const PreparedBody& body,
+                          const char* contentType) {
+    bool gzip = !body.gzip.empty() && acceptsGzip(req);
+    const std::string& etag = gzip ? body.gzip_etag : body.etag;
+    res.set_header("ETag", etag);
+    res.set_header("Vary", "Accept-Encoding");
+    res.set_header("Cache-Control", "no-cache");
+    if (etagMatches(req, etag)) {
+        res.status = 304;
+        return;
+    }
+
+    const std::string& data = gzip ? body.gzip : body.text;
+    if (gzip) res.set_header("Content-Encoding", "gzip");
+    res.set_content_provider(
+        data.size(), contentType,
+        [owner, &data](size_t offset, size_t length, httplib::DataSink& sink) {
+            return sink.write(data.data() + offset, length);
+        });
+}
+
+// {"timestamp": ..., "<group>": <fragment>, ...} for the groups in `mask`
+// that the snapshot has.
+static std::string joinGroups(const HealthSnapshot& snap, uint32_t mask) {
+    std::string out;
+    JsonWriter w(out, false);
+    w.beginObject();
+    w.field("timestamp", snap.timestamp);
+    for (int i = 0; i < kMetricGroupCount; ++i) {
+        if (!(mask & snap.collected & (1u << i))) continue;
+        w.key(metricGroupName(i));
+        w.rawValue(snap.groups[i].text);
+    }
+    w.endObject();
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// request timing  –  started before routing, recorded by the logger once the
+// response has been written; a request is handled on one thread throughout
+// ---------------------------------------------------------------------------
+
+static thread_local std::chrono::steady_clock::time_point t_requestStart;
+
+// Route a path is accounted to; fixed names keep the label set bounded.
+// nullptr for /api/stream, whose requests last as long as the subscriber.
+static const char* routeName(const std::string& path) {
+    static const char* const kRoutes[] = {"/", "/api/health", "/metrics", "/api/history", "/api/self",
+                                          "/api/alerts", "/fleet", "/api/fleet"};
+    for (const char* r : kRoutes)
+        if (path == r) return r;
+    if (path == "/api/stream") return nullptr;
+    if (path.rfind("/api/health/", 0) == 0) return "/api/health/<group>";
+    return "other";
+}
+
 int main() {
-    // Start background thread: run internet speed test immediately, then every 1 hour
-    std::thread speedThread([]() {
-        HealthCollector::updateSpeedTestCache();
-        while (true) {
-            std::this_thread::sleep_for(std::chrono::hours(1));
-            HealthCollector::updateSpeedTestCache();
+    // Metric groups to collect at all, e.g. COLLECT=cpu,memory,disks
+    uint32_t groups = kAllGroups;
+    const char* collectEnv = std::getenv("COLLECT");
+    if (collectEnv && !parseMetricGroups(collectEnv, groups)) {
+        std::cerr << "COLLECT: unknown metric group in \"" << collectEnv << "\"" << std::endl;
+        return 1;
+    }
+    // Read by the collector; checked here so a typo stops the start
+    NetBackend netBackend;
+    const char* netEnv = std::getenv("NET_BACKEND");
+    if (netEnv && !parseNetBackend(netEnv, netBackend)) {
+        std::cerr << "NET_BACKEND: expected auto, netlink or procfs, got \"" << netEnv << "\"" << std::endl;
+        return 1;
+    }
+
+    // Read by the collector's speed test; checked here for the same reason
+    for (const char* name : {"SPEEDTEST_DOWNLOAD_URL", "SPEEDTEST_UPLOAD_URL"}) {
+        const char* url = std::getenv(name);
+        std::string host, port, path;
+        bool optional = std::string_view(name) == "SPEEDTEST_UPLOAD_URL";   // empty: no upload
+        if (url && (*url || !optional) && !parseHttpUrl(url, host, port, path)) {
+            std::cerr << name << ": expected http://host[:port]/path, got \"" << url << "\"" << std::endl;
+            return 1;
         }
-    });
-    speedThread.detach();
+    }
+
+    // Single sampler thread: collection runs on its own schedule no matter
+    // how many clients poll /api/health
+    SamplerOptions options;
+    const char* intervalEnv = std::getenv("SAMPLE_INTERVAL_MS");
+    if (intervalEnv) options.interval = std::chrono::milliseconds(std::stol(intervalEnv));
+    const char* historyEnv = std::getenv("HISTORY_HOURS");
+    if (historyEnv) options.history_retention = std::chrono::hours(std::stol(historyEnv));
+    const char* historySeriesEnv = std::getenv("HISTORY_MAX_SERIES");
+    if (historySeriesEnv) options.history_max_series = std::stoul(historySeriesEnv);
+    options.groups = groups;
+    defaultSchedules(options.schedules, options.interval);
+    const char* schedEnv = std::getenv("GROUP_INTERVALS_MS");
+    if (schedEnv && !parseSchedules(schedEnv, options.schedules)) {
+        std::cerr << "GROUP_INTERVALS_MS: expected group=ms[:max_ms],... in \"" << schedEnv << "\"" << std::endl;
+        return 1;
+    }
+    const char* dataDirEnv = std::getenv("DATA_DIR");
+    if (dataDirEnv) options.data_dir = dataDirEnv;
+    const char* dataRetentionEnv = std::getenv("DATA_RETENTION_DAYS");
+    if (dataRetentionEnv) options.data_retention = std::chrono::hours(24 * std::stol(dataRetentionEnv));
+    // Alert rules: ALERT_RULES inline, or one per line in ALERT_RULES_FILE
+    std::string rulesText;
+    const char* rulesEnv = std::getenv("ALERT_RULES");
+    if (rulesEnv) rulesText = rulesEnv;
+    const char* rulesFileEnv = std::getenv("ALERT_RULES_FILE");
+    if (rulesFileEnv) {
+        std::ifstream f(rulesFileEnv);
+        if (!f.is_open()) {
+            std::cerr << "ALERT_RULES_FILE: cannot read \"" << rulesFileEnv << "\"" << std::endl;
+            return 1;
+        }
+        std::ostringstream ss;
+        ss << f.rdbuf();
+        rulesText += '\n' + ss.str();
+    }
+    std::string badRule;
+    if (!parseAlertRules(rulesText, options.alert_rules, badRule)) {
+        std::cerr << "ALERT_RULES: expected name: metric [rate|zscore] op value [for 30s], got \""
+                  << badRule << "\"" << std::endl;
+        return 1;
+    }
+    const char* webhookEnv = std::getenv("ALERT_WEBHOOK");
+    if (webhookEnv) {
+        std::string host, port, path;
+        if (!parseHttpUrl(webhookEnv, host, port, path)) {
+            std::cerr << "ALERT_WEBHOOK: expected http://host[:port]/path, got \"" << webhookEnv << "\"" << std::endl;
+            return 1;
+        }
+        options.alert_webhook = webhookEnv;
+    }
+    Sampler sampler{options};
+    if (!sampler.history().storeUsable()) {
+        std::cerr << "DATA_DIR: cannot open the metrics store in \"" << options.data_dir << "\"" << std::endl;
+        return 1;
+    }
+    sampler.start();
+
+    // Federation mode: FLEET_PEERS=host:port,... polls those instances and
+    // serves the merged view on /api/fleet and /fleet
+    FleetOptions fleetOptions;
+    const char* peersEnv = std::getenv("FLEET_PEERS");
+    if (peersEnv && !parseFleetPeers(peersEnv, fleetOptions.peers)) {
+        std::cerr << "FLEET_PEERS: expected host:port,... in \"" << peersEnv << "\"" << std::endl;
+        return 1;
+    }
+    const char* fleetIntervalEnv = std::getenv("FLEET_INTERVAL_MS");
+    if (fleetIntervalEnv) fleetOptions.interval = std::chrono::milliseconds(std::max(std::stol(fleetIntervalEnv), 100L));
+    const char* fleetTimeoutEnv = std::getenv("FLEET_TIMEOUT_MS");
+    if (fleetTimeoutEnv) fleetOptions.timeout = std::chrono::milliseconds(std::max(std::stol(fleetTimeoutEnv), 100L));
+    std::unique_ptr<FleetAggregator> fleet;
+    if (!fleetOptions.peers.empty()) {
+        fleet = std::make_unique<FleetAggregator>(fleetOptions);
+        fleet->start();
+    }
 
     httplib::Server svr;
 
-    // Serve the web dashboard
-    svr.Get("/", [](const httplib::Request&, httplib::Response& res) {
-        const char* webRoot = std::getenv("WEB_ROOT");
-        std::string indexPath = webRoot ? std::string(webRoot) + "/index.html"
-                                        : "/usr/share/serverhealth/index.html";
-        std::string html = readHtmlFile(indexPath);
-        if (html.empty()) {
+    // Every /api/stream subscriber parks one server thread, so the pool gets
+    // room for them on top of the usual request workers.
+    size_t httpThreads = CPPHTTPLIB_THREAD_POOL_COUNT;
+    const char* threadsEnv = std::getenv("HTTP_THREADS");
+    if (threadsEnv) httpThreads = static_cast<size_t>(std::max(std::stoi(threadsEnv), 1));
+    int maxStreamClients = 32;
+    const char* streamEnv = std::getenv("STREAM_MAX_CLIENTS");
+    if (streamEnv) maxStreamClients = std::stoi(streamEnv);
+    const size_t poolThreads = httpThreads + static_cast<size_t>(std::max(maxStreamClients, 0));
+    svr.new_task_queue = [poolThreads] { return new httplib::ThreadPool(poolThreads); };
+
+    // A poller that keeps its connection open costs one worker for the
+    // keep-alive timeout between requests, so with many pollers a short
+    // timeout (or more threads) keeps the pool from running dry.
+    const char* keepAliveEnv = std::getenv("HTTP_KEEP_ALIVE_MAX");
+    if (keepAliveEnv) svr.set_keep_alive_max_count(static_cast<size_t>(std::max(std::stoi(keepAliveEnv), 1)));
+    const char* keepAliveTimeoutEnv = std::getenv("HTTP_KEEP_ALIVE_TIMEOUT_S");
+    if (keepAliveTimeoutEnv) svr.set_keep_alive_timeout(std::stol(keepAliveTimeoutEnv));
+    const char* readTimeoutEnv = std::getenv("HTTP_READ_TIMEOUT_MS");
+    if (readTimeoutEnv) {
+        long ms = std::stol(readTimeoutEnv);
+        svr.set_read_timeout(ms / 1000, (ms % 1000) * 1000);
+    }
+    const char* writeTimeoutEnv = std::getenv("HTTP_WRITE_TIMEOUT_MS");
+    if (writeTimeoutEnv) {
+        long ms = std::stol(writeTimeoutEnv);
+        svr.set_write_timeout(ms / 1000, (ms % 1000) * 1000);
+    }
+    std::atomic<int> streamClients{0};
+
+    // Serve the web dashboard: read and compressed once at startup
+    const char* webRoot = std::getenv("WEB_ROOT");
+    std::string indexPath = webRoot ? std::string(webRoot) + "/index.html"
+                                    : "/usr/share/serverhealth/index.html";
+    auto dashboard = std::make_shared<PreparedBody>();
+    dashboard->text = readHtmlFile(indexPath);
+    if (!dashboard->text.empty()) {
+        GzipEncoder best(9);
+        prepareBody(*dashboard, best);
+    }
+    svr.Get("/", [dashboard](const httplib::Request& req, httplib::Response& res) {
+        if (dashboard->text.empty()) {
             res.status = 404;
             res.set_content("index.html not found", "text/plain");
         } else {
-            res.set_content(html, "text/html");
+            servePrepared(req, res, dashboard, *dashboard, "text/html");
         }
     });
 
-    // Health metrics JSON API
-    svr.Get("/api/health", [](const httplib::Request&, httplib::Response& res) {
-        HealthCollector collector;
-        res.set_content(collector.getHealthJson(), "application/json");
+    // Fleet dashboard and API, only in federation mode
+    //   /api/fleet              status and key figures of every peer
+    //   /api/fleet?peer=host:port  that peer's last merged /api/health document
+    auto fleetPage = std::make_shared<PreparedBody>();
+    if (fleet) {
+        fleetPage->text = readHtmlFile(webRoot ? std::string(webRoot) + "/fleet.html"
+                                               : "/usr/share/serverhealth/fleet.html");
+        if (!fleetPage->text.empty()) {
+            GzipEncoder best(9);
+            prepareBody(*fleetPage, best);
+        }
+    }
+    svr.Get("/fleet", [fleetPage](const httplib::Request& req, httplib::Response& res) {
+        if (fleetPage->text.empty()) {
+            res.status = 404;
+            res.set_content("fleet.html not found (or FLEET_PEERS not set)", "text/plain");
+        } else {
+            servePrepared(req, res, fleetPage, *fleetPage, "text/html");
+        }
+    });
+    svr.Get("/api/fleet", [&fleet](const httplib::Request& req, httplib::Response& res) {
+        if (!fleet) {
+            res.status = 404;
+            res.set_content("federation mode is off (set FLEET_PEERS)", "text/plain");
+            return;
+        }
+        if (req.has_param("peer")) {
+            std::string body;
+            if (!fleet->peerJson(req.get_param_value("peer"), body)) {
+                res.status = 404;
+                res.set_content("unknown peer or no data yet", "text/plain");
+                return;
+            }
+            res.set_header("Cache-Control", "no-cache");
+            res.set_content(std::move(body), "application/json");
+            return;
+        }
+        auto snap = fleet->latest();
+        servePrepared(req, res, snap, snap->json, "application/json");
+    });
+
+    // Health metrics JSON API; ?compact=1 drops the indentation.
+    // ?include=cpu,memory returns just those groups, joined from the
+    // pre-rendered per-group fragments.
+    // Accept: application/cbor (or ?format=cbor) returns the same document
+    // as CBOR; with ?since=N&instance=I only what changed after sequence N,
+    // cut from the pre-encoded document.
+    svr.Get("/api/health", [&sampler](const httplib::Request& req, httplib::Response& res) {
+        auto snap = sampler.latest();
+        res.set_header("Vary", "Accept");
+        if (req.get_param_value("format") == "cbor" ||
+            req.get_header_value("Accept").find("application/cbor") != std::string::npos) {
+            if (req.has_param("since") &&
+                std::strtoull(req.get_param_value("instance").c_str(), nullptr, 10) == snap->instance) {
+                std::string body;
+                if (writeCborDelta(*snap, std::strtoull(req.get_param_value("since").c_str(), nullptr, 10), body)) {
+                    res.set_header("Cache-Control", "no-cache");
+                    res.set_content(body, "application/cbor");
+                    return;
+                }
+            }
+            servePrepared(req, res, snap, snap->cbor, "application/cbor");
+            return;
+        }
+        if (req.has_param("include")) {
+            uint32_t mask;
+            if (!parseMetricGroups(req.get_param_value("include"), mask)) {
+                res.status = 400;
+                res.set_content("unknown metric group", "text/plain");
+                return;
+            }
+            res.set_header("Cache-Control", "no-cache");
+            res.set_content(joinGroups(*snap, mask), "application/json");
+            return;
+        }
+        bool compact = req.get_param_value("compact") == "1";
+        servePrepared(req, res, snap, compact ? snap->json_compact : snap->json, "application/json");
+    });
+
+    // A single group, e.g. /api/health/memory
+    svr.Get(R"(/api/health/([a-z_]+))", [&sampler](const httplib::Request& req, httplib::Response& res) {
+        auto snap = sampler.latest();
+        int index = metricGroupIndex(req.matches[1].str());
+        if (index < 0 || !(snap->collected & (1u << index))) {
+            res.status = 404;
+            res.set_content("unknown metric group", "text/plain");
+            return;
+        }
+        servePrepared(req, res, snap, snap->groups[index], "application/json");
+    });
+
+    // Prometheus / OpenMetrics scrape target, rendered once per sample
+    svr.Get("/metrics", [&sampler](const httplib::Request& req, httplib::Response& res) {
+        auto snap = sampler.latest();
+        servePrepared(req, res, snap, snap->metrics,
+                      "application/openmetrics-text; version=1.0.0; charset=utf-8");
+    });
+
+    // Live updates as Server-Sent Events: a "full" frame first, then one
+    // "delta" frame per sample.  Frames are rendered once by the sampler and
+    // the same buffer is written to every subscriber.  A client that missed
+    // a sample (or reconnects with a stale Last-Event-ID) gets a full frame.
+    svr.Get("/api/stream", [&sampler, &streamClients, maxStreamClients](const httplib::Request& req,
+                                                                       httplib::Response& res) {
+        if (streamClients.fetch_add(1) >= maxStreamClients) {
+            streamClients.fetch_sub(1);
+            res.status = 503;
+            res.set_header("Retry-After", "5");
+            res.set_content("too many stream clients", "text/plain");
+            return;
+        }
+
+        auto lastSent = std::make_shared<uint64_t>(0);
+        if (req.has_header("Last-Event-ID")) {
+            *lastSent = std::strtoull(req.get_header_value("Last-Event-ID").c_str(), nullptr, 10);
+            if (*lastSent > sampler.latest()->sequence) *lastSent = 0;   // from an earlier run
+        }
+
+        res.set_header("Cache-Control", "no-cache");
+        res.set_header("X-Accel-Buffering", "no");   // keep reverse proxies from batching frames
+        res.set_chunked_content_provider(
+            "text/event-stream",
+            [&sampler, lastSent](size_t, httplib::DataSink& sink) {
+                auto snap = sampler.waitForNewer(*lastSent, std::chrono::seconds(15));
+                if (!snap) {   // shutting down
+                    sink.done();
+                    return true;
+                }
+                if (snap->sequence <= *lastSent) {
+                    static const char kKeepAlive[] = ": keep-alive\n\n";
+                    return sink.write(kKeepAlive, sizeof(kKeepAlive) - 1);
+                }
+                bool next = *lastSent != 0 && snap->sequence == *lastSent + 1 && !snap->stream_delta.empty();
+                const std::string& frame = next ? snap->stream_delta : snap->stream_full;
+                *lastSent = snap->sequence;
+                return sink.write(frame.data(), frame.size());
+            },
+            [&streamClients](bool) { streamClients.fetch_sub(1); });
+    });
+
+    // Time series of the sampled metrics, served straight from the rings (or
+    // the mapped segments of DATA_DIR for older ranges)
+    //   /api/history                      list of metrics and tier steps
+    //   /api/history?metric=M&from=&to=&step=
+    // from/to are unix seconds; values <= 0 are relative to now.
+    svr.Get("/api/history", [&sampler](const httplib::Request& req, httplib::Response& res) {
+        const MetricHistory& history = sampler.history();
+        if (!req.has_param("metric")) {
+            res.set_content(history.catalogJson(), "application/json");
+            return;
+        }
+
+        int64_t now  = std::time(nullptr);
+        int64_t from = now - 3600, to = now;
+        double  step = 0.0;
+        try {
+            if (req.has_param("from")) from = std::stoll(req.get_param_value("from"));
+            if (req.has_param("to"))   to   = std::stoll(req.get_param_value("to"));
+            if (req.has_param("step")) step = std::stod(req.get_param_value("step"));
+        } catch (...) {
+            res.status = 400;
+            res.set_content("from, to and step must be numbers", "text/plain");
+            return;
+        }
+        // times are handled in ms; beyond this they would overflow
+        constexpr double kMaxSeconds = 1e12;
+        if (!(step >= 0 && step <= kMaxSeconds) || from < -kMaxSeconds || from > kMaxSeconds ||
+            to < -kMaxSeconds || to > kMaxSeconds) {
+            res.status = 400;
+            res.set_content("from, to and step out of range", "text/plain");
+            return;
+        }
+        if (from <= 0) from += now;
+        if (to   <= 0) to   += now;
+
+        std::string body;
+        if (!history.queryJson(req.get_param_value("metric"), from, to, step, body)) {
+            res.status = 404;
+            res.set_content("unknown metric", "text/plain");
+            return;
+        }
+        res.set_content(body, "application/json");
+    });
+
+    // Alert rules and what is firing (or waiting out its "for") right now
+    svr.Get("/api/alerts", [&sampler](const httplib::Request& req, httplib::Response& res) {
+        auto snap = sampler.latest();
+        servePrepared(req, res, snap, snap->alerts, "application/json");
+    });
+
+    // The monitor's own overhead: collector cost, publish time, request
+    // latency and process CPU / memory
+    svr.Get("/api/self", [](const httplib::Request&, httplib::Response& res) {
+        std::string body;
+        selfMetrics().writeJson(body);
+        res.set_header("Cache-Control", "no-cache");
+        res.set_content(std::move(body), "application/json");
+    });
+
+    svr.set_pre_routing_handler([](const httplib::Request&, httplib::Response&) {
+        t_requestStart = std::chrono::steady_clock::now();
+        return httplib::Server::HandlerResponse::Unhandled;
+    });
+    svr.set_logger([](const httplib::Request& req, const httplib::Response&) {
+        const char* route = routeName(req.path);
+        if (!route) return;
+        // lookups only take the registry lock the first time a route is seen
+        static thread_local std::vector<std::pair<const char*, LatencyHistogram*>> cache;
+        LatencyHistogram* h = nullptr;
+        for (const auto& c : cache)
+            if (c.first == route) h = c.second;
+        if (!h) {
+            h = &selfMetrics().route(route);
+            cache.emplace_back(route, h);
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t_requestStart);
+        h->record(static_cast<uint64_t>(ns.count()));
     });
 
     // CORS header so the page can be served from any origin during development
@@ -62,5 +516,7 @@ int main() {
               << port << std::endl;
 
     svr.listen("0.0.0.0", port);
+    if (fleet) fleet->stop();
+    sampler.stop();
     return 0;
 }
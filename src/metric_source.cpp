@@ -0,0 +1,81 @@
+#include "metric_source.h"
+
+#include <cerrno>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+IoCounters& threadIoCounters() {
+    static thread_local IoCounters counters;
+    return counters;
+}
+
+MetricSource::~MetricSource() {
+    close();
+}
+
+MetricSource::MetricSource(MetricSource&& other) noexcept
+    : path_(std::move(other.path_)), fd_(other.fd_), buf_(std::move(other.buf_)) {
+    other.fd_ = -1;
+}
+
+MetricSource& MetricSource::operator=(MetricSource&& other) noexcept {
+    if (this != &other) {
+        close();
+        path_ = std::move(other.path_);
+        fd_   = other.fd_;
+        buf_  = std::move(other.buf_);
+        other.fd_ = -1;
+    }
+    return *this;
+}
+
+bool MetricSource::open() {
+    if (fd_ >= 0) return true;
+    ++threadIoCounters().syscalls;
+    fd_ = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    return fd_ >= 0;
+}
+
+void MetricSource::close() {
+    if (fd_ >= 0) {
+        ++threadIoCounters().syscalls;
+        ::close(fd_);
+    }
+    fd_ = -1;
+}
+
+std::string_view MetricSource::read() {
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (!open()) return {};
+        if (buf_.empty()) buf_.resize(4096);
+
+        // A short read normally means the whole file fit: proc and sys only
+        // return less than asked for at end of file.  seq_file based files
+        // (/proc/net/dev, /proc/diskstats, ...) are the exception: they
+        // hand out one page worth of whole records per call, so a short
+        // read that got past half a page keeps reading from where it
+        // stopped until EOF.  A full buffer is grown and the file re-read
+        // from 0 so the view is always one consistent snapshot.
+        IoCounters& io = threadIoCounters();
+        size_t len = 0;
+        for (;;) {
+            ssize_t n = ::pread(fd_, buf_.data() + len, buf_.size() - len, static_cast<off_t>(len));
+            ++io.syscalls;
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) break;
+            io.bytes_read += static_cast<uint64_t>(n);
+            if (n == 0) return std::string_view(buf_.data(), len);
+            if (static_cast<size_t>(n) == buf_.size() - len) {
+                len = 0;
+                buf_.resize(buf_.size() * 2);
+                continue;
+            }
+            len += static_cast<size_t>(n);
+            if (n < 2048) return std::string_view(buf_.data(), len);
+        }
+        close();
+    }
+    return {};
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A /proc or /sys file that is opened once and re-read in place.
+//
+// procfs and sysfs regenerate their contents on every read from offset 0,
+// so each sample costs a single pread() (one per page for large seq_file
+// tables) into a buffer that is kept between samples instead of open +
+// read + read(EOF) + close through an ifstream.
+// The file is opened lazily and re-opened once if a read fails (e.g. a
+// sysfs attribute whose device went away and came back).
+class MetricSource {
+public:
+    MetricSource() = default;
+    explicit MetricSource(std::string path) : path_(std::move(path)) {}
+    ~MetricSource();
+
+    MetricSource(MetricSource&& other) noexcept;
+    MetricSource& operator=(MetricSource&& other) noexcept;
+    MetricSource(const MetricSource&)            = delete;
+    MetricSource& operator=(const MetricSource&) = delete;
+
+    // Current contents of the file; the view stays valid until the next
+    // read().  Empty if the file cannot be read.
+    std::string_view read();
+
+    const std::string& path() const { return path_; }
+    int                fd()   const { return fd_; }
+    bool               open();
+    void               close();
+
+private:
+    std::string       path_;
+    int               fd_ = -1;
+    std::vector<char> buf_;
+};
+
+// Syscalls made and bytes read by MetricSource on the calling thread.  The
+// collector takes the difference around each source for /api/self.
+struct IoCounters {
+    uint64_t syscalls   = 0;
+    uint64_t bytes_read = 0;
+};
+IoCounters& threadIoCounters();
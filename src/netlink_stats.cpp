@@ -0,0 +1,177 @@
+#include "netlink_stats.h"
+
+#include "metric_source.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <linux/if.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+bool parseNetBackend(std::string_view name, NetBackend& out) {
+    if      (name == "auto")    out = NetBackend::Auto;
+    else if (name == "netlink") out = NetBackend::Netlink;
+    else if (name == "procfs")  out = NetBackend::Procfs;
+    else return false;
+    return true;
+}
+
+NetlinkLinkDump::~NetlinkLinkDump() {
+    close();
+}
+
+bool NetlinkLinkDump::open() {
+    if (fd_ >= 0) return true;
+    if (unavailable_) return false;
+    fd_ = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    sockaddr_nl local{};
+    local.nl_family = AF_NETLINK;
+    if (fd_ < 0 || ::bind(fd_, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0) {
+        close();
+        unavailable_ = true;
+        return false;
+    }
+    // the kernel answers a dump immediately; this only guards the sampler
+    timeval timeout{1, 0};
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (buf_.empty()) buf_.resize(64 * 1024);
+    return true;
+}
+
+void NetlinkLinkDump::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+// ---------------------------------------------------------------------------
+// RTM_NEWLINK  –  one interface
+// ---------------------------------------------------------------------------
+
+static const char* operState(uint8_t state) {
+    switch (state) {
+    case IF_OPER_NOTPRESENT:     return "notpresent";
+    case IF_OPER_DOWN:           return "down";
+    case IF_OPER_LOWERLAYERDOWN: return "lowerlayerdown";
+    case IF_OPER_TESTING:        return "testing";
+    case IF_OPER_DORMANT:        return "dormant";
+    case IF_OPER_UP:             return "up";
+    default:                     return "unknown";
+    }
+}
+
+// Returns false for messages that describe no reportable interface.
+static bool parseLink(const nlmsghdr* h, NetworkInterface& ni) {
+    const auto* ifi = static_cast<const ifinfomsg*>(NLMSG_DATA(h));
+    int len = static_cast<int>(h->nlmsg_len) - static_cast<int>(NLMSG_LENGTH(sizeof(*ifi)));
+    if (len < 0) return false;
+
+    std::string_view  name;
+    rtnl_link_stats64 s64{};
+    rtnl_link_stats   s32{};
+    bool              have64 = false;
+    bool              have32 = false;
+    uint8_t           oper   = IF_OPER_UNKNOWN;
+    // attribute payloads are only 4-byte aligned, hence memcpy
+    for (const rtattr* a = IFLA_RTA(ifi); RTA_OK(a, len); a = RTA_NEXT(a, len)) {
+        const char* data    = static_cast<const char*>(RTA_DATA(a));
+        size_t      payload = RTA_PAYLOAD(a);
+        switch (a->rta_type) {
+        case IFLA_IFNAME:
+            name = std::string_view(data, strnlen(data, payload));
+            break;
+        case IFLA_STATS64:
+            if (payload >= sizeof(s64)) { std::memcpy(&s64, data, sizeof(s64)); have64 = true; }
+            break;
+        case IFLA_STATS:
+            if (payload >= sizeof(s32)) { std::memcpy(&s32, data, sizeof(s32)); have32 = true; }
+            break;
+        case IFLA_OPERSTATE:
+            if (payload >= 1) oper = static_cast<uint8_t>(*data);
+            break;
+        }
+    }
+    if (name.empty() || name == "lo" || !(have64 || have32)) return false;
+
+    ni.name.assign(name.data(), name.size());
+    if (have64) {
+        ni.rx_bytes   = s64.rx_bytes;    ni.tx_bytes   = s64.tx_bytes;
+        ni.rx_packets = s64.rx_packets;  ni.tx_packets = s64.tx_packets;
+        ni.rx_errors  = s64.rx_errors;   ni.tx_errors  = s64.tx_errors;
+        ni.rx_dropped = s64.rx_dropped;  ni.tx_dropped = s64.tx_dropped;
+    } else {   // kernels before 2.6.35
+        ni.rx_bytes   = s32.rx_bytes;    ni.tx_bytes   = s32.tx_bytes;
+        ni.rx_packets = s32.rx_packets;  ni.tx_packets = s32.tx_packets;
+        ni.rx_errors  = s32.rx_errors;   ni.tx_errors  = s32.tx_errors;
+        ni.rx_dropped = s32.rx_dropped;  ni.tx_dropped = s32.tx_dropped;
+    }
+    ni.state      = operState(oper);
+    ni.speed_mbps = 0;
+    ni.rx_bytes_per_sec = ni.tx_bytes_per_sec = 0.0;
+    ni.rx_packets_per_sec = ni.tx_packets_per_sec = 0.0;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// dump
+// ---------------------------------------------------------------------------
+
+bool NetlinkLinkDump::dump(std::vector<NetworkInterface>& out) {
+    if (!open()) return false;
+    IoCounters& io = threadIoCounters();
+
+    struct {
+        nlmsghdr  nh;
+        ifinfomsg ifi;
+    } req{};
+    req.nh.nlmsg_len   = NLMSG_LENGTH(sizeof(ifinfomsg));
+    req.nh.nlmsg_type  = RTM_GETLINK;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq   = ++seq_;
+    req.ifi.ifi_family = AF_UNSPEC;
+    sockaddr_nl kernel{};
+    kernel.nl_family = AF_NETLINK;
+    ++io.syscalls;
+    if (::sendto(fd_, &req, req.nh.nlmsg_len, 0, reinterpret_cast<sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+        close();
+        return false;
+    }
+
+    size_t count = 0;
+    for (;;) {
+        iovec  iov{buf_.data(), buf_.size()};
+        msghdr msg{};
+        msg.msg_iov    = &iov;
+        msg.msg_iovlen = 1;
+        ssize_t n = ::recvmsg(fd_, &msg, 0);
+        ++io.syscalls;
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0 || (msg.msg_flags & MSG_TRUNC)) {
+            // a truncated message cannot be resumed: grow, and start over
+            // on a fresh socket next time so leftovers are not misread
+            if (n > 0) buf_.resize(buf_.size() * 2);
+            close();
+            return false;
+        }
+        io.bytes_read += static_cast<uint64_t>(n);
+
+        int left = static_cast<int>(n);
+        for (auto* h = reinterpret_cast<const nlmsghdr*>(buf_.data()); NLMSG_OK(h, left); h = NLMSG_NEXT(h, left)) {
+            if (h->nlmsg_seq != seq_) continue;
+            if (h->nlmsg_type == NLMSG_DONE) {
+                out.resize(count);
+                return true;
+            }
+            if (h->nlmsg_type == NLMSG_ERROR) {
+                close();
+                return false;
+            }
+            if (h->nlmsg_type != RTM_NEWLINK) continue;
+            if (count == out.size()) out.emplace_back();
+            if (parseLink(h, out[count])) ++count;
+        }
+    }
+}
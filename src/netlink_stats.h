@@ -0,0 +1,47 @@
+#pragma once
+
+#include "health_collector.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Where interface counters come from.  auto uses rtnetlink and falls back
+// to /proc/net/dev if the socket cannot be used.
+enum class NetBackend { Auto, Netlink, Procfs };
+
+// "auto" / "netlink" / "procfs"; false on anything else.
+bool parseNetBackend(std::string_view name, NetBackend& out);
+
+// One RTM_GETLINK dump over a NETLINK_ROUTE socket that stays open between
+// samples.  The kernel answers with binary IFLA_STATS64 counters for every
+// interface at once, so hosts with thousands of veth devices cost a few
+// recv() calls instead of formatting and parsing /proc/net/dev.
+class NetlinkLinkDump {
+public:
+    NetlinkLinkDump() = default;
+    ~NetlinkLinkDump();
+
+    NetlinkLinkDump(const NetlinkLinkDump&)            = delete;
+    NetlinkLinkDump& operator=(const NetlinkLinkDump&) = delete;
+
+    // Fill `out` (lo excluded) with counters, errors, drops and operstate.
+    // Entries are overwritten in place, so a vector kept between calls
+    // stops allocating once it has seen every interface.  False if the
+    // socket could not be opened or the dump failed; `out` is then
+    // unspecified.
+    bool dump(std::vector<NetworkInterface>& out);
+
+    // True once opening the socket has failed (no permission, no netlink);
+    // there is no point trying again.
+    bool unavailable() const { return unavailable_; }
+
+private:
+    bool open();
+    void close();
+
+    int               fd_  = -1;
+    uint32_t          seq_ = 0;
+    bool              unavailable_ = false;
+    std::vector<char> buf_;
+};
@@ -0,0 +1,485 @@
+#include "openmetrics.h"
+
+#include "self_metrics.h"
+
+#include <charconv>
+#include <cmath>
+#include <initializer_list>
+#include <string_view>
+#include <utility>
+
+// ---------------------------------------------------------------------------
+// text helpers  –  append straight into the output buffer
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct Label {
+    const char*      name;
+    std::string_view value;
+};
+
+} // namespace
+
+static void appendNumber(std::string& out, double v) {
+    if (std::isnan(v)) { out += "NaN"; return; }
+    if (std::isinf(v)) { out += v > 0 ? "+Inf" : "-Inf"; return; }
+    char buf[32];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, static_cast<size_t>(r.ptr - buf));
+}
+
+static void appendNumber(std::string& out, uint64_t v) {
+    char buf[24];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, static_cast<size_t>(r.ptr - buf));
+}
+
+static void appendLabelValue(std::string& out, std::string_view v) {
+    for (char c : v) {
+        if      (c == '\\') out += "\\\\";
+        else if (c == '"')  out += "\\\"";
+        else if (c == '\n') out += "\\n";
+        else                out += c;
+    }
+}
+
+// "# TYPE name type" / "# HELP name help"
+static void family(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += "\n# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += '\n';
+}
+
+template <typename V>
+static void sample(std::string& out, const char* name, const char* suffix,
+                   std::initializer_list<Label> labels, V value) {
+    out += name;
+    out += suffix;
+    if (labels.size()) {
+        out += '{';
+        bool first = true;
+        for (const auto& l : labels) {
+            if (!first) out += ',';
+            first = false;
+            out += l.name;
+            out += "=\"";
+            appendLabelValue(out, l.value);
+            out += '"';
+        }
+        out += '}';
+    }
+    out += ' ';
+    appendNumber(out, value);
+    out += '\n';
+}
+
+template <typename V>
+static void gauge(std::string& out, const char* name, std::initializer_list<Label> labels, V value) {
+    sample(out, name, "", labels, value);
+}
+
+template <typename V>
+static void counter(std::string& out, const char* name, std::initializer_list<Label> labels, V value) {
+    sample(out, name, "_total", labels, value);
+}
+
+static constexpr double kKb = 1024.0;
+
+// Quantile samples plus _sum and _count of a latency histogram, in seconds;
+// `label` is left out when its name is null.
+static void summary(std::string& out, const char* name, Label label, const LatencyHistogram& h) {
+    LatencyHistogram::Summary s = h.summary();
+    const char* const quantiles[] = {"0.5", "0.9", "0.99"};
+    const uint64_t    values[]    = {s.p50_ns, s.p90_ns, s.p99_ns};
+    for (int i = 0; i < 3; ++i) {
+        if (label.name) sample(out, name, "", {label, {"quantile", quantiles[i]}}, values[i] / 1e9);
+        else            sample(out, name, "", {{"quantile", quantiles[i]}}, values[i] / 1e9);
+    }
+    if (label.name) {
+        sample(out, name, "_sum",   {label}, s.sum_ns / 1e9);
+        sample(out, name, "_count", {label}, s.count);
+    } else {
+        sample(out, name, "_sum",   {}, s.sum_ns / 1e9);
+        sample(out, name, "_count", {}, s.count);
+    }
+}
+
+// Cumulative _bucket samples plus _sum and _count of an eBPF latency
+// histogram, in seconds.  Bucket i ends at 2^(i+1) us; the last one is +Inf.
+static void histogram(std::string& out, const char* name, Label label, const LatencyDistribution& l) {
+    uint64_t    cumulative = 0;
+    std::string le;
+    for (int i = 0; i < kLatencyBuckets; ++i) {
+        cumulative += l.buckets[i];
+        le.clear();
+        if (i + 1 < kLatencyBuckets) appendNumber(le, std::ldexp(1e-6, i + 1));
+        else                         le = "+Inf";
+        sample(out, name, "_bucket", {label, {"le", le}}, cumulative);
+    }
+    sample(out, name, "_sum",   {label}, l.sum_us / 1e6);
+    sample(out, name, "_count", {label}, cumulative);
+}
+
+// The monitor's own cost, from selfMetrics()
+static void renderSelf(std::string& out) {
+    SelfMetrics& self = selfMetrics();
+    SelfMetrics::ProcessStats p = self.process();
+    family(out, "serverhealth_process_cpu_seconds", "counter", "CPU time used by the monitor.");
+    counter(out, "serverhealth_process_cpu_seconds", {{"mode", "user"}},   p.cpu_user_seconds);
+    counter(out, "serverhealth_process_cpu_seconds", {{"mode", "system"}}, p.cpu_system_seconds);
+    family(out, "serverhealth_process_cpu_percent", "gauge", "CPU used by the monitor over the last 10 s, in percent of one core.");
+    gauge(out, "serverhealth_process_cpu_percent", {}, p.cpu_percent);
+    family(out, "serverhealth_process_resident_memory_bytes", "gauge", "Resident set size of the monitor.");
+    gauge(out, "serverhealth_process_resident_memory_bytes", {}, p.rss_bytes);
+
+    family(out, "serverhealth_source_duration_seconds", "summary", "Wall time of one run of a collector.");
+    for (int i = 0; i < kMetricGroupCount; ++i)
+        summary(out, "serverhealth_source_duration_seconds", {"group", metricGroupName(i)}, self.source(i).wall);
+    family(out, "serverhealth_source_syscalls", "counter", "Syscalls made by a collector.");
+    for (int i = 0; i < kMetricGroupCount; ++i)
+        counter(out, "serverhealth_source_syscalls", {{"group", metricGroupName(i)}},
+                self.source(i).syscalls.load(std::memory_order_relaxed));
+    family(out, "serverhealth_source_read_bytes", "counter", "Bytes read by a collector.");
+    for (int i = 0; i < kMetricGroupCount; ++i)
+        counter(out, "serverhealth_source_read_bytes", {{"group", metricGroupName(i)}},
+                self.source(i).bytes_read.load(std::memory_order_relaxed));
+
+    family(out, "serverhealth_publish_duration_seconds", "summary", "Time to render and publish one snapshot.");
+    summary(out, "serverhealth_publish_duration_seconds", {nullptr, {}}, self.publish());
+    family(out, "serverhealth_http_request_duration_seconds", "summary", "HTTP request latency, from routing to the last byte written.");
+    self.forEachRoute([&out](const std::string& route, const LatencyHistogram& h) {
+        summary(out, "serverhealth_http_request_duration_seconds", {"route", route}, h);
+    });
+}
+
+// ---------------------------------------------------------------------------
+// exposition
+// ---------------------------------------------------------------------------
+
+void renderOpenMetrics(const HealthData& d, uint64_t sequence, std::string& out) {
+    out.clear();
+
+    family(out, "serverhealth_sample_timestamp_seconds", "gauge", "Unix time the sample was collected.");
+    gauge(out, "serverhealth_sample_timestamp_seconds", {}, static_cast<uint64_t>(d.timestamp));
+    family(out, "serverhealth_sample_sequence", "gauge", "Sequence number of the sample.");
+    gauge(out, "serverhealth_sample_sequence", {}, sequence);
+
+    // CPU
+    if (d.groups & kGroupCpu) {
+        const CpuInfo& cpu = d.cpu;
+        family(out, "serverhealth_cpu_usage_percent", "gauge", "CPU busy time since the previous sample.");
+        gauge(out, "serverhealth_cpu_usage_percent", {}, static_cast<double>(cpu.usage_percent));
+        family(out, "serverhealth_cpu_mode_percent", "gauge", "CPU time per mode since the previous sample.");
+        gauge(out, "serverhealth_cpu_mode_percent", {{"mode", "idle"}},    static_cast<double>(cpu.idle_percent));
+        gauge(out, "serverhealth_cpu_mode_percent", {{"mode", "user"}},    static_cast<double>(cpu.user_percent));
+        gauge(out, "serverhealth_cpu_mode_percent", {{"mode", "system"}},  static_cast<double>(cpu.system_percent));
+        gauge(out, "serverhealth_cpu_mode_percent", {{"mode", "iowait"}},  static_cast<double>(cpu.iowait_percent));
+        gauge(out, "serverhealth_cpu_mode_percent", {{"mode", "irq"}},     static_cast<double>(cpu.irq_percent));
+        gauge(out, "serverhealth_cpu_mode_percent", {{"mode", "softirq"}}, static_cast<double>(cpu.softirq_percent));
+        gauge(out, "serverhealth_cpu_mode_percent", {{"mode", "steal"}},   static_cast<double>(cpu.steal_percent));
+
+        char id[12];
+        auto coreId = [&id](int n) {
+            auto r = std::to_chars(id, id + sizeof(id), n);
+            return std::string_view(id, static_cast<size_t>(r.ptr - id));
+        };
+        family(out, "serverhealth_cpu_core_usage_percent", "gauge", "Per-core busy time since the previous sample.");
+        for (const auto& c : cpu.cores)
+            gauge(out, "serverhealth_cpu_core_usage_percent", {{"cpu", coreId(c.id)}}, static_cast<double>(c.usage_percent));
+        family(out, "serverhealth_cpu_core_mode_percent", "gauge", "Per-core time per mode since the previous sample.");
+        for (const auto& c : cpu.cores) {
+            std::string_view n = coreId(c.id);
+            gauge(out, "serverhealth_cpu_core_mode_percent", {{"cpu", n}, {"mode", "user"}},    static_cast<double>(c.user_percent));
+            gauge(out, "serverhealth_cpu_core_mode_percent", {{"cpu", n}, {"mode", "system"}},  static_cast<double>(c.system_percent));
+            gauge(out, "serverhealth_cpu_core_mode_percent", {{"cpu", n}, {"mode", "iowait"}},  static_cast<double>(c.iowait_percent));
+            gauge(out, "serverhealth_cpu_core_mode_percent", {{"cpu", n}, {"mode", "irq"}},     static_cast<double>(c.irq_percent));
+            gauge(out, "serverhealth_cpu_core_mode_percent", {{"cpu", n}, {"mode", "softirq"}}, static_cast<double>(c.softirq_percent));
+            gauge(out, "serverhealth_cpu_core_mode_percent", {{"cpu", n}, {"mode", "steal"}},   static_cast<double>(c.steal_percent));
+        }
+    }
+
+    // Memory
+    if (d.groups & kGroupMemory) {
+        const MemoryInfo& mem = d.memory;
+        family(out, "serverhealth_memory_total_bytes", "gauge", "Total usable memory.");
+        gauge(out, "serverhealth_memory_total_bytes", {}, mem.total_kb * kKb);
+        family(out, "serverhealth_memory_used_bytes", "gauge", "Memory not free (total - free).");
+        gauge(out, "serverhealth_memory_used_bytes", {}, mem.used_kb * kKb);
+        family(out, "serverhealth_memory_free_bytes", "gauge", "Completely unused memory.");
+        gauge(out, "serverhealth_memory_free_bytes", {}, mem.free_kb * kKb);
+        family(out, "serverhealth_memory_available_bytes", "gauge", "Memory available for new allocations without swapping.");
+        gauge(out, "serverhealth_memory_available_bytes", {}, mem.available_kb * kKb);
+        family(out, "serverhealth_memory_usage_percent", "gauge", "Share of memory that is not available.");
+        gauge(out, "serverhealth_memory_usage_percent", {}, static_cast<double>(mem.usage_percent));
+        family(out, "serverhealth_memory_buffers_bytes", "gauge", "Memory used for block device buffers.");
+        gauge(out, "serverhealth_memory_buffers_bytes", {}, mem.buffers_kb * kKb);
+        family(out, "serverhealth_memory_cached_bytes", "gauge", "Memory used by the page cache.");
+        gauge(out, "serverhealth_memory_cached_bytes", {}, mem.cached_kb * kKb);
+        family(out, "serverhealth_memory_dirty_bytes", "gauge", "Page cache waiting to be written back.");
+        gauge(out, "serverhealth_memory_dirty_bytes", {}, mem.dirty_kb * kKb);
+        family(out, "serverhealth_memory_writeback_bytes", "gauge", "Page cache being written back.");
+        gauge(out, "serverhealth_memory_writeback_bytes", {}, mem.writeback_kb * kKb);
+        family(out, "serverhealth_swap_total_bytes", "gauge", "Total swap space.");
+        gauge(out, "serverhealth_swap_total_bytes", {}, mem.swap_total_kb * kKb);
+        family(out, "serverhealth_swap_used_bytes", "gauge", "Swap space in use.");
+        gauge(out, "serverhealth_swap_used_bytes", {}, mem.swap_used_kb * kKb);
+        family(out, "serverhealth_memory_page_faults_per_second", "gauge", "Page faults per second over the last sample interval.");
+        gauge(out, "serverhealth_memory_page_faults_per_second", {{"kind", "all"}},   mem.page_faults_per_sec);
+        gauge(out, "serverhealth_memory_page_faults_per_second", {{"kind", "major"}}, mem.major_faults_per_sec);
+        family(out, "serverhealth_swap_pages_per_second", "gauge", "Pages swapped in and out per second over the last sample interval.");
+        gauge(out, "serverhealth_swap_pages_per_second", {{"direction", "in"}},  mem.swap_in_per_sec);
+        gauge(out, "serverhealth_swap_pages_per_second", {{"direction", "out"}}, mem.swap_out_per_sec);
+        family(out, "serverhealth_oom_kills", "counter", "Processes killed by the OOM killer since boot.");
+        counter(out, "serverhealth_oom_kills", {}, mem.oom_kills);
+    }
+
+    // Disk space
+    if (d.groups & kGroupDisks) {
+        family(out, "serverhealth_filesystem_size_bytes", "gauge", "Filesystem size.");
+        for (const auto& fs : d.disks)
+            gauge(out, "serverhealth_filesystem_size_bytes", {{"mountpoint", fs.path}}, fs.total_kb * kKb);
+        family(out, "serverhealth_filesystem_used_bytes", "gauge", "Filesystem space in use.");
+        for (const auto& fs : d.disks)
+            gauge(out, "serverhealth_filesystem_used_bytes", {{"mountpoint", fs.path}}, fs.used_kb * kKb);
+        family(out, "serverhealth_filesystem_free_bytes", "gauge", "Filesystem free space.");
+        for (const auto& fs : d.disks)
+            gauge(out, "serverhealth_filesystem_free_bytes", {{"mountpoint", fs.path}}, fs.free_kb * kKb);
+        family(out, "serverhealth_filesystem_usage_percent", "gauge", "Share of the filesystem in use.");
+        for (const auto& fs : d.disks)
+            gauge(out, "serverhealth_filesystem_usage_percent", {{"mountpoint", fs.path}}, static_cast<double>(fs.usage_percent));
+        family(out, "serverhealth_filesystem_files", "gauge", "Filesystem inodes (0 where the filesystem has no fixed inode table).");
+        for (const auto& fs : d.disks)
+            gauge(out, "serverhealth_filesystem_files", {{"mountpoint", fs.path}}, fs.inodes_total);
+        family(out, "serverhealth_filesystem_files_free", "gauge", "Filesystem free inodes.");
+        for (const auto& fs : d.disks)
+            gauge(out, "serverhealth_filesystem_files_free", {{"mountpoint", fs.path}}, fs.inodes_free);
+        family(out, "serverhealth_filesystem_stale", "gauge", "1 if statvfs() missed its deadline and the figures are the last good ones.");
+        for (const auto& fs : d.disks)
+            gauge(out, "serverhealth_filesystem_stale", {{"mountpoint", fs.path}}, uint64_t{fs.stale ? 1u : 0u});
+    }
+
+    // Network
+    if (d.groups & kGroupNetwork) {
+        family(out, "serverhealth_network_receive_bytes", "counter", "Bytes received.");
+        for (const auto& n : d.network) counter(out, "serverhealth_network_receive_bytes", {{"interface", n.name}}, n.rx_bytes);
+        family(out, "serverhealth_network_transmit_bytes", "counter", "Bytes transmitted.");
+        for (const auto& n : d.network) counter(out, "serverhealth_network_transmit_bytes", {{"interface", n.name}}, n.tx_bytes);
+        family(out, "serverhealth_network_receive_packets", "counter", "Packets received.");
+        for (const auto& n : d.network) counter(out, "serverhealth_network_receive_packets", {{"interface", n.name}}, n.rx_packets);
+        family(out, "serverhealth_network_transmit_packets", "counter", "Packets transmitted.");
+        for (const auto& n : d.network) counter(out, "serverhealth_network_transmit_packets", {{"interface", n.name}}, n.tx_packets);
+        family(out, "serverhealth_network_receive_errors", "counter", "Receive errors.");
+        for (const auto& n : d.network) counter(out, "serverhealth_network_receive_errors", {{"interface", n.name}}, n.rx_errors);
+        family(out, "serverhealth_network_transmit_errors", "counter", "Transmit errors.");
+        for (const auto& n : d.network) counter(out, "serverhealth_network_transmit_errors", {{"interface", n.name}}, n.tx_errors);
+        family(out, "serverhealth_network_receive_drops", "counter", "Received packets dropped.");
+        for (const auto& n : d.network) counter(out, "serverhealth_network_receive_drops", {{"interface", n.name}}, n.rx_dropped);
+        family(out, "serverhealth_network_transmit_drops", "counter", "Packets dropped on transmit.");
+        for (const auto& n : d.network) counter(out, "serverhealth_network_transmit_drops", {{"interface", n.name}}, n.tx_dropped);
+        family(out, "serverhealth_network_up", "gauge", "1 if the interface's operstate is up (only with the netlink backend).");
+        for (const auto& n : d.network)
+            if (!n.state.empty()) gauge(out, "serverhealth_network_up", {{"interface", n.name}}, uint64_t{n.state == "up" ? 1u : 0u});
+        family(out, "serverhealth_network_speed_bytes", "gauge", "Link speed in bytes per second (0 if unknown).");
+        for (const auto& n : d.network)
+            gauge(out, "serverhealth_network_speed_bytes", {{"interface", n.name}}, static_cast<uint64_t>(n.speed_mbps) * 125000u);
+        family(out, "serverhealth_network_receive_bytes_per_second", "gauge", "Receive rate since the previous sample.");
+        for (const auto& n : d.network) gauge(out, "serverhealth_network_receive_bytes_per_second", {{"interface", n.name}}, n.rx_bytes_per_sec);
+        family(out, "serverhealth_network_transmit_bytes_per_second", "gauge", "Transmit rate since the previous sample.");
+        for (const auto& n : d.network) gauge(out, "serverhealth_network_transmit_bytes_per_second", {{"interface", n.name}}, n.tx_bytes_per_sec);
+        family(out, "serverhealth_network_receive_packets_per_second", "gauge", "Packets received per second since the previous sample.");
+        for (const auto& n : d.network) gauge(out, "serverhealth_network_receive_packets_per_second", {{"interface", n.name}}, n.rx_packets_per_sec);
+        family(out, "serverhealth_network_transmit_packets_per_second", "gauge", "Packets transmitted per second since the previous sample.");
+        for (const auto& n : d.network) gauge(out, "serverhealth_network_transmit_packets_per_second", {{"interface", n.name}}, n.tx_packets_per_sec);
+    }
+
+    // Disk I/O
+    if (d.groups & kGroupDiskIO) {
+        family(out, "serverhealth_disk_reads_completed", "counter", "Reads completed.");
+        for (const auto& io : d.disk_io) counter(out, "serverhealth_disk_reads_completed", {{"device", io.name}}, io.reads_completed);
+        family(out, "serverhealth_disk_writes_completed", "counter", "Writes completed.");
+        for (const auto& io : d.disk_io) counter(out, "serverhealth_disk_writes_completed", {{"device", io.name}}, io.writes_completed);
+        family(out, "serverhealth_disk_read_bytes", "counter", "Bytes read.");
+        for (const auto& io : d.disk_io) counter(out, "serverhealth_disk_read_bytes", {{"device", io.name}}, io.read_sectors * 512);
+        family(out, "serverhealth_disk_written_bytes", "counter", "Bytes written.");
+        for (const auto& io : d.disk_io) counter(out, "serverhealth_disk_written_bytes", {{"device", io.name}}, io.write_sectors * 512);
+        family(out, "serverhealth_disk_read_time_seconds", "counter", "Time spent on reads.");
+        for (const auto& io : d.disk_io) counter(out, "serverhealth_disk_read_time_seconds", {{"device", io.name}}, io.ms_reading / 1000.0);
+        family(out, "serverhealth_disk_write_time_seconds", "counter", "Time spent on writes.");
+        for (const auto& io : d.disk_io) counter(out, "serverhealth_disk_write_time_seconds", {{"device", io.name}}, io.ms_writing / 1000.0);
+        family(out, "serverhealth_disk_io_time_seconds", "counter", "Time the device had I/O in flight.");
+        for (const auto& io : d.disk_io) counter(out, "serverhealth_disk_io_time_seconds", {{"device", io.name}}, io.ms_io / 1000.0);
+        family(out, "serverhealth_disk_io_time_weighted_seconds", "counter", "I/O time weighted by the number of requests in flight.");
+        for (const auto& io : d.disk_io) counter(out, "serverhealth_disk_io_time_weighted_seconds", {{"device", io.name}}, io.weighted_ms_io / 1000.0);
+        family(out, "serverhealth_disk_io_in_flight", "gauge", "Requests currently in flight.");
+        for (const auto& io : d.disk_io) gauge(out, "serverhealth_disk_io_in_flight", {{"device", io.name}}, io.ios_in_progress);
+        family(out, "serverhealth_disk_reads_per_second", "gauge", "Read IOPS since the previous sample.");
+        for (const auto& io : d.disk_io) gauge(out, "serverhealth_disk_reads_per_second", {{"device", io.name}}, io.reads_per_sec);
+        family(out, "serverhealth_disk_writes_per_second", "gauge", "Write IOPS since the previous sample.");
+        for (const auto& io : d.disk_io) gauge(out, "serverhealth_disk_writes_per_second", {{"device", io.name}}, io.writes_per_sec);
+        family(out, "serverhealth_disk_read_bytes_per_second", "gauge", "Read throughput since the previous sample.");
+        for (const auto& io : d.disk_io) gauge(out, "serverhealth_disk_read_bytes_per_second", {{"device", io.name}}, io.read_bytes_per_sec);
+        family(out, "serverhealth_disk_write_bytes_per_second", "gauge", "Write throughput since the previous sample.");
+        for (const auto& io : d.disk_io) gauge(out, "serverhealth_disk_write_bytes_per_second", {{"device", io.name}}, io.write_bytes_per_sec);
+        family(out, "serverhealth_disk_read_latency_seconds", "gauge", "Average time per completed read since the previous sample.");
+        for (const auto& io : d.disk_io) gauge(out, "serverhealth_disk_read_latency_seconds", {{"device", io.name}}, io.read_latency_ms / 1000.0);
+        family(out, "serverhealth_disk_write_latency_seconds", "gauge", "Average time per completed write since the previous sample.");
+        for (const auto& io : d.disk_io) gauge(out, "serverhealth_disk_write_latency_seconds", {{"device", io.name}}, io.write_latency_ms / 1000.0);
+        family(out, "serverhealth_disk_queue_depth", "gauge", "Average requests in flight since the previous sample.");
+        for (const auto& io : d.disk_io) gauge(out, "serverhealth_disk_queue_depth", {{"device", io.name}}, io.queue_depth);
+        family(out, "serverhealth_disk_utilization_percent", "gauge", "Share of time the device was busy since the previous sample.");
+        for (const auto& io : d.disk_io) gauge(out, "serverhealth_disk_utilization_percent", {{"device", io.name}}, io.util_percent);
+    }
+
+    // Temperature
+    if (d.groups & kGroupTemperature) {
+        family(out, "serverhealth_temperature_celsius", "gauge", "Thermal zone temperature.");
+        for (const auto& t : d.temperature)
+            gauge(out, "serverhealth_temperature_celsius", {{"zone", t.name}}, static_cast<double>(t.temperature_celsius));
+    }
+
+    // Docker
+    if (d.groups & kGroupDocker) {
+        // no status label: Docker's "Up 5 minutes" text would start a new
+        // series every minute
+        family(out, "serverhealth_docker_container", "info", "Running container.");
+        for (const auto& c : d.docker)
+            sample(out, "serverhealth_docker_container", "_info",
+                   {{"id", c.id}, {"name", c.names}, {"image", c.image}, {"state", c.state},
+                    {"health", c.health}},
+                   uint64_t{1});
+        family(out, "serverhealth_docker_containers", "gauge", "Number of running containers.");
+        gauge(out, "serverhealth_docker_containers", {}, static_cast<uint64_t>(d.docker.size()));
+
+        // cgroup v2 resources, for the containers whose cgroup was found
+        auto each = [&](auto fn) {
+            for (const auto& c : d.docker)
+                if (c.resources.available) fn(c, c.resources);
+        };
+        family(out, "serverhealth_container_cpu_seconds", "counter", "CPU time used by the container.");
+        each([&](const DockerContainer& c, const ContainerStats& r) {
+            counter(out, "serverhealth_container_cpu_seconds", {{"id", c.id}, {"name", c.names}, {"mode", "user"}},   r.cpu_user_usec / 1e6);
+            counter(out, "serverhealth_container_cpu_seconds", {{"id", c.id}, {"name", c.names}, {"mode", "system"}}, r.cpu_system_usec / 1e6);
+        });
+        family(out, "serverhealth_container_cpu_throttled_seconds", "counter", "Time the container was throttled by its CPU quota.");
+        each([&](const DockerContainer& c, const ContainerStats& r) {
+            counter(out, "serverhealth_container_cpu_throttled_seconds", {{"id", c.id}, {"name", c.names}}, r.cpu_throttled_usec / 1e6);
+        });
+        family(out, "serverhealth_container_cpu_percent", "gauge", "CPU used since the previous sample, in percent of one core.");
+        each([&](const DockerContainer& c, const ContainerStats& r) {
+            gauge(out, "serverhealth_container_cpu_percent", {{"id", c.id}, {"name", c.names}}, r.cpu_percent);
+        });
+        family(out, "serverhealth_container_memory_bytes", "gauge", "Memory charged to the container (memory.current).");
+        each([&](const DockerContainer& c, const ContainerStats& r) {
+            gauge(out, "serverhealth_container_memory_bytes", {{"id", c.id}, {"name", c.names}}, r.memory_bytes);
+        });
+        family(out, "serverhealth_container_memory_anon_bytes", "gauge", "Anonymous memory of the container.");
+        each([&](const DockerContainer& c, const ContainerStats& r) {
+            gauge(out, "serverhealth_container_memory_anon_bytes", {{"id", c.id}, {"name", c.names}}, r.memory_anon_bytes);
+        });
+        family(out, "serverhealth_container_memory_file_bytes", "gauge", "Page cache charged to the container.");
+        each([&](const DockerContainer& c, const ContainerStats& r) {
+            gauge(out, "serverhealth_container_memory_file_bytes", {{"id", c.id}, {"name", c.names}}, r.memory_file_bytes);
+        });
+        family(out, "serverhealth_container_read_bytes", "counter", "Bytes read from block devices.");
+        each([&](const DockerContainer& c, const ContainerStats& r) {
+            counter(out, "serverhealth_container_read_bytes", {{"id", c.id}, {"name", c.names}}, r.io_read_bytes);
+        });
+        family(out, "serverhealth_container_written_bytes", "counter", "Bytes written to block devices.");
+        each([&](const DockerContainer& c, const ContainerStats& r) {
+            counter(out, "serverhealth_container_written_bytes", {{"id", c.id}, {"name", c.names}}, r.io_write_bytes);
+        });
+        family(out, "serverhealth_container_reads", "counter", "Block device reads.");
+        each([&](const DockerContainer& c, const ContainerStats& r) {
+            counter(out, "serverhealth_container_reads", {{"id", c.id}, {"name", c.names}}, r.io_read_ops);
+        });
+        family(out, "serverhealth_container_writes", "counter", "Block device writes.");
+        each([&](const DockerContainer& c, const ContainerStats& r) {
+            counter(out, "serverhealth_container_writes", {{"id", c.id}, {"name", c.names}}, r.io_write_ops);
+        });
+    }
+
+    // Top processes: only the top-N table, so the label set stays bounded
+    if (d.groups & kGroupProcesses) {
+        family(out, "serverhealth_top_process_cpu_percent", "gauge", "CPU of a top process, in percent of one core.");
+        for (const auto& p : d.processes)
+            gauge(out, "serverhealth_top_process_cpu_percent", {{"pid", p.key}, {"name", p.name}}, p.cpu_percent);
+        family(out, "serverhealth_top_process_resident_memory_bytes", "gauge", "Resident set size of a top process.");
+        for (const auto& p : d.processes)
+            gauge(out, "serverhealth_top_process_resident_memory_bytes", {{"pid", p.key}, {"name", p.name}}, p.rss_bytes);
+        family(out, "serverhealth_top_process_io_bytes_per_second", "gauge", "Storage I/O of a top process.");
+        for (const auto& p : d.processes) {
+            gauge(out, "serverhealth_top_process_io_bytes_per_second", {{"pid", p.key}, {"name", p.name}, {"direction", "read"}},  p.io_read_bytes_per_sec);
+            gauge(out, "serverhealth_top_process_io_bytes_per_second", {{"pid", p.key}, {"name", p.name}, {"direction", "write"}}, p.io_write_bytes_per_sec);
+        }
+    }
+
+    // Internet speed
+    if (d.groups & kGroupSpeed) {
+        const SpeedTestResult& speed = d.speed;
+        family(out, "serverhealth_internet_speed_available", "gauge", "Whether a speed test result is available.");
+        gauge(out, "serverhealth_internet_speed_available", {}, uint64_t{speed.available ? 1u : 0u});
+        family(out, "serverhealth_internet_speed_stale", "gauge", "1 if the last speed test failed and the figures are from an earlier one.");
+        gauge(out, "serverhealth_internet_speed_stale", {}, uint64_t{speed.stale ? 1u : 0u});
+        if (speed.available) {
+            family(out, "serverhealth_internet_download_mbps", "gauge", "Last measured download speed in Mbit/s.");
+            gauge(out, "serverhealth_internet_download_mbps", {}, static_cast<double>(speed.download_mbps));
+            family(out, "serverhealth_internet_upload_mbps", "gauge", "Last measured upload speed in Mbit/s.");
+            gauge(out, "serverhealth_internet_upload_mbps", {}, static_cast<double>(speed.upload_mbps));
+            family(out, "serverhealth_internet_latency_seconds", "gauge", "Median TCP connect time to the speed test server.");
+            gauge(out, "serverhealth_internet_latency_seconds", {}, static_cast<double>(speed.latency_ms) / 1000.0);
+            family(out, "serverhealth_internet_jitter_seconds", "gauge", "Mean difference between consecutive connect times.");
+            gauge(out, "serverhealth_internet_jitter_seconds", {}, static_cast<double>(speed.jitter_ms) / 1000.0);
+            family(out, "serverhealth_internet_speed_test_bytes", "gauge", "Payload moved by the last speed test.");
+            gauge(out, "serverhealth_internet_speed_test_bytes", {}, speed.bytes_used);
+        }
+    }
+
+    // Pressure stall information
+    if ((d.groups & kGroupPressure) && d.pressure.available) {
+        const std::pair<const char*, const PressureResource*> resources[] = {
+            {"cpu", &d.pressure.cpu}, {"memory", &d.pressure.memory}, {"io", &d.pressure.io},
+        };
+        family(out, "serverhealth_pressure_percent", "gauge", "Share of time tasks were stalled on the resource (PSI), by averaging window.");
+        for (const auto& r : resources)
+            for (int full = 0; full < 2; ++full) {
+                const PressureLine& l    = full ? r.second->full : r.second->some;
+                const char*         kind = full ? "full" : "some";
+                gauge(out, "serverhealth_pressure_percent", {{"resource", r.first}, {"kind", kind}, {"window", "10s"}},  static_cast<double>(l.avg10));
+                gauge(out, "serverhealth_pressure_percent", {{"resource", r.first}, {"kind", kind}, {"window", "60s"}},  static_cast<double>(l.avg60));
+                gauge(out, "serverhealth_pressure_percent", {{"resource", r.first}, {"kind", kind}, {"window", "300s"}}, static_cast<double>(l.avg300));
+            }
+        family(out, "serverhealth_pressure_stalled_seconds", "counter", "Total time tasks were stalled on the resource (PSI).");
+        for (const auto& r : resources) {
+            counter(out, "serverhealth_pressure_stalled_seconds", {{"resource", r.first}, {"kind", "some"}}, r.second->some.total_usec / 1e6);
+            counter(out, "serverhealth_pressure_stalled_seconds", {{"resource", r.first}, {"kind", "full"}}, r.second->full.total_usec / 1e6);
+        }
+    }
+
+    // Kernel latency (eBPF)
+    if ((d.groups & kGroupLatency) && d.latency.available) {
+        const KernelLatency& k = d.latency;
+        family(out, "serverhealth_block_io_latency_seconds", "histogram", "Block requests from issue to completion.");
+        for (const auto& dev : k.block)
+            histogram(out, "serverhealth_block_io_latency_seconds", {"device", dev.name}, dev.io);
+        family(out, "serverhealth_runqueue_latency_seconds", "histogram", "Time runnable tasks waited for a CPU after wakeup.");
+        for (const auto& c : k.cpus)
+            histogram(out, "serverhealth_runqueue_latency_seconds", {"cpu", std::to_string(c.cpu)}, c.runq);
+        family(out, "serverhealth_container_runqueue_latency_seconds", "gauge", "Run-queue latency of a container since the previous sample, by quantile.");
+        for (const auto& c : k.containers) {
+            gauge(out, "serverhealth_container_runqueue_latency_seconds", {{"name", c.name}, {"quantile", "0.5"}},  c.runq.p50_us / 1e6);
+            gauge(out, "serverhealth_container_runqueue_latency_seconds", {{"name", c.name}, {"quantile", "0.99"}}, c.runq.p99_us / 1e6);
+        }
+        family(out, "serverhealth_tcp_retransmits", "counter", "TCP segments retransmitted since the eBPF programs were loaded.");
+        counter(out, "serverhealth_tcp_retransmits", {}, k.tcp_retransmits);
+    }
+
+    renderSelf(out);
+    out += "# EOF\n";
+}
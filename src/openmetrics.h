@@ -0,0 +1,14 @@
+#pragma once
+
+#include "health_collector.h"
+
+#include <cstdint>
+#include <string>
+
+// Render `data` in the OpenMetrics text format (terminated by "# EOF").
+// `out` is cleared first but keeps its capacity, so the sampler can render
+// into the buffer of a retired snapshot without allocating.
+//
+// Sizes are exported in bytes and times in seconds; cumulative kernel
+// counters are OpenMetrics counters (`_total`), everything else a gauge.
+void renderOpenMetrics(const HealthData& data, uint64_t sequence, std::string& out);
@@ -0,0 +1,95 @@
+#include "prepared_body.h"
+
+#include <cstdint>
+
+#ifdef SERVERHEALTH_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// gzip
+// ---------------------------------------------------------------------------
+
+#ifdef SERVERHEALTH_HAVE_ZLIB
+
+struct GzipEncoder::State {
+    z_stream zs{};
+    bool     ok = false;
+};
+
+GzipEncoder::GzipEncoder(int level) : state_(new State) {
+    // windowBits 15 + 16 selects the gzip wrapper instead of raw zlib
+    state_->ok = deflateInit2(&state_->zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+GzipEncoder::~GzipEncoder() {
+    if (state_->ok) deflateEnd(&state_->zs);
+    delete state_;
+}
+
+bool GzipEncoder::encode(std::string_view in, std::string& out) {
+    out.clear();
+    if (!state_->ok) return false;
+    z_stream& zs = state_->zs;
+    if (deflateReset(&zs) != Z_OK) return false;
+
+    out.resize(deflateBound(&zs, static_cast<uLong>(in.size())));
+    zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in  = static_cast<uInt>(in.size());
+    zs.next_out  = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+    // deflateBound guarantees a single Z_FINISH call completes
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+        out.clear();
+        return false;
+    }
+    out.resize(zs.total_out);
+    return true;
+}
+
+#else
+
+struct GzipEncoder::State {};
+
+GzipEncoder::GzipEncoder(int) {}
+GzipEncoder::~GzipEncoder() = default;
+
+bool GzipEncoder::encode(std::string_view, std::string& out) {
+    out.clear();
+    return false;
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// validators  –  FNV-1a of the uncompressed text
+// ---------------------------------------------------------------------------
+
+static uint64_t fnv1a(std::string_view s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void formatEtag(std::string& out, uint64_t h, const char* suffix) {
+    static const char kHex[] = "0123456789abcdef";
+    out.assign(1, '"');
+    for (int shift = 60; shift >= 0; shift -= 4) out += kHex[(h >> shift) & 0xF];
+    out += suffix;
+    out += '"';
+}
+
+void prepareBody(PreparedBody& body, GzipEncoder& gzip) {
+    uint64_t h = fnv1a(body.text);
+    formatEtag(body.etag, h, "");
+    // only worth sending compressed if it actually got smaller
+    if (gzip.encode(body.text, body.gzip) && body.gzip.size() < body.text.size())
+        formatEtag(body.gzip_etag, h, "-gz");
+    else {
+        body.gzip.clear();
+        body.gzip_etag.clear();
+    }
+}
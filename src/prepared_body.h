@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// A response body rendered ahead of time, together with its gzip encoding
+// and strong validators for both representations.  Handlers only pick one
+// and stream it; nothing is compressed or hashed per request.
+struct PreparedBody {
+    std::string text;
+    std::string gzip;        // empty when zlib is unavailable
+    std::string etag;        // quoted, e.g. "9f86d081884c7d65"
+    std::string gzip_etag;   // a different entity, so a different tag
+};
+
+// Reusable gzip compressor.  The deflate state (a few hundred KB) is
+// allocated once and reset between bodies.
+class GzipEncoder {
+public:
+    explicit GzipEncoder(int level = 6);
+    ~GzipEncoder();
+
+    GzipEncoder(const GzipEncoder&)            = delete;
+    GzipEncoder& operator=(const GzipEncoder&) = delete;
+
+    // Compress `in` into `out` (capacity reused).  Returns false, leaving
+    // `out` empty, when zlib support is not compiled in or deflate fails.
+    bool encode(std::string_view in, std::string& out);
+
+private:
+    struct State;
+    State* state_ = nullptr;
+};
+
+// Fill body.gzip and both ETags from body.text.
+void prepareBody(PreparedBody& body, GzipEncoder& gzip);
@@ -0,0 +1,454 @@
+#include "proc_parsers.h"
+
+#include <iterator>
+#include <utility>
+
+// ---------------------------------------------------------------------------
+// scanning helpers  –  operate on [p, end) and advance p
+// ---------------------------------------------------------------------------
+
+static inline void skipSpaces(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+}
+
+static inline void skipLine(const char*& p, const char* end) {
+    while (p < end && *p != '\n') ++p;
+    if (p < end) ++p;
+}
+
+static inline std::string_view nextToken(const char*& p, const char* end) {
+    skipSpaces(p, end);
+    const char* start = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\n') ++p;
+    return std::string_view(start, static_cast<size_t>(p - start));
+}
+
+static inline uint64_t parseU64(const char*& p, const char* end) {
+    skipSpaces(p, end);
+    uint64_t v = 0;
+    while (p < end && static_cast<unsigned>(*p - '0') < 10u) {
+        v = v * 10 + static_cast<uint64_t>(*p - '0');
+        ++p;
+    }
+    return v;
+}
+
+// Fixed-point decimal such as the "0.84" of a PSI average
+static inline float parseDecimal(const char*& p, const char* end) {
+    uint64_t whole = parseU64(p, end), frac = 0, scale = 1;
+    if (p < end && *p == '.')
+        for (++p; p < end && static_cast<unsigned>(*p - '0') < 10u && scale < 1000000000u; ++p, scale *= 10)
+            frac = frac * 10 + static_cast<uint64_t>(*p - '0');
+    return static_cast<float>(whole + static_cast<double>(frac) / scale);
+}
+
+// ---------------------------------------------------------------------------
+// key tables  –  constexpr perfect hash over the keys a parser wants
+//
+// /proc/meminfo and /proc/vmstat are "key value" lines of which a parser
+// needs a handful (vmstat has well over a hundred).  Each line's key is
+// hashed once and compared with the one key that can be in its slot,
+// instead of with every wanted key in turn.  The seed is searched at
+// compile time until no two keys share a slot.
+// ---------------------------------------------------------------------------
+
+static constexpr uint32_t keyHash(std::string_view s, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;   // FNV-1a
+    for (char c : s) h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    return h;
+}
+
+template <size_t N, size_t Slots>
+struct KeyTable {
+    static_assert((Slots & (Slots - 1)) == 0, "Slots must be a power of two");
+
+    std::string_view keys[N];
+    int8_t           slot[Slots] = {};
+    uint32_t         seed    = 0;
+    bool             perfect = false;
+
+    // Index of `key` in the list the table was made from, or -1
+    constexpr int find(std::string_view key) const {
+        int i = slot[keyHash(key, seed) & (Slots - 1)];
+        return i >= 0 && keys[i] == key ? i : -1;
+    }
+};
+
+template <size_t Slots, size_t N>
+static constexpr KeyTable<N, Slots> makeKeyTable(const std::string_view (&keys)[N]) {
+    KeyTable<N, Slots> t{};
+    for (size_t i = 0; i < N; ++i) t.keys[i] = keys[i];
+    for (uint32_t seed = 0; seed < 4096 && !t.perfect; ++seed) {
+        for (auto& s : t.slot) s = -1;
+        t.seed    = seed;
+        t.perfect = true;
+        for (size_t i = 0; i < N && t.perfect; ++i) {
+            int8_t& s = t.slot[keyHash(keys[i], seed) & (Slots - 1)];
+            if (s >= 0) t.perfect = false;
+            else        s = static_cast<int8_t>(i);
+        }
+    }
+    return t;
+}
+
+// ---------------------------------------------------------------------------
+// /proc/stat
+// ---------------------------------------------------------------------------
+
+bool parseProcStat(std::string_view text, CpuTimes& total, std::vector<CpuTimes>& cores) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    bool   haveTotal = false;
+    size_t ncores    = 0;
+
+    // cpu lines always come first; stop at the first line that isn't one
+    while (end - p >= 3 && p[0] == 'c' && p[1] == 'p' && p[2] == 'u') {
+        p += 3;
+        CpuTimes* t;
+        if (p < end && *p == ' ') {
+            t = &total;
+            t->cpu = -1;
+            haveTotal = true;
+        } else {
+            if (ncores == cores.size()) cores.emplace_back();
+            t = &cores[ncores++];
+            t->cpu = static_cast<int>(parseU64(p, end));
+        }
+        t->user    = parseU64(p, end);
+        t->nice    = parseU64(p, end);
+        t->system  = parseU64(p, end);
+        t->idle    = parseU64(p, end);
+        t->iowait  = parseU64(p, end);
+        t->irq     = parseU64(p, end);
+        t->softirq = parseU64(p, end);
+        t->steal   = parseU64(p, end);
+        skipLine(p, end);
+    }
+    if (ncores != cores.size()) cores.resize(ncores);
+    return haveTotal;
+}
+
+// ---------------------------------------------------------------------------
+// /proc/meminfo
+// ---------------------------------------------------------------------------
+
+// In the order of the pointers parseMeminfo() stores through
+static constexpr std::string_view kMeminfoNames[] = {
+    "MemTotal:", "MemFree:", "MemAvailable:", "Buffers:", "Cached:",
+    "SwapTotal:", "SwapFree:", "Dirty:", "Writeback:",
+};
+static constexpr auto kMeminfoKeys = makeKeyTable<32>(kMeminfoNames);
+static_assert(kMeminfoKeys.perfect, "no collision-free seed for the meminfo keys");
+
+void parseMeminfo(std::string_view text, MemoryInfo& info) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    info = MemoryInfo{};
+    long* const fields[] = {
+        &info.total_kb,      &info.free_kb,      &info.available_kb, &info.buffers_kb, &info.cached_kb,
+        &info.swap_total_kb, &info.swap_free_kb, &info.dirty_kb,     &info.writeback_kb,
+    };
+    static_assert(std::size(fields) == std::size(kMeminfoNames));
+
+    // every key appears once: stop as soon as the last one was seen
+    size_t found = 0;
+    while (p < end && found < std::size(fields)) {
+        std::string_view key = nextToken(p, end);
+        int i = kMeminfoKeys.find(key);
+        if (i >= 0) {
+            *fields[i] = static_cast<long>(parseU64(p, end));
+            ++found;
+        }
+        skipLine(p, end);
+    }
+    info.used_kb      = info.total_kb - info.free_kb;
+    info.swap_used_kb = info.swap_total_kb - info.swap_free_kb;
+    if (info.total_kb > 0)
+        info.usage_percent = 100.0f * (info.total_kb - info.available_kb) / info.total_kb;
+}
+
+// ---------------------------------------------------------------------------
+// /proc/vmstat
+// ---------------------------------------------------------------------------
+
+static constexpr std::string_view kVmstatNames[] = {
+    "pgfault", "pgmajfault", "pswpin", "pswpout", "oom_kill",
+};
+static constexpr auto kVmstatKeys = makeKeyTable<16>(kVmstatNames);
+static_assert(kVmstatKeys.perfect, "no collision-free seed for the vmstat keys");
+
+void parseVmstat(std::string_view text, VmStat& out) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    out = VmStat{};
+    uint64_t* const fields[] = {&out.pgfault, &out.pgmajfault, &out.pswpin, &out.pswpout, &out.oom_kill};
+    static_assert(std::size(fields) == std::size(kVmstatNames));
+
+    size_t found = 0;
+    while (p < end && found < std::size(fields)) {
+        std::string_view key = nextToken(p, end);
+        int i = kVmstatKeys.find(key);
+        if (i >= 0) {
+            *fields[i] = parseU64(p, end);
+            ++found;
+        }
+        skipLine(p, end);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// /proc/pressure/*  –  "some avg10=0.31 avg60=0.84 avg300=0.95 total=72408969"
+// ---------------------------------------------------------------------------
+
+bool parsePressure(std::string_view text, PressureResource& out) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    out = PressureResource{};
+    bool some = false;
+    while (p < end) {
+        std::string_view kind = nextToken(p, end);
+        PressureLine* line = kind == "some" ? &out.some : kind == "full" ? &out.full : nullptr;
+        some |= line == &out.some;
+        while (line && p < end && *p != '\n') {
+            skipSpaces(p, end);
+            const char* k = p;
+            while (p < end && *p != '=' && *p != ' ' && *p != '\n') ++p;
+            std::string_view name(k, static_cast<size_t>(p - k));
+            if (p >= end || *p != '=') break;
+            ++p;
+            if      (name == "avg10")  line->avg10      = parseDecimal(p, end);
+            else if (name == "avg60")  line->avg60      = parseDecimal(p, end);
+            else if (name == "avg300") line->avg300     = parseDecimal(p, end);
+            else if (name == "total")  line->total_usec = parseU64(p, end);
+        }
+        skipLine(p, end);
+    }
+    return some;
+}
+
+// ---------------------------------------------------------------------------
+// /proc/net/dev
+// ---------------------------------------------------------------------------
+
+void parseNetDev(std::string_view text, std::vector<NetworkInterface>& out) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    out.clear();
+    skipLine(p, end);   // two header lines
+    skipLine(p, end);
+    while (p < end) {
+        // "  eth0: 123 ..."; large counters may follow the colon directly
+        skipSpaces(p, end);
+        const char* start = p;
+        while (p < end && *p != ':' && *p != '\n') ++p;
+        std::string_view name(start, static_cast<size_t>(p - start));
+        if (p >= end || *p != ':' || name == "lo") { skipLine(p, end); continue; }
+        ++p;
+
+        NetworkInterface ni;
+        ni.name       = std::string(name);
+        ni.rx_bytes   = parseU64(p, end);
+        ni.rx_packets = parseU64(p, end);
+        ni.rx_errors  = parseU64(p, end);
+        ni.rx_dropped = parseU64(p, end);
+        for (int i = 0; i < 4; ++i) parseU64(p, end);   // fifo frame compressed multicast
+        ni.tx_bytes   = parseU64(p, end);
+        ni.tx_packets = parseU64(p, end);
+        ni.tx_errors  = parseU64(p, end);
+        ni.tx_dropped = parseU64(p, end);
+        out.push_back(std::move(ni));
+        skipLine(p, end);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// /proc/diskstats
+// ---------------------------------------------------------------------------
+
+void parseDiskstats(std::string_view text, std::vector<DiskIO>& out) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    out.clear();
+    while (p < end) {
+        parseU64(p, end);   // major
+        parseU64(p, end);   // minor
+        std::string_view name = nextToken(p, end);
+
+        // skip partitions (sda1, sdb2, …) and loop/ram devices
+        bool skip = name.empty() || name.rfind("loop", 0) == 0 || name.rfind("ram", 0) == 0;
+        for (char c : name) if (static_cast<unsigned>(c - '0') < 10u) { skip = true; break; }
+        if (skip) { skipLine(p, end); continue; }
+
+        DiskIO di;
+        di.name             = std::string(name);
+        di.reads_completed  = parseU64(p, end);
+        parseU64(p, end);   // reads merged
+        di.read_sectors     = parseU64(p, end);
+        di.ms_reading       = parseU64(p, end);
+        di.writes_completed = parseU64(p, end);
+        parseU64(p, end);   // writes merged
+        di.write_sectors    = parseU64(p, end);
+        di.ms_writing       = parseU64(p, end);
+        di.ios_in_progress  = parseU64(p, end);
+        di.ms_io            = parseU64(p, end);
+        di.weighted_ms_io   = parseU64(p, end);
+        out.push_back(std::move(di));
+        skipLine(p, end);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// /proc/mounts
+// ---------------------------------------------------------------------------
+
+std::string decodeMountField(std::string_view s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '\\' && i + 3 < s.size() &&
+            static_cast<unsigned>(s[i + 1] - '0') < 8u &&
+            static_cast<unsigned>(s[i + 2] - '0') < 8u &&
+            static_cast<unsigned>(s[i + 3] - '0') < 8u) {
+            int v = (s[i + 1] - '0') * 64 + (s[i + 2] - '0') * 8 + (s[i + 3] - '0');
+            out.push_back(static_cast<char>(v));
+            i += 3;
+            continue;
+        }
+        out.push_back(s[i]);
+    }
+    return out;
+}
+
+void parseMounts(std::string_view text, std::vector<MountEntry>& out) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    out.clear();
+    while (p < end) {
+        std::string_view dev    = nextToken(p, end);
+        std::string_view mount  = nextToken(p, end);
+        std::string_view fstype = nextToken(p, end);
+        skipLine(p, end);
+
+        // skip pseudo filesystems
+        if (fstype == "proc" || fstype == "sysfs" || fstype == "tmpfs" ||
+            fstype == "devtmpfs" || fstype == "cgroup" || fstype == "cgroup2" ||
+            fstype == "devpts" || fstype == "overlay" || fstype == "none")
+            continue;
+        if (dev.rfind("/dev/", 0) != 0) continue;
+
+        MountEntry m;
+        m.device = std::string(dev);
+        m.mount  = decodeMountField(mount);
+        m.fstype = std::string(fstype);
+        out.push_back(std::move(m));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// /proc/[pid]/stat, statm, io
+// ---------------------------------------------------------------------------
+
+static inline uint64_t tokenU64(std::string_view t) {
+    const char* p = t.data();
+    return parseU64(p, p + t.size());
+}
+
+bool parsePidStat(std::string_view text, PidStat& out) {
+    // "pid (comm) state ppid ..."; comm may itself hold spaces and parens
+    size_t open  = text.find('(');
+    size_t close = text.rfind(')');
+    if (open == std::string_view::npos || close == std::string_view::npos || close < open) return false;
+    out.comm = text.substr(open + 1, close - open - 1);
+
+    const char* p   = text.data() + close + 1;
+    const char* end = text.data() + text.size();
+    // fields are numbered from 1 (pid); signed ones (priority, nice) are
+    // only skipped, so every field is taken as a token
+    for (int field = 3; field <= 22; ++field) {
+        std::string_view t = nextToken(p, end);
+        if (t.empty()) return false;
+        switch (field) {
+            case 3:  out.state      = t.front();   break;
+            case 14: out.utime      = tokenU64(t); break;
+            case 15: out.stime      = tokenU64(t); break;
+            case 20: out.threads    = tokenU64(t); break;
+            case 22: out.start_time = tokenU64(t); break;
+        }
+    }
+    return true;
+}
+
+void parsePidStatm(std::string_view text, uint64_t& sizePages, uint64_t& residentPages) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    sizePages     = parseU64(p, end);
+    residentPages = parseU64(p, end);
+}
+
+void parsePidIo(std::string_view text, uint64_t& readBytes, uint64_t& writeBytes) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    readBytes = writeBytes = 0;
+    while (p < end) {
+        std::string_view key = nextToken(p, end);
+        if      (key == "read_bytes:")  readBytes  = parseU64(p, end);
+        else if (key == "write_bytes:") writeBytes = parseU64(p, end);
+        skipLine(p, end);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// cgroup v2  –  "key value" lines, and "maj:min key=value ..." for io.stat
+// ---------------------------------------------------------------------------
+
+void parseCgroupCpuStat(std::string_view text, ContainerStats& out) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        std::string_view key = nextToken(p, end);
+        uint64_t v = parseU64(p, end);
+        skipLine(p, end);
+        if      (key == "usage_usec")     out.cpu_usage_usec     = v;
+        else if (key == "user_usec")      out.cpu_user_usec      = v;
+        else if (key == "system_usec")    out.cpu_system_usec    = v;
+        else if (key == "nr_throttled")   out.cpu_nr_throttled   = v;
+        else if (key == "throttled_usec") out.cpu_throttled_usec = v;
+    }
+}
+
+void parseCgroupMemoryStat(std::string_view text, ContainerStats& out) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    // anon and file are the first two lines; the remaining ~40 are not used
+    int found = 0;
+    while (p < end && found < 2) {
+        std::string_view key = nextToken(p, end);
+        uint64_t v = parseU64(p, end);
+        skipLine(p, end);
+        if      (key == "anon") { out.memory_anon_bytes = v; ++found; }
+        else if (key == "file") { out.memory_file_bytes = v; ++found; }
+    }
+}
+
+void parseCgroupIoStat(std::string_view text, ContainerStats& out) {
+    const char* p   = text.data();
+    const char* end = p + text.size();
+    out.io_read_bytes = out.io_write_bytes = out.io_read_ops = out.io_write_ops = 0;
+    while (p < end) {
+        nextToken(p, end);   // maj:min
+        while (p < end && *p != '\n') {
+            std::string_view kv = nextToken(p, end);
+            if (kv.empty()) break;
+            size_t eq = kv.find('=');
+            if (eq == std::string_view::npos) continue;
+            const char* vp = kv.data() + eq + 1;
+            uint64_t v = parseU64(vp, kv.data() + kv.size());
+            std::string_view key = kv.substr(0, eq);
+            if      (key == "rbytes") out.io_read_bytes  += v;
+            else if (key == "wbytes") out.io_write_bytes += v;
+            else if (key == "rios")   out.io_read_ops    += v;
+            else if (key == "wios")   out.io_write_ops   += v;
+        }
+        skipLine(p, end);
+    }
+}
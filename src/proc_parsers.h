@@ -0,0 +1,74 @@
+#pragma once
+
+// Allocation-free parsers for the text files under /proc.
+//
+// Every parser works on a buffer that was filled by the caller and writes
+// into caller-owned output that is reused between samples, so steady-state
+// parsing does not touch the heap beyond what the output itself needs.
+
+#include "health_collector.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One /proc/mounts line that refers to a real block device.
+struct MountEntry {
+    std::string device;
+    std::string mount;    // octal escapes (\040 …) already decoded
+    std::string fstype;
+};
+
+// Parse the leading cpu lines of /proc/stat.  `cores` is resized only when
+// the number of online CPUs changes.  Returns false if no aggregate line
+// was found.
+bool parseProcStat(std::string_view text, CpuTimes& total, std::vector<CpuTimes>& cores);
+
+// The /proc/meminfo fields of MemoryInfo (totals, buffers / cache, swap,
+// dirty / writeback); derived fields are filled in as well, rates are left
+// at 0.
+void parseMeminfo(std::string_view text, MemoryInfo& info);
+
+// The fault, swap and OOM counters of /proc/vmstat.
+void parseVmstat(std::string_view text, VmStat& out);
+
+// One /proc/pressure file.  Returns false if it has no "some" line.
+bool parsePressure(std::string_view text, PressureResource& out);
+
+// Interfaces from /proc/net/dev, excluding lo.  `out` is cleared first.
+void parseNetDev(std::string_view text, std::vector<NetworkInterface>& out);
+
+// Whole disks from /proc/diskstats (partitions, loop and ram devices are
+// skipped).  `out` is cleared first.
+void parseDiskstats(std::string_view text, std::vector<DiskIO>& out);
+
+// Block-device mounts from /proc/mounts, pseudo filesystems skipped.
+// `out` is cleared first.
+void parseMounts(std::string_view text, std::vector<MountEntry>& out);
+
+// The /proc/[pid]/stat fields the process table uses.  comm points into
+// the parsed text.
+struct PidStat {
+    std::string_view comm;
+    char             state      = '?';
+    uint64_t         utime      = 0;   // clock ticks
+    uint64_t         stime      = 0;
+    uint64_t         threads    = 0;
+    uint64_t         start_time = 0;   // clock ticks after boot; tells a reused pid apart
+};
+// false if the line is cut short (the process is exiting)
+bool parsePidStat(std::string_view text, PidStat& out);
+// Total and resident size from /proc/[pid]/statm, in pages.
+void parsePidStatm(std::string_view text, uint64_t& sizePages, uint64_t& residentPages);
+// read_bytes / write_bytes of /proc/[pid]/io (storage I/O, not rchar / wchar).
+void parsePidIo(std::string_view text, uint64_t& readBytes, uint64_t& writeBytes);
+
+// cgroup v2 files of one container into the raw counters of `out`; fields
+// a file does not mention are left alone.  io.stat is summed over devices.
+void parseCgroupCpuStat(std::string_view text, ContainerStats& out);
+void parseCgroupMemoryStat(std::string_view text, ContainerStats& out);
+void parseCgroupIoStat(std::string_view text, ContainerStats& out);
+
+// Undo the octal escaping the kernel applies to spaces, tabs, newlines and
+// backslashes in /proc/mounts fields.
+std::string decodeMountField(std::string_view s);
@@ -0,0 +1,317 @@
+#include "process_table.h"
+
+#include "proc_parsers.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Below this many processes a batch is not worth splitting across threads
+static constexpr size_t kMinParallelBatch = 256;
+
+enum ProcFile { kStat, kStatm, kIo, kProcFileCount };
+static const char* const kProcFileNames[kProcFileCount] = {"/stat", "/statm", "/io"};
+
+// Fields after `listed` are written by whichever thread reads the process;
+// the scanner only looks at them once the batch is done.
+struct ProcessScanner::Proc {
+    int         pid = 0;
+    std::string key;
+    bool        cached = false;   // files kept open between reads
+    uint64_t    listed = 0;       // pass_ whose listing had it
+
+    int      fds[kProcFileCount] = {-1, -1, -1};
+    bool     io_denied  = false;
+    bool     gone       = false;   // last read failed: exited
+    bool     have_prev  = false;
+    uint64_t start_time = 0;
+    uint64_t cpu_ticks  = 0;
+    uint64_t io_read    = 0;
+    uint64_t io_write   = 0;
+    std::chrono::steady_clock::time_point read_at;
+    bool        have_info = false;
+    ProcessInfo info;
+};
+
+// One parallel read: slices handed to the pool, counted down as they finish
+struct ProcessScanner::Batch {
+    std::mutex              mutex;
+    std::condition_variable done;
+    size_t                  remaining = 0;
+    IoCounters              io;   // the workers' I/O, charged to the caller
+};
+
+ProcessScanner::ProcessScanner(std::string procPath, ProcessScanOptions options)
+    : proc_path_(std::move(procPath)), options_(options) {
+    if (options_.top_n  == 0) options_.top_n  = 1;
+    if (options_.budget == 0) options_.budget = 1;
+    // up to three files per process, and leave the other half for the
+    // HTTP server and the rest of the collector
+    rlimit rl{};
+    rlim_t limit = getrlimit(RLIMIT_NOFILE, &rl) == 0 ? rl.rlim_cur : 1024;
+    if (limit == RLIM_INFINITY || limit > (rlim_t(1) << 20)) limit = rlim_t(1) << 20;
+    max_cached_ = static_cast<size_t>(limit / 2 / kProcFileCount);
+
+    long page = sysconf(_SC_PAGESIZE), tick = sysconf(_SC_CLK_TCK);
+    if (page > 0) page_size_  = page;
+    if (tick > 0) clock_tick_ = tick;
+    if (options_.threads > 1) {
+        pool_  = std::make_unique<WorkerPool>(options_.threads - 1);   // the caller reads a slice too
+        batch_ = std::make_shared<Batch>();
+    }
+}
+
+ProcessScanner::~ProcessScanner() {
+    for (auto& e : procs_) release(*e.second);
+}
+
+void ProcessScanner::release(Proc& p) {
+    for (int& fd : p.fds) {
+        if (fd < 0) continue;
+        ::close(fd);
+        fd = -1;
+    }
+    if (p.cached) {
+        p.cached = false;
+        --cached_;
+    }
+}
+
+// List the pids and queue them for this pass; processes that were not
+// listed have exited
+void ProcessScanner::startPass() {
+    ++pass_;
+    pending_.clear();
+    if (DIR* dir = opendir(proc_path_.c_str())) {
+        while (dirent* e = readdir(dir)) {
+            if (static_cast<unsigned>(e->d_name[0] - '1') >= 9u) continue;   // pids never start with 0
+            char* end = nullptr;
+            long pid = std::strtol(e->d_name, &end, 10);
+            if (*end || pid <= 0) continue;
+            std::unique_ptr<Proc>& p = procs_[static_cast<int>(pid)];
+            if (!p) {
+                p = std::make_unique<Proc>();
+                p->pid = static_cast<int>(pid);
+                p->key = e->d_name;
+            }
+            p->listed = pass_;
+            pending_.push_back(p->pid);
+        }
+        closedir(dir);
+        threadIoCounters().syscalls += 2 + pending_.size() / 32;   // getdents returns ~32 entries a call
+    }
+    for (auto it = procs_.begin(); it != procs_.end();) {
+        if (it->second->listed == pass_) {
+            ++it;
+            continue;
+        }
+        release(*it->second);
+        it = procs_.erase(it);
+    }
+    // pop_back() then goes in listing (pid) order
+    std::reverse(pending_.begin(), pending_.end());
+}
+
+// pread the whole of a small /proc file into buf; opens it if needed
+static bool readProcFile(int& fd, const std::string& path, std::vector<char>& buf, IoCounters& io,
+                         std::string_view& out, int& error) {
+    if (fd < 0) {
+        ++io.syscalls;
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            error = errno;
+            return false;
+        }
+    }
+    for (;;) {
+        ++io.syscalls;
+        ssize_t n = ::pread(fd, buf.data(), buf.size(), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            error = errno;
+            return false;
+        }
+        if (static_cast<size_t>(n) == buf.size()) {   // cannot tell it is whole: grow and re-read
+            buf.resize(buf.size() * 2);
+            continue;
+        }
+        io.bytes_read += static_cast<uint64_t>(n);
+        out = std::string_view(buf.data(), static_cast<size_t>(n));
+        return n > 0;
+    }
+}
+
+void ProcessScanner::readProc(Proc& p, std::vector<char>& buf, std::chrono::steady_clock::time_point now) const {
+    IoCounters& io = threadIoCounters();
+    const std::string dir = proc_path_ + "/" + p.key;
+    std::string_view text;
+    int error = 0;
+
+    PidStat st;
+    if (!readProcFile(p.fds[kStat], dir + kProcFileNames[kStat], buf, io, text, error) || !parsePidStat(text, st)) {
+        p.gone = true;
+        return;
+    }
+    // a pid reused since the last read starts over
+    if (p.have_prev && st.start_time != p.start_time) p.have_prev = false;
+
+    ProcessInfo& info = p.info;
+    info.pid     = p.pid;
+    info.key     = p.key;
+    info.name.assign(st.comm);
+    info.state.assign(1, st.state);
+    info.threads = st.threads;
+
+    uint64_t sizePages = 0, residentPages = 0;
+    if (readProcFile(p.fds[kStatm], dir + kProcFileNames[kStatm], buf, io, text, error))
+        parsePidStatm(text, sizePages, residentPages);
+    info.virtual_bytes = sizePages * static_cast<uint64_t>(page_size_);
+    info.rss_bytes     = residentPages * static_cast<uint64_t>(page_size_);
+
+    uint64_t ioRead = 0, ioWrite = 0;
+    bool haveIo = false;
+    if (!p.io_denied) {
+        haveIo = readProcFile(p.fds[kIo], dir + kProcFileNames[kIo], buf, io, text, error);
+        if (haveIo) parsePidIo(text, ioRead, ioWrite);
+        else if (error == EACCES || error == EPERM) p.io_denied = true;   // not ours: never retried
+    }
+
+    const uint64_t ticks = st.utime + st.stime;
+    const double   dt    = std::chrono::duration<double>(now - p.read_at).count();
+    info.cpu_percent = info.io_read_bytes_per_sec = info.io_write_bytes_per_sec = 0.0;
+    if (p.have_prev && dt > 0.0) {
+        if (ticks >= p.cpu_ticks)
+            info.cpu_percent = 100.0 * static_cast<double>(ticks - p.cpu_ticks) / static_cast<double>(clock_tick_) / dt;
+        if (haveIo && ioRead >= p.io_read)   info.io_read_bytes_per_sec  = (ioRead - p.io_read) / dt;
+        if (haveIo && ioWrite >= p.io_write) info.io_write_bytes_per_sec = (ioWrite - p.io_write) / dt;
+    }
+    p.start_time = st.start_time;
+    p.cpu_ticks  = ticks;
+    p.io_read    = ioRead;
+    p.io_write   = ioWrite;
+    p.read_at    = now;
+    p.have_prev  = true;
+    p.have_info  = true;
+
+    if (!p.cached)
+        for (int& fd : p.fds)
+            if (fd >= 0) {
+                ++io.syscalls;
+                ::close(fd);
+                fd = -1;
+            }
+}
+
+// The `n` highest by `score`, through a min-heap that never holds more
+template <typename Score>
+static void pickTop(const std::vector<const ProcessInfo*>& all, size_t n, Score score,
+                    std::vector<const ProcessInfo*>& out) {
+    auto lower = [&score](const ProcessInfo* a, const ProcessInfo* b) { return score(*a) > score(*b); };
+    std::vector<const ProcessInfo*> heap;
+    heap.reserve(n + 1);
+    for (const ProcessInfo* p : all) {
+        if (score(*p) <= 0.0) continue;
+        if (heap.size() < n) {
+            heap.push_back(p);
+            std::push_heap(heap.begin(), heap.end(), lower);
+        } else if (score(*p) > score(*heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), lower);
+            heap.back() = p;
+            std::push_heap(heap.begin(), heap.end(), lower);
+        }
+    }
+    out.insert(out.end(), heap.begin(), heap.end());
+}
+
+std::vector<ProcessInfo> ProcessScanner::scan() {
+    if (pending_.empty()) startPass();
+
+    std::vector<Proc*> batch;
+    while (!pending_.empty() && batch.size() < options_.budget) {
+        auto it = procs_.find(pending_.back());
+        pending_.pop_back();
+        if (it == procs_.end()) continue;
+        Proc& p = *it->second;
+        if (!p.cached && cached_ < max_cached_) {
+            p.cached = true;
+            ++cached_;
+        }
+        batch.push_back(&p);
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (buf_.empty()) buf_.resize(1024);
+    if (pool_ && batch.size() >= kMinParallelBatch) {
+        // equal slices; the caller takes the first, and waits for the rest
+        // before touching any of them again
+        const size_t slices = options_.threads;
+        const size_t per    = (batch.size() + slices - 1) / slices;
+        std::shared_ptr<Batch> sync = batch_;
+        sync->remaining = 0;
+        sync->io        = IoCounters{};
+        for (size_t s = 1; s < slices && s * per < batch.size(); ++s) {
+            {
+                std::lock_guard<std::mutex> lock(sync->mutex);
+                ++sync->remaining;
+            }
+            Proc* const* first = batch.data() + s * per;
+            Proc* const* last  = batch.data() + std::min(batch.size(), (s + 1) * per);
+            pool_->submit([this, first, last, now, sync]() {
+                static thread_local std::vector<char> buf(1024);
+                IoCounters& io = threadIoCounters();
+                IoCounters before = io;
+                for (Proc* const* p = first; p != last; ++p) readProc(**p, buf, now);
+                std::lock_guard<std::mutex> lock(sync->mutex);
+                sync->io.syscalls   += io.syscalls - before.syscalls;
+                sync->io.bytes_read += io.bytes_read - before.bytes_read;
+                if (--sync->remaining == 0) sync->done.notify_all();
+            });
+        }
+        for (size_t i = 0; i < std::min(per, batch.size()); ++i) readProc(*batch[i], buf_, now);
+        std::unique_lock<std::mutex> lock(sync->mutex);
+        sync->done.wait(lock, [&sync]() { return sync->remaining == 0; });
+        threadIoCounters().syscalls   += sync->io.syscalls;
+        threadIoCounters().bytes_read += sync->io.bytes_read;
+    } else {
+        for (Proc* p : batch) readProc(*p, buf_, now);
+    }
+
+    std::vector<const ProcessInfo*> all;
+    all.reserve(procs_.size());
+    for (auto it = procs_.begin(); it != procs_.end();) {
+        Proc& p = *it->second;
+        if (p.gone) {
+            release(p);
+            it = procs_.erase(it);
+            continue;
+        }
+        if (p.have_info) all.push_back(&p.info);
+        ++it;
+    }
+
+    std::vector<const ProcessInfo*> top;
+    const size_t n = options_.top_n;
+    pickTop(all, n, [](const ProcessInfo& p) { return p.cpu_percent; }, top);
+    pickTop(all, n, [](const ProcessInfo& p) { return static_cast<double>(p.rss_bytes); }, top);
+    pickTop(all, n, [](const ProcessInfo& p) { return p.io_read_bytes_per_sec + p.io_write_bytes_per_sec; }, top);
+    std::sort(top.begin(), top.end(), [](const ProcessInfo* a, const ProcessInfo* b) {
+        if (a->cpu_percent != b->cpu_percent) return a->cpu_percent > b->cpu_percent;
+        if (a->rss_bytes != b->rss_bytes) return a->rss_bytes > b->rss_bytes;
+        return a->pid < b->pid;
+    });
+    top.erase(std::unique(top.begin(), top.end()), top.end());
+
+    std::vector<ProcessInfo> result;
+    result.reserve(top.size());
+    for (const ProcessInfo* p : top) result.push_back(*p);
+    return result;
+}
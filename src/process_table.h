@@ -0,0 +1,69 @@
+#pragma once
+
+#include "health_collector.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class WorkerPool;
+
+// PROCESS_TOP_N, PROCESS_SCAN_BUDGET, PROCESS_SCAN_THREADS
+struct ProcessScanOptions {
+    size_t top_n   = 10;     // per ranking: CPU, resident memory and I/O
+    size_t budget  = 1000;   // processes read per scan()
+    size_t threads = 1;      // > 1: slices of a batch are read in parallel
+};
+
+// Top processes by CPU, resident memory and I/O from /proc/[pid]/stat,
+// statm and io.
+//
+// The pid list is walked in passes: the directory is listed when a pass
+// starts, and each scan() reads at most `budget` of the processes still to
+// visit, so on a host with thousands of them one pass is spread over
+// several sampling ticks instead of reading every pid on every tick.  A
+// rate is taken against the process's own previous reading, whenever that
+// was.  The files of a process stay open between passes (once it exits,
+// reads fail with ESRCH and it is dropped) for as many processes as half
+// of RLIMIT_NOFILE allows; the rest are opened for each read.  The
+// rankings are picked with a bounded heap over every known process.
+// Sampler thread only.
+class ProcessScanner {
+public:
+    ProcessScanner(std::string procPath, ProcessScanOptions options);
+    ~ProcessScanner();
+
+    ProcessScanner(const ProcessScanner&)            = delete;
+    ProcessScanner& operator=(const ProcessScanner&) = delete;
+
+    // Read the next slice, then the union of the top_n by each ranking,
+    // busiest CPU first.
+    std::vector<ProcessInfo> scan();
+
+private:
+    struct Proc;
+    struct Batch;
+
+    void startPass();
+    void readProc(Proc& p, std::vector<char>& buf, std::chrono::steady_clock::time_point now) const;
+    void release(Proc& p);
+
+    std::string        proc_path_;
+    ProcessScanOptions options_;
+    size_t             max_cached_ = 0;   // processes whose files may stay open
+    size_t             cached_     = 0;
+
+    std::unordered_map<int, std::unique_ptr<Proc>> procs_;     // by pid
+    std::vector<int>                               pending_;   // still to read in this pass
+    uint64_t                                       pass_ = 0;
+    std::vector<char>                              buf_;
+
+    std::unique_ptr<WorkerPool> pool_;
+    std::shared_ptr<Batch>      batch_;
+    long                        page_size_ = 4096;
+    long                        clock_tick_ = 100;
+};
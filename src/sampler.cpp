@@ -0,0 +1,352 @@
+#include "sampler.h"
+
+#include "cbor_writer.h"
+#include "json_writer.h"
+#include "openmetrics.h"
+#include "self_metrics.h"
+
+#include <atomic>
+#include <ctime>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <unistd.h>
+
+Sampler::Sampler(const SamplerOptions& options)
+    : collector_(options.groups),
+      interval_(options.interval.count() > 0 ? options.interval : std::chrono::milliseconds(1000)),
+      scheduler_(interval_, options.schedules, options.groups),
+      history_(interval_, options.history_retention, options.data_dir, options.data_retention,
+               options.history_max_series),
+      instance_((static_cast<uint64_t>(std::random_device{}()) << 32 | std::random_device{}()) >> 11),
+      alerts_(options.alert_rules) {
+    if (!options.alert_webhook.empty()) webhook_ = std::make_unique<WebhookSender>(options.alert_webhook);
+    char host[256] = {};
+    if (gethostname(host, sizeof(host) - 1) == 0) hostname_ = host;
+}
+
+Sampler::~Sampler() {
+    stop();
+}
+
+void Sampler::start() {
+    if (thread_.joinable()) return;
+    if (webhook_) webhook_->start();
+    sampleOnce(kAllGroups, false);
+    scheduler_.start();
+    thread_ = std::thread([this]() { run(); });
+}
+
+void Sampler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    published_.notify_all();
+    if (thread_.joinable()) thread_.join();
+    if (webhook_) webhook_->stop();
+}
+
+std::shared_ptr<const HealthSnapshot> Sampler::latest() const {
+    return std::atomic_load(&latest_);
+}
+
+std::shared_ptr<const HealthSnapshot> Sampler::waitForNewer(uint64_t sequence, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    published_.wait_for(lock, timeout, [this, sequence]() {
+        return stopping_ || published_sequence_ > sequence;
+    });
+    if (stopping_) return nullptr;
+    return latest();
+}
+
+// ---------------------------------------------------------------------------
+// sampling loop  –  fixed rate, so a slow collection does not drift the period
+// ---------------------------------------------------------------------------
+
+void Sampler::run() {
+    auto next = std::chrono::steady_clock::now() + interval_;
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    while (!stopping_) {
+        if (wake_.wait_until(lock, next, [this]() { return stopping_; })) break;
+        lock.unlock();
+        uint32_t due = scheduler_.advance();
+        if (due) sampleOnce(due, true);
+        lock.lock();
+
+        next += interval_;
+        auto now = std::chrono::steady_clock::now();
+        if (next < now) next = now + interval_;   // fell behind: skip, don't burst
+    }
+}
+
+// Move the groups present in `from` into `into`.
+static void mergeGroups(HealthData& into, HealthData& from) {
+    if (from.groups & kGroupCpu)         into.cpu         = std::move(from.cpu);
+    if (from.groups & kGroupMemory)      into.memory      = from.memory;
+    if (from.groups & kGroupDisks)       into.disks       = std::move(from.disks);
+    if (from.groups & kGroupNetwork)     into.network     = std::move(from.network);
+    if (from.groups & kGroupDiskIO)      into.disk_io     = std::move(from.disk_io);
+    if (from.groups & kGroupTemperature) into.temperature = std::move(from.temperature);
+    if (from.groups & kGroupDocker)      into.docker      = std::move(from.docker);
+    if (from.groups & kGroupSpeed)       into.speed       = std::move(from.speed);
+    if (from.groups & kGroupPressure)    into.pressure    = from.pressure;
+    if (from.groups & kGroupProcesses)   into.processes   = std::move(from.processes);
+    if (from.groups & kGroupLatency)     into.latency     = std::move(from.latency);
+    into.groups   |= from.groups;
+    into.refreshed = from.groups;
+    into.timestamp = from.timestamp;
+}
+
+// Size the buffers of a new snapshot like those of the previous one, so
+// rendering does not grow them step by step.  `prev` is only read.
+static void reserveLike(PreparedBody& body, const PreparedBody& prev) {
+    body.text.reserve(prev.text.size());
+    body.gzip.reserve(prev.gzip.size());
+}
+
+static void reserveLike(HealthSnapshot& snap, const HealthSnapshot& prev) {
+    reserveLike(snap.json, prev.json);
+    reserveLike(snap.json_compact, prev.json_compact);
+    reserveLike(snap.metrics, prev.metrics);
+    reserveLike(snap.cbor, prev.cbor);
+    for (int i = 0; i < kMetricGroupCount; ++i) reserveLike(snap.groups[i], prev.groups[i]);
+    snap.stream_full.reserve(prev.stream_full.size());
+    snap.stream_delta.reserve(prev.stream_delta.size());
+    snap.cbor_parts.reserve(prev.cbor_parts.size());
+}
+
+void Sampler::sampleOnce(uint32_t due, bool scheduled) {
+    // Always a fresh snapshot: handlers may still be reading published ones,
+    // and nothing orders their last read before a reuse here
+    auto snap = std::make_shared<HealthSnapshot>();
+    if (current_) reserveLike(*snap, *current_);
+
+    snap->sequence = ++sequence_;
+    HealthData fresh = collector_.collect(due);
+    if (scheduled)
+        for (int i = 0; i < kMetricGroupCount; ++i)
+            if (due & (1u << i))
+                scheduler_.reschedule(i, !(data_.groups & (1u << i)) || groupChanged(data_, fresh, i));
+    mergeGroups(data_, fresh);
+    selfMetrics().sampleProcess();
+
+    // render through publish; the collectors time themselves
+    auto renderStart = std::chrono::steady_clock::now();
+    const HealthData& data = data_;
+    HealthCollector::writeJson(data, snap->json.text, true);
+    HealthCollector::writeJson(data, snap->json_compact.text, false);
+    renderOpenMetrics(data, snap->sequence, snap->metrics.text);
+    prepareBody(snap->json, gzip_);
+    prepareBody(snap->json_compact, gzip_);
+    prepareBody(snap->metrics, gzip_);
+
+    snap->collected = data.groups;
+    snap->timestamp = HealthCollector::isoTimestamp(data.timestamp);
+    for (int i = 0; i < kMetricGroupCount; ++i) {
+        PreparedBody& g = snap->groups[i];
+        if (data.groups & (1u << i)) {
+            HealthCollector::writeGroupJson(data, i, g.text);
+            prepareBody(g, gzip_);
+        } else {
+            g.text.clear();
+        }
+    }
+    history_.record(data);
+
+    renderStreamFrames(*snap);
+    renderCbor(*snap);
+    checkAlerts(*snap);
+
+    std::atomic_store(&latest_, std::shared_ptr<const HealthSnapshot>(snap));
+    selfMetrics().publish().record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - renderStart).count()));
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        published_sequence_ = snap->sequence;
+    }
+    published_.notify_all();
+    current_ = std::move(snap);
+}
+
+// ---------------------------------------------------------------------------
+// stream frames  –  rendered once here, written as is to every subscriber
+// ---------------------------------------------------------------------------
+
+static void appendFrameHeader(std::string& out, uint64_t sequence, const char* event) {
+    out += "id: ";
+    out += std::to_string(sequence);
+    out += "\nevent: ";
+    out += event;
+    out += "\ndata: ";
+}
+
+void Sampler::renderStreamFrames(HealthSnapshot& snap) {
+    // the compact document has no raw newlines, so it fits one data: line
+    const std::string& doc = snap.json_compact.text;
+    snap.stream_full.clear();
+    appendFrameHeader(snap.stream_full, snap.sequence, "full");
+    snap.stream_full += doc;
+    snap.stream_full += "\n\n";
+
+    snap.stream_delta.clear();
+    bool havePrev = !prev_flat_.empty();
+    if (!flattenJson(doc, flat_)) {
+        flat_.clear();
+        havePrev = false;
+    }
+    if (havePrev) {
+        JsonWriter w(delta_json_, false);
+        w.beginObject();
+        w.field("base", snap.sequence - 1);
+        writeJsonDelta(w, prev_flat_, flat_);
+        w.endObject();
+
+        appendFrameHeader(snap.stream_delta, snap.sequence, "delta");
+        snap.stream_delta += delta_json_;
+        snap.stream_delta += "\n\n";
+    }
+    std::swap(flat_, prev_flat_);
+}
+
+// ---------------------------------------------------------------------------
+// CBOR  –  whole document, and the bookkeeping ?since= deltas are cut with
+// ---------------------------------------------------------------------------
+
+// How many sequences back a delta can reach; older bases get the document
+static constexpr uint64_t kCborDeltaWindow = 600;
+
+void Sampler::renderCbor(HealthSnapshot& snap) {
+    const uint64_t seq = snap.sequence;
+    HealthCollector::writeCbor(data_, seq, instance_, snap.cbor.text, &cbor_entries_);
+    prepareBody(snap.cbor, gzip_);
+
+    // an entry changed when its encoding did
+    const std::string& doc = snap.cbor.text;
+    snap.cbor_parts.clear();
+    std::string id;
+    for (const CborEntry& e : cbor_entries_) {
+        id.assign(1, static_cast<char>(e.group));
+        id += e.key;
+        size_t h = std::hash<std::string_view>{}(std::string_view(doc).substr(e.offset, e.length));
+        PartState& st = cbor_state_[id];
+        if (st.seen == 0 || st.hash != h) {
+            st.hash    = h;
+            st.changed = seq;
+        }
+        st.seen = seq;
+        snap.cbor_parts.push_back(CborPart{e, st.changed});
+    }
+    for (auto it = cbor_state_.begin(); it != cbor_state_.end();) {
+        if (it->second.seen == seq) { ++it; continue; }
+        cbor_removed_.push_back(CborRemoval{static_cast<unsigned char>(it->first[0]), it->first.substr(1), seq});
+        it = cbor_state_.erase(it);
+    }
+
+    const uint64_t floor = seq > kCborDeltaWindow ? seq - kCborDeltaWindow : 1;
+    while (!cbor_removed_.empty() && cbor_removed_.front().removed <= floor) cbor_removed_.pop_front();
+    snap.cbor_removed.assign(cbor_removed_.begin(), cbor_removed_.end());
+    snap.cbor_floor = floor;
+    snap.instance   = instance_;
+}
+
+bool writeCborDelta(const HealthSnapshot& snap, uint64_t since, std::string& out) {
+    if (since < snap.cbor_floor || since > snap.sequence) return false;
+    const std::string_view doc(snap.cbor.text);
+
+    CborWriter w(out);
+    w.beginObject();
+    w.field("sequence",  snap.sequence);
+    w.field("base",      since);
+    w.field("instance",  snap.instance);
+    w.field("timestamp", snap.timestamp);
+
+    // parts are in document order, so each group's entries are adjacent
+    w.key("set");
+    w.beginObject();
+    for (size_t i = 0; i < snap.cbor_parts.size();) {
+        const int group = snap.cbor_parts[i].entry.group;
+        size_t end = i;
+        bool   any = false;
+        for (; end < snap.cbor_parts.size() && snap.cbor_parts[end].entry.group == group; ++end)
+            any |= snap.cbor_parts[end].changed > since;
+        if (any) {
+            const bool list = !((1u << group) & kObjectGroups);
+            w.key(metricGroupName(group));
+            if (list) w.beginArray();
+            for (size_t j = i; j < end; ++j) {
+                const CborPart& p = snap.cbor_parts[j];
+                if (p.changed > since) w.rawValue(doc.substr(p.entry.offset, p.entry.length));
+            }
+            if (list) w.endArray();
+        }
+        i = end;
+    }
+    w.endObject();
+
+    w.key("remove");
+    w.beginObject();
+    for (int g = 0; g < kMetricGroupCount; ++g) {
+        bool open = false;
+        for (const CborRemoval& r : snap.cbor_removed) {
+            if (r.group != g || r.removed <= since) continue;
+            if (!open) {
+                w.key(metricGroupName(g));
+                w.beginArray();
+                open = true;
+            }
+            w.value(r.key);
+        }
+        if (open) w.endArray();
+    }
+    w.endObject();
+    w.endObject();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// alerts  –  evaluated on the merged sample; transitions are queued for the
+// webhook and never wait for it
+// ---------------------------------------------------------------------------
+
+void Sampler::checkAlerts(HealthSnapshot& snap) {
+    if (alerts_.empty()) {   // the same body every time: copied from the previous snapshot
+        if (current_) {
+            snap.alerts = current_->alerts;
+        } else {
+            snap.alerts.text = "{\"rules\": [], \"active\": []}\n";
+            prepareBody(snap.alerts, gzip_);
+        }
+        return;
+    }
+    const int64_t t = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::system_clock::now().time_since_epoch()).count();
+    alert_events_.clear();
+    alerts_.evaluate(data_, t, alert_events_);
+    if (webhook_) {
+        std::string body;
+        for (const AlertEvent& e : alert_events_) {
+            writeAlertEventJson(e, hostname_, body);
+            webhook_->post(std::move(body));
+        }
+    }
+
+    JsonWriter w(snap.alerts.text, true);
+    w.beginObject();
+    alerts_.writeJson(w);
+    if (webhook_) {
+        w.key("webhook");
+        w.beginObject();
+        w.field("url",     webhook_->url());
+        w.field("queued",  static_cast<uint64_t>(webhook_->queued()));
+        w.field("sent",    webhook_->sent());
+        w.field("failed",  webhook_->failed());
+        w.field("dropped", webhook_->dropped());
+        w.endObject();
+    }
+    w.endObject();
+    prepareBody(snap.alerts, gzip_);
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "alerts.h"
+#include "health_collector.h"
+#include "history.h"
+#include "json_delta.h"
+#include "prepared_body.h"
+#include "scheduler.h"
+#include "webhook.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// An entry (or scalar group) of the CBOR document with the sequence its
+// encoding last changed in, and an entry that went away.
+struct CborPart {
+    CborEntry entry;
+    uint64_t  changed = 0;
+};
+struct CborRemoval {
+    int         group;
+    std::string key;
+    uint64_t    removed;
+};
+
+// One published collection result. Never modified after it has been handed
+// out, so HTTP handlers can read it without holding any lock.
+struct HealthSnapshot {
+    uint64_t    sequence = 0;
+    PreparedBody json;           // pretty-printed /api/health body
+    PreparedBody json_compact;   // same document without indentation
+    PreparedBody metrics;        // OpenMetrics text for /metrics
+
+    // Compact value of each collected group for /api/health/<group> and
+    // ?include=, indexed like metricGroupName(); empty if not collected
+    uint32_t     collected = 0;
+    std::string  timestamp;      // ISO-8601
+    PreparedBody groups[kMetricGroupCount];
+
+    // Server-Sent Events frames for /api/stream: the whole compact document,
+    // and the changes since sequence - 1 (empty for the first sample)
+    std::string stream_full;
+    std::string stream_delta;
+
+    // CBOR document for Accept: application/cbor, and what a ?since= delta
+    // is cut from: the position and last change of every entry in it, and
+    // the entries removed since cbor_floor (the oldest usable base).
+    // instance tells a client that its base came from an earlier run.
+    PreparedBody             cbor;
+    std::vector<CborPart>    cbor_parts;
+    std::vector<CborRemoval> cbor_removed;
+    uint64_t                 cbor_floor = 0;
+    uint64_t                 instance   = 0;
+
+    // /api/alerts: the rules, what is firing or pending, webhook counters
+    PreparedBody alerts;
+};
+
+// CBOR {"sequence", "base", "instance", "timestamp", "set": {group: entries
+// or value}, "remove": {group: [key, ...]}} with what changed after sequence
+// `since`; a removed entry that came back is in both, and remove applies
+// first.  False if `since` is outside the delta window (send the whole
+// document instead).
+bool writeCborDelta(const HealthSnapshot& snap, uint64_t since, std::string& out);
+
+struct SamplerOptions {
+    std::chrono::milliseconds interval{1000};           // scheduler tick
+    std::chrono::hours        history_retention{1};     // raw history tier
+    size_t                    history_max_series = 1024; // in memory, ~36 KB each
+    std::string               data_dir;                 // persistent history; empty = memory only
+    std::chrono::hours        data_retention{24 * 30};  // ... and how long it is kept
+    uint32_t                  groups = kAllGroups;      // collected at all
+    SourceSchedule            schedules[kMetricGroupCount];   // per group period / backoff
+    std::vector<AlertRule>    alert_rules;               // checked against every sample
+    std::string               alert_webhook;             // http:// URL; empty = no notifications
+};
+
+// Owns the single HealthCollector and samples it from one background
+// thread.  Each tick the scheduler says which groups are due; those are
+// collected and merged into the previous data, and a new snapshot is
+// published.  Request handlers only ever read the latest snapshot, so
+// collection cost is independent of the number of clients.
+class Sampler {
+public:
+    explicit Sampler(const SamplerOptions& options);
+    ~Sampler();
+
+    Sampler(const Sampler&)            = delete;
+    Sampler& operator=(const Sampler&) = delete;
+
+    // Collects the first snapshot synchronously, then starts the thread.
+    void start();
+    void stop();
+
+    std::shared_ptr<const HealthSnapshot> latest() const;
+
+    // Block until a snapshot newer than `sequence` is published and return
+    // it; returns the current one when `timeout` expires first and nullptr
+    // once stop() has been called.
+    std::shared_ptr<const HealthSnapshot> waitForNewer(uint64_t sequence, std::chrono::milliseconds timeout);
+    const MetricHistory&                  history() const { return history_; }
+
+private:
+    void run();
+    // Collect `due`, merge, publish.  `scheduled` re-arms the groups.
+    void sampleOnce(uint32_t due, bool scheduled);
+    void renderStreamFrames(HealthSnapshot& snap);
+    void renderCbor(HealthSnapshot& snap);
+    void checkAlerts(HealthSnapshot& snap);
+
+    HealthCollector           collector_;
+    std::chrono::milliseconds interval_;
+    CollectionScheduler       scheduler_;
+    HealthData                data_;        // latest value of every group
+    uint64_t                  sequence_ = 0;
+    MetricHistory             history_;
+    GzipEncoder               gzip_;
+    std::vector<FlatField>    flat_;        // current sample, flattened
+    std::vector<FlatField>    prev_flat_;   // previous sample
+    std::string               delta_json_;
+
+    // CBOR change tracking, by group index byte + entry key
+    struct PartState {
+        size_t   hash    = 0;
+        uint64_t changed = 0;
+        uint64_t seen    = 0;
+    };
+    std::vector<CborEntry>                     cbor_entries_;
+    std::unordered_map<std::string, PartState> cbor_state_;
+    std::deque<CborRemoval>                    cbor_removed_;
+    uint64_t                                   instance_;
+
+    // Alerts are evaluated here; notifications only get queued, the
+    // sender delivers them from its own thread
+    AlertEngine                    alerts_;
+    std::vector<AlertEvent>        alert_events_;
+    std::unique_ptr<WebhookSender> webhook_;   // null without a URL
+    std::string                    hostname_;
+
+    // Published with std::atomic_store / read with std::atomic_load.
+    std::shared_ptr<const HealthSnapshot> latest_;
+    // current_ aliases latest_; the next snapshot is sized after it.
+    std::shared_ptr<const HealthSnapshot> current_;
+
+    std::mutex              wake_mutex_;
+    std::condition_variable wake_;
+    std::condition_variable published_;      // stream subscribers wait here
+    uint64_t                published_sequence_ = 0;
+    bool                    stopping_ = false;
+    std::thread             thread_;
+};
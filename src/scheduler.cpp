@@ -0,0 +1,194 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+// ---------------------------------------------------------------------------
+// configuration
+// ---------------------------------------------------------------------------
+
+void defaultSchedules(SourceSchedule (&out)[kMetricGroupCount], std::chrono::milliseconds tick) {
+    using std::chrono::milliseconds;
+    for (auto& s : out) s = SourceSchedule{tick, tick};
+    // statvfs results and temperatures move slowly
+    out[metricGroupIndex("disks")]       = SourceSchedule{std::max(tick, milliseconds(10000)), milliseconds(120000)};
+    out[metricGroupIndex("temperature")] = SourceSchedule{std::max(tick, milliseconds(5000)),  milliseconds(60000)};
+}
+
+static bool parseMs(std::string_view s, std::chrono::milliseconds& out) {
+    long v = 0;
+    auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (r.ec != std::errc() || r.ptr != s.data() + s.size() || v <= 0) return false;
+    out = std::chrono::milliseconds(v);
+    return true;
+}
+
+bool parseSchedules(std::string_view spec, SourceSchedule (&out)[kMetricGroupCount]) {
+    while (!spec.empty()) {
+        size_t comma = spec.find(',');
+        std::string_view entry = spec.substr(0, comma);
+        if (!entry.empty()) {
+            size_t eq = entry.find('=');
+            if (eq == std::string_view::npos) return false;
+            int index = metricGroupIndex(entry.substr(0, eq));
+            if (index < 0) return false;
+
+            std::string_view value = entry.substr(eq + 1);
+            size_t colon = value.find(':');
+            SourceSchedule s;
+            if (!parseMs(value.substr(0, colon), s.period)) return false;
+            s.max_period = s.period;
+            if (colon != std::string_view::npos && !parseMs(value.substr(colon + 1), s.max_period)) return false;
+            s.max_period = std::max(s.max_period, s.period);
+            out[index] = s;
+        }
+        if (comma == std::string_view::npos) break;
+        spec.remove_prefix(comma + 1);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// change detection  –  per group tolerances for the backoff
+// ---------------------------------------------------------------------------
+
+static bool differs(double a, double b, double absTol, double relTol = 0.0) {
+    double d = std::fabs(a - b);
+    return d > absTol && d > relTol * std::max(std::fabs(a), std::fabs(b));
+}
+
+template <typename T, typename Fn>
+static bool anyDiffers(const std::vector<T>& a, const std::vector<T>& b, Fn fn) {
+    if (a.size() != b.size()) return true;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a[i].name != b[i].name || fn(a[i], b[i])) return true;
+    return false;
+}
+
+bool groupChanged(const HealthData& prev, const HealthData& cur, int index) {
+    switch (1u << index) {
+    case kGroupCpu:
+        return differs(prev.cpu.usage_percent, cur.cpu.usage_percent, 2.0);
+    case kGroupMemory:
+        return differs(prev.memory.usage_percent, cur.memory.usage_percent, 1.0);
+    case kGroupDisks: {
+        if (prev.disks.size() != cur.disks.size()) return true;
+        for (size_t i = 0; i < cur.disks.size(); ++i) {
+            const DiskInfo& a = prev.disks[i];
+            const DiskInfo& b = cur.disks[i];
+            if (a.path != b.path || a.total_kb != b.total_kb) return true;
+            if (differs(static_cast<double>(a.free_kb), static_cast<double>(b.free_kb), 0.001 * b.total_kb)) return true;
+            if (differs(static_cast<double>(a.inodes_free), static_cast<double>(b.inodes_free), 0.001 * b.inodes_total)) return true;
+        }
+        return false;
+    }
+    case kGroupNetwork:
+        return anyDiffers(prev.network, cur.network, [](const NetworkInterface& a, const NetworkInterface& b) {
+            return differs(a.rx_bytes_per_sec, b.rx_bytes_per_sec, 1024.0, 0.1) ||
+                   differs(a.tx_bytes_per_sec, b.tx_bytes_per_sec, 1024.0, 0.1);
+        });
+    case kGroupDiskIO:
+        return anyDiffers(prev.disk_io, cur.disk_io, [](const DiskIO& a, const DiskIO& b) {
+            return differs(a.reads_per_sec,  b.reads_per_sec,  1.0, 0.1) ||
+                   differs(a.writes_per_sec, b.writes_per_sec, 1.0, 0.1);
+        });
+    case kGroupTemperature:
+        return anyDiffers(prev.temperature, cur.temperature, [](const ThermalZone& a, const ThermalZone& b) {
+            return differs(a.temperature_celsius, b.temperature_celsius, 0.5);
+        });
+    case kGroupDocker: {
+        // the human-readable status ticks every second on its own; ignore it
+        if (prev.docker.size() != cur.docker.size()) return true;
+        for (size_t i = 0; i < cur.docker.size(); ++i) {
+            const DockerContainer& a = prev.docker[i];
+            const DockerContainer& b = cur.docker[i];
+            if (a.id != b.id || a.state != b.state || a.health != b.health) return true;
+            if (differs(a.resources.cpu_percent, b.resources.cpu_percent, 2.0) ||
+                differs(static_cast<double>(a.resources.memory_bytes),
+                        static_cast<double>(b.resources.memory_bytes), 1048576.0, 0.05))
+                return true;
+        }
+        return false;
+    }
+    case kGroupSpeed:
+        return prev.speed.available != cur.speed.available || prev.speed.stale != cur.speed.stale ||
+               prev.speed.timestamp != cur.speed.timestamp;
+    case kGroupProcesses: {
+        if (prev.processes.size() != cur.processes.size()) return true;
+        for (size_t i = 0; i < cur.processes.size(); ++i) {
+            const ProcessInfo& a = prev.processes[i];
+            const ProcessInfo& b = cur.processes[i];
+            if (a.pid != b.pid || differs(a.cpu_percent, b.cpu_percent, 2.0) ||
+                differs(static_cast<double>(a.rss_bytes), static_cast<double>(b.rss_bytes), 1048576.0, 0.05))
+                return true;
+        }
+        return false;
+    }
+    case kGroupPressure:
+        return prev.pressure.available != cur.pressure.available ||
+               differs(prev.pressure.cpu.some.avg10,    cur.pressure.cpu.some.avg10,    1.0) ||
+               differs(prev.pressure.memory.some.avg10, cur.pressure.memory.some.avg10, 1.0) ||
+               differs(prev.pressure.io.some.avg10,     cur.pressure.io.some.avg10,     1.0);
+    case kGroupLatency:
+        return prev.latency.available != cur.latency.available ||
+               differs(prev.latency.runq.p99_us, cur.latency.runq.p99_us, 100.0, 0.2) ||
+               differs(prev.latency.tcp_retransmits_per_sec, cur.latency.tcp_retransmits_per_sec, 1.0);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// scheduler
+// ---------------------------------------------------------------------------
+
+CollectionScheduler::CollectionScheduler(std::chrono::milliseconds tick,
+                                         const SourceSchedule (&schedules)[kMetricGroupCount],
+                                         uint32_t groups)
+    : tick_(tick.count() > 0 ? tick : std::chrono::milliseconds(1000)), groups_(groups) {
+    auto toTicks = [this](std::chrono::milliseconds d) {
+        return std::max<uint64_t>(1, static_cast<uint64_t>((d.count() + tick_.count() - 1) / tick_.count()));
+    };
+    for (int i = 0; i < kMetricGroupCount; ++i) {
+        base_ticks_[i] = toTicks(schedules[i].period);
+        max_ticks_[i]  = std::max(base_ticks_[i], toTicks(schedules[i].max_period));
+        cur_ticks_[i]  = base_ticks_[i];
+    }
+}
+
+void CollectionScheduler::arm(int index) {
+    uint64_t deadline = now_ + cur_ticks_[index];
+    slots_[deadline % kSlots].push_back(Timer{index, deadline});
+}
+
+void CollectionScheduler::start() {
+    for (auto& slot : slots_) slot.clear();
+    for (int i = 0; i < kMetricGroupCount; ++i)
+        if (groups_ & (1u << i)) arm(i);
+}
+
+uint32_t CollectionScheduler::advance() {
+    ++now_;
+    std::vector<Timer>& slot = slots_[now_ % kSlots];
+    uint32_t due = 0;
+    // timers further than one revolution away stay in the slot
+    for (size_t i = 0; i < slot.size();) {
+        if (slot[i].deadline <= now_) {
+            due |= 1u << slot[i].group;
+            slot[i] = slot.back();
+            slot.pop_back();
+        } else {
+            ++i;
+        }
+    }
+    return due;
+}
+
+void CollectionScheduler::reschedule(int index, bool changed) {
+    cur_ticks_[index] = changed ? base_ticks_[index] : std::min(cur_ticks_[index] * 2, max_ticks_[index]);
+    arm(index);
+}
+
+std::chrono::milliseconds CollectionScheduler::period(int index) const {
+    return tick_ * static_cast<int64_t>(cur_ticks_[index]);
+}
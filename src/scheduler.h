@@ -0,0 +1,68 @@
+#pragma once
+
+#include "health_collector.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// How often one metric group is collected.  When max_period is larger than
+// period the interval backs off (doubling) while the group's values stay
+// stable and drops back to period as soon as they change.
+struct SourceSchedule {
+    std::chrono::milliseconds period{1000};
+    std::chrono::milliseconds max_period{1000};
+};
+
+// Built-in schedule for every group (disks and temperature back off).
+void defaultSchedules(SourceSchedule (&out)[kMetricGroupCount], std::chrono::milliseconds tick);
+
+// Apply "disks=10000:120000,temperature=5000" (ms, optional :max) on top of
+// `out`; false on a malformed entry or unknown group.
+bool parseSchedules(std::string_view spec, SourceSchedule (&out)[kMetricGroupCount]);
+
+// True if `cur` differs enough from `prev` in group `index` to count as a
+// change for backoff purposes (jitter in the last digit does not).
+bool groupChanged(const HealthData& prev, const HealthData& cur, int index);
+
+// Decides which groups are due on each tick of the sampler.  Deadlines live
+// on a hashed timer wheel: advancing one tick only looks at one slot, and
+// re-arming a group is an append to another.
+class CollectionScheduler {
+public:
+    CollectionScheduler(std::chrono::milliseconds tick, const SourceSchedule (&schedules)[kMetricGroupCount],
+                        uint32_t groups);
+
+    // Arm every group for its first period after an initial full collection.
+    void start();
+
+    // Move to the next tick; returns the mask of groups that are due.  Each
+    // of them must be re-armed with reschedule().
+    uint32_t advance();
+
+    // Re-arm group `index`, backing off if it did not change.
+    void reschedule(int index, bool changed);
+
+    std::chrono::milliseconds period(int index) const;
+
+private:
+    struct Timer {
+        int      group;
+        uint64_t deadline;   // absolute tick
+    };
+
+    static constexpr size_t kSlots = 64;
+
+    void arm(int index);
+
+    std::chrono::milliseconds tick_;
+    uint32_t                  groups_;
+    uint64_t                  now_ = 0;
+    std::vector<Timer>        slots_[kSlots];
+
+    // per group, in ticks
+    uint64_t base_ticks_[kMetricGroupCount];
+    uint64_t max_ticks_[kMetricGroupCount];
+    uint64_t cur_ticks_[kMetricGroupCount];
+};
@@ -0,0 +1,136 @@
+#include "self_metrics.h"
+
+#include "json_writer.h"
+#include "metric_source.h"
+
+#include <charconv>
+#include <tuple>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+SelfMetrics& selfMetrics() {
+    static SelfMetrics instance;
+    return instance;
+}
+
+static double seconds(const timeval& tv) {
+    return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+}
+
+// CPU spent before the first measurement (static init, loading) is left out
+// of the first window.
+SelfMetrics::SelfMetrics()
+    : started_(std::chrono::steady_clock::now()), window_start_(started_) {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    window_cpu_ = seconds(ru.ru_utime) + seconds(ru.ru_stime);
+}
+
+LatencyHistogram& SelfMetrics::route(std::string_view name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& r : routes_)
+        if (r.first == name) return r.second;
+    routes_.emplace_back(std::piecewise_construct, std::forward_as_tuple(name), std::tuple<>());
+    return routes_.back().second;
+}
+
+// ---------------------------------------------------------------------------
+// process  –  getrusage() for CPU time, /proc/self/statm for the RSS
+// ---------------------------------------------------------------------------
+
+static constexpr auto kCpuWindow = std::chrono::seconds(10);
+
+void SelfMetrics::sampleProcess() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    auto now = std::chrono::steady_clock::now();
+
+    // the sampler's own /proc entry, not the host's (PROC_PATH)
+    static MetricSource statm("/proc/self/statm");
+    std::string_view text = statm.read();
+    uint64_t pages = 0;
+    size_t   space = text.find(' ');
+    if (space != std::string_view::npos)
+        std::from_chars(text.data() + space + 1, text.data() + text.size(), pages);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    process_.uptime_seconds     = std::chrono::duration<double>(now - started_).count();
+    process_.cpu_user_seconds   = seconds(ru.ru_utime);
+    process_.cpu_system_seconds = seconds(ru.ru_stime);
+    process_.rss_bytes          = pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+    // until the first window completes, the share since start
+    double cpu     = process_.cpu_user_seconds + process_.cpu_system_seconds;
+    double elapsed = std::chrono::duration<double>(now - window_start_).count();
+    bool   full    = now - window_start_ >= kCpuWindow;
+    if (elapsed > 0.0 && (full || !window_complete_))
+        process_.cpu_percent = 100.0 * (cpu - window_cpu_) / elapsed;
+    if (full) {
+        window_start_    = now;
+        window_cpu_      = cpu;
+        window_complete_ = true;
+    }
+}
+
+SelfMetrics::ProcessStats SelfMetrics::process() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return process_;
+}
+
+// ---------------------------------------------------------------------------
+// JSON
+// ---------------------------------------------------------------------------
+
+// Opens an object with the histogram's summary; the caller may add fields
+// before closing it.
+static void beginSummary(JsonWriter& w, const LatencyHistogram& h) {
+    LatencyHistogram::Summary s = h.summary();
+    w.beginObject();
+    w.field("count",   s.count);
+    w.field("mean_us", s.count ? static_cast<double>(s.sum_ns) / s.count / 1e3 : 0.0);
+    w.field("p50_us",  s.p50_ns / 1e3);
+    w.field("p90_us",  s.p90_ns / 1e3);
+    w.field("p99_us",  s.p99_ns / 1e3);
+    w.field("max_us",  s.max_ns / 1e3);
+}
+
+void SelfMetrics::writeJson(std::string& out) const {
+    ProcessStats p = process();
+    JsonWriter w(out, true);
+    w.beginObject();
+    w.key("process");
+    w.beginObject();
+    w.field("uptime_seconds",     p.uptime_seconds);
+    w.field("cpu_user_seconds",   p.cpu_user_seconds);
+    w.field("cpu_system_seconds", p.cpu_system_seconds);
+    w.field("cpu_percent",        p.cpu_percent);
+    w.field("rss_bytes",          p.rss_bytes);
+    w.endObject();
+
+    w.key("sources");
+    w.beginObject();
+    for (int i = 0; i < kMetricGroupCount; ++i) {
+        const SourceStats& s = sources_[i];
+        w.key(metricGroupName(i));
+        beginSummary(w, s.wall);
+        w.field("syscalls",   s.syscalls.load(std::memory_order_relaxed));
+        w.field("bytes_read", s.bytes_read.load(std::memory_order_relaxed));
+        w.endObject();
+    }
+    w.endObject();
+
+    w.key("publish");
+    beginSummary(w, publish_);
+    w.endObject();
+
+    w.key("routes");
+    w.beginObject();
+    forEachRoute([&w](const std::string& name, const LatencyHistogram& h) {
+        w.key(name);
+        beginSummary(w, h);
+        w.endObject();
+    });
+    w.endObject();
+    w.endObject();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "health_collector.h"
+#include "latency_histogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// What each collector costs per run, accumulated by HealthCollector::collect()
+// around its get*() call.  Syscalls and bytes are those of the collecting
+// thread (MetricSource reads plus the statvfs() calls handed to workers).
+struct SourceStats {
+    LatencyHistogram      wall;
+    std::atomic<uint64_t> syscalls{0};
+    std::atomic<uint64_t> bytes_read{0};
+};
+
+// The monitor's own overhead: per-collector cost, time to render and publish
+// a snapshot, HTTP request latency per route and the process's CPU and
+// memory use.  One instance per process, see selfMetrics().
+class SelfMetrics {
+public:
+    SelfMetrics();
+
+    SourceStats&      source(int groupIndex) { return sources_[groupIndex]; }
+    LatencyHistogram& publish()              { return publish_; }
+
+    // Histogram for `route`, created on first use.  References stay valid;
+    // look them up once at startup and keep them.
+    LatencyHistogram& route(std::string_view name);
+
+    // Called once per sampler tick: refreshes the CPU share over the last
+    // complete 10 s window and the resident set size.
+    void sampleProcess();
+
+    struct ProcessStats {
+        double   uptime_seconds     = 0.0;
+        double   cpu_user_seconds   = 0.0;
+        double   cpu_system_seconds = 0.0;
+        double   cpu_percent        = 0.0;   // of one core, last window
+        uint64_t rss_bytes          = 0;
+    };
+    ProcessStats process() const;
+
+    // fn(name, histogram) for every route seen so far
+    template <typename Fn>
+    void forEachRoute(Fn fn) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& r : routes_) fn(r.first, r.second);
+    }
+
+    // GET /api/self
+    void writeJson(std::string& out) const;
+
+private:
+    std::chrono::steady_clock::time_point started_;
+    SourceStats                           sources_[kMetricGroupCount];
+    LatencyHistogram                      publish_;
+
+    mutable std::mutex                                   mutex_;
+    std::deque<std::pair<std::string, LatencyHistogram>> routes_;
+    ProcessStats                                         process_;
+    std::chrono::steady_clock::time_point                window_start_;
+    double                                               window_cpu_ = 0.0;
+    bool                                                 window_complete_ = false;
+};
+
+SelfMetrics& selfMetrics();
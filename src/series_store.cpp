@@ -0,0 +1,586 @@
+#include "series_store.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// ---------------------------------------------------------------------------
+// on-disk layout  –  all fields little endian, as written by the host
+// ---------------------------------------------------------------------------
+
+static constexpr size_t   kBlockBytes    = 4096;
+static constexpr uint32_t kSegmentBlocks = 1024;                       // 4 MiB segments
+static constexpr size_t   kSegmentBytes  = kBlockBytes * kSegmentBlocks;
+static constexpr uint32_t kDirBlocks     = 4;                          // 16 B per block
+static constexpr uint32_t kFirstData     = 1 + kDirBlocks;
+static constexpr uint32_t kVersion       = 1;
+static const char         kMagic[8]      = {'S', 'H', 'S', 'E', 'G', 0, 0, 0};
+
+struct SegmentHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t block_bytes;
+    uint32_t block_count;
+    uint32_t blocks_used;   // next free block; published after its directory entry
+    int64_t  created_ms;    // no point in the segment is older
+    int64_t  newest_ms;     // nor newer; 0 in segments of older builds
+};
+
+struct DirEntry {
+    uint32_t series;        // id + 1; 0 = free
+    uint32_t reserved;
+    int64_t  first_ms;
+};
+
+struct BlockHeader {
+    uint32_t count;         // points, published after their bits
+    uint32_t series;
+    int64_t  first_ms;
+};
+
+static constexpr uint32_t kDataBits     = (kBlockBytes - sizeof(BlockHeader)) * 8;
+static constexpr uint32_t kMaxPointBits = 4 + 32 + 2 + 5 + 5 + 32;
+
+static_assert(sizeof(SegmentHeader) <= kBlockBytes, "segment header must fit block 0");
+static_assert(sizeof(DirEntry) * kSegmentBlocks == kDirBlocks * kBlockBytes, "directory size");
+
+struct SeriesStore::Segment {
+    std::string path;
+    uint8_t*    base     = nullptr;
+    bool        writable = true;    // every page is backed by disk space
+
+    ~Segment() {
+        if (base) ::munmap(base, kSegmentBytes);
+    }
+    SegmentHeader* header() const { return reinterpret_cast<SegmentHeader*>(base); }
+    DirEntry*      dir()    const { return reinterpret_cast<DirEntry*>(base + kBlockBytes); }
+    BlockHeader*   block(uint32_t b) const { return reinterpret_cast<BlockHeader*>(base + b * kBlockBytes); }
+    uint8_t*       data(uint32_t b)  const { return base + b * kBlockBytes + sizeof(BlockHeader); }
+};
+
+static std::string segmentPath(const std::string& dir, uint64_t seq) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "segment-%06llu.shs", static_cast<unsigned long long>(seq));
+    return dir + "/" + name;
+}
+
+// The blocks are allocated up front: a store to a page of a sparse file
+// that the disk has no room for would raise SIGBUS.  A new segment that
+// cannot be allocated is not created; an existing one (sparse, from an
+// older build) is still read but takes no more points.
+std::shared_ptr<SeriesStore::Segment> SeriesStore::mapSegment(const std::string& path, int flags) {
+    const bool create = flags & O_CREAT;
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | flags, 0644);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    bool sized    = create || (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == kSegmentBytes);
+    bool reserved = sized && ::posix_fallocate(fd, 0, kSegmentBytes) == 0;
+    if (create && !reserved) {
+        ::close(fd);
+        ::unlink(path.c_str());
+        return nullptr;
+    }
+    void* p = sized ? ::mmap(nullptr, kSegmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);   // the mapping keeps the file
+    if (p == MAP_FAILED) return nullptr;
+    auto seg      = std::make_shared<Segment>();
+    seg->path     = path;
+    seg->base     = static_cast<uint8_t*>(p);
+    seg->writable = reserved;
+    return seg;
+}
+
+// ---------------------------------------------------------------------------
+// bit streams  –  MSB first into zero-filled block data
+// ---------------------------------------------------------------------------
+
+static void putBits(uint8_t* data, uint32_t& bit, uint64_t v, int n) {
+    for (int i = n - 1; i >= 0; --i, ++bit)
+        if ((v >> i) & 1u) data[bit >> 3] |= static_cast<uint8_t>(0x80u >> (bit & 7));
+}
+
+namespace {
+
+// Walks the points of one block; the state it ends with is what the writer
+// needs to carry on appending.
+struct Decoder {
+    const uint8_t* data;
+    uint32_t       bit        = 0;
+    int64_t        t          = 0;
+    int64_t        delta      = 0;
+    uint32_t       value      = 0;
+    int            leading    = -1;
+    int            trailing   = 0;
+    uint32_t       n          = 0;
+
+    uint64_t get(int count) {
+        uint64_t v = 0;
+        for (int i = 0; i < count; ++i, ++bit)
+            v = (v << 1) | ((data[bit >> 3] >> (7 - (bit & 7))) & 1u);
+        return v;
+    }
+
+    void next() {
+        if (n++ == 0) {
+            value = static_cast<uint32_t>(get(32));
+            return;
+        }
+        int64_t dod;
+        if      (get(1) == 0) dod = 0;
+        else if (get(1) == 0) dod = static_cast<int64_t>(get(7))  - 63;
+        else if (get(1) == 0) dod = static_cast<int64_t>(get(9))  - 255;
+        else if (get(1) == 0) dod = static_cast<int64_t>(get(12)) - 2047;
+        else                  dod = static_cast<int32_t>(get(32));
+        delta += dod;
+        t     += delta;
+
+        if (get(1) == 0) return;   // same value
+        if (get(1) == 1) {
+            leading  = static_cast<int>(get(5));
+            int sig  = static_cast<int>(get(5)) + 1;
+            trailing = std::max(32 - leading - sig, 0);
+        }
+        int sig = 32 - leading - trailing;
+        value ^= static_cast<uint32_t>(get(sig) << trailing);
+    }
+
+    float current() const {
+        float f;
+        std::memcpy(&f, &value, sizeof(f));
+        return f;
+    }
+};
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// open
+// ---------------------------------------------------------------------------
+
+SeriesStore::SeriesStore(std::string dir, std::chrono::hours retention)
+    : dir_(std::move(dir)),
+      retention_ms_(std::chrono::duration_cast<std::chrono::milliseconds>(retention).count()) {
+    ok_ = load();
+}
+
+SeriesStore::~SeriesStore() {
+    if (index_fd_ >= 0) ::close(index_fd_);
+}
+
+// series.idx: a magic, then one record per naming of an id: the 32-bit
+// id, a 16-bit length and the name.  A later record for an id or a name
+// overrides earlier ones.  Files of earlier builds hold just the length
+// and name, the id being the record's position; they are rewritten.
+static const char kIndexMagic[8] = {'S', 'H', 'I', 'D', 'X', 0, 0, 2};
+static constexpr uint32_t kMaxSeriesId = 1u << 24;   // beyond that a record is garbage
+
+static void appendIndexRecord(std::string& out, uint32_t id, const std::string& name) {
+    size_t len = std::min<size_t>(name.size(), 0xffff);
+    for (int i = 0; i < 4; ++i) out += static_cast<char>((id >> (8 * i)) & 0xff);
+    out += static_cast<char>(len & 0xff);
+    out += static_cast<char>(len >> 8);
+    out.append(name, 0, len);
+}
+
+// Give `id` the name `name` while the index is read.
+void SeriesStore::nameSeries(uint32_t id, std::string name) {
+    if (id >= series_.size()) series_.resize(id + 1);
+    if (!series_[id].name.empty()) ids_.erase(series_[id].name);
+    auto it = ids_.find(name);
+    if (it != ids_.end()) series_[it->second].name.clear();   // released, then reused for another id
+    ids_[name]       = id;
+    series_[id].name = std::move(name);
+}
+
+bool SeriesStore::loadIndex() {
+    index_fd_ = ::open((dir_ + "/series.idx").c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (index_fd_ < 0) return false;
+    std::string buf;
+    char chunk[65536];
+    for (;;) {
+        ssize_t n = ::read(index_fd_, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        buf.append(chunk, static_cast<size_t>(n));
+    }
+    auto le = [&](size_t at, int bytes) {
+        uint32_t v = 0;
+        for (int i = 0; i < bytes; ++i) v |= static_cast<uint32_t>(static_cast<uint8_t>(buf[at + i])) << (8 * i);
+        return v;
+    };
+
+    const bool legacy = !buf.empty() && buf.compare(0, sizeof(kIndexMagic), kIndexMagic, sizeof(kIndexMagic)) != 0;
+    size_t pos = 0;
+    if (legacy) {
+        for (uint32_t id = 0; pos + 2 <= buf.size(); ++id) {
+            size_t len = le(pos, 2);
+            if (pos + 2 + len > buf.size()) break;
+            if (len) nameSeries(id, buf.substr(pos + 2, len));
+            else     series_.resize(std::max<size_t>(series_.size(), id + 1));
+            pos += 2 + len;
+        }
+    } else {
+        pos = std::min(buf.size(), sizeof(kIndexMagic));
+        while (pos + 6 <= buf.size()) {
+            uint32_t id  = le(pos, 4);
+            size_t   len = le(pos + 4, 2);
+            if (id >= kMaxSeriesId || len == 0 || pos + 6 + len > buf.size()) break;
+            nameSeries(id, buf.substr(pos + 6, len));
+            pos += 6 + len;
+        }
+    }
+    for (uint32_t id = 0; id < series_.size(); ++id)
+        if (series_[id].name.empty()) free_ids_.push_back(id);
+
+    if (legacy || buf.size() < sizeof(kIndexMagic)) return rewriteIndex();
+    // a record cut short by a crash is dropped
+    if (pos != buf.size() && ::ftruncate(index_fd_, static_cast<off_t>(pos)) != 0) return false;
+    return true;
+}
+
+bool SeriesStore::load() {
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec || !loadIndex()) return false;
+
+    std::vector<std::pair<uint64_t, std::string>> files;
+    for (const auto& entry : fs::directory_iterator(dir_, ec)) {
+        unsigned long long seq;
+        char tail;
+        std::string name = entry.path().filename().string();
+        if (std::sscanf(name.c_str(), "segment-%llu.sh%c", &seq, &tail) == 2 && tail == 's')
+            files.emplace_back(seq, entry.path().string());
+    }
+    if (ec) return false;
+    std::sort(files.begin(), files.end());
+
+    for (const auto& f : files) {
+        next_seq_ = std::max<uint64_t>(next_seq_, f.first + 1);
+        auto seg = mapSegment(f.second, 0);
+        if (!seg) continue;
+        const SegmentHeader* h = seg->header();
+        if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version != kVersion ||
+            h->block_bytes != kBlockBytes || h->block_count != kSegmentBlocks)
+            continue;   // not ours; left alone
+        uint32_t used = std::min(h->blocks_used, kSegmentBlocks);
+        for (uint32_t b = kFirstData; b < used; ++b) {
+            const DirEntry& d = seg->dir()[b];
+            if (d.series == 0 || d.series > series_.size() || series_[d.series - 1].name.empty()) continue;
+            series_[d.series - 1].blocks.push_back(BlockRef{seg, b, d.first_ms});
+        }
+        segments_.push_back(std::move(seg));
+    }
+
+    // every series carries on in its last block, whichever segment it is in
+    for (auto& s : series_)
+        if (!s.blocks.empty() && s.blocks.back().segment->writable) resume(s);
+    expire(std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count());
+
+    // names whose points all expired while the store was closed
+    bool released = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (uint32_t id = 0; id < series_.size(); ++id)
+            if (!series_[id].name.empty() && series_[id].blocks.empty()) {
+                release(id);
+                released = true;
+            }
+    }
+    return !released || rewriteIndex();
+}
+
+// Decode the published points of the series' last block to restore the
+// encoder state, and clear any bits a crash left beyond them.
+void SeriesStore::resume(Series& s) {
+    const BlockRef& ref = s.blocks.back();
+    BlockHeader* h = ref.segment->block(ref.block);
+    uint8_t* data  = ref.segment->data(ref.block);
+    uint32_t count = h->count;
+
+    Decoder d{data};
+    d.t = ref.first_ms;
+    for (uint32_t i = 0; i < count && d.bit + kMaxPointBits <= kDataBits; ++i) d.next();
+    if (d.n != count) return;   // damaged header: start a fresh block
+
+    const uint32_t byte = d.bit >> 3;
+    if (d.bit & 7) data[byte] &= static_cast<uint8_t>(0xff00u >> (d.bit & 7));
+    std::memset(data + byte + ((d.bit & 7) ? 1 : 0), 0, kDataBits / 8 - byte - ((d.bit & 7) ? 1 : 0));
+
+    Tail& tl      = s.tail;
+    tl.data       = data;
+    tl.count      = &h->count;
+    tl.newest_ms  = &ref.segment->header()->newest_ms;
+    tl.n          = count;
+    tl.bit        = d.bit;
+    tl.last_ms    = d.t;
+    tl.last_delta = d.delta;
+    tl.last_value = d.value;
+    tl.leading    = d.leading;
+    tl.trailing   = d.trailing;
+}
+
+// ---------------------------------------------------------------------------
+// append
+// ---------------------------------------------------------------------------
+
+uint32_t SeriesStore::seriesId(const std::string& name) {
+    auto it = ids_.find(name);
+    if (it != ids_.end()) return it->second;
+
+    // a freed id if there is one; the record names it either way
+    const uint32_t id = free_ids_.empty() ? static_cast<uint32_t>(series_.size()) : free_ids_.back();
+    std::string rec;
+    appendIndexRecord(rec, id, name);
+    if (::write(index_fd_, rec.data(), rec.size()) != static_cast<ssize_t>(rec.size()))
+        return std::numeric_limits<uint32_t>::max();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id == series_.size()) series_.emplace_back();
+    else                      free_ids_.pop_back();
+    series_[id].name = name;
+    ids_.emplace(name, id);
+    return id;
+}
+
+// The series has no blocks left: forget its name and free the id.  Called
+// with mutex_ held.
+void SeriesStore::release(uint32_t id) {
+    Series& s = series_[id];
+    ids_.erase(s.name);
+    s.name.clear();
+    s.tail = Tail{};
+    free_ids_.push_back(id);
+}
+
+// Write series.idx afresh with one record per named id, dropping the
+// history of freed and reused ids, and swap it in; a crash leaves either
+// the old or the new file.
+bool SeriesStore::rewriteIndex() {
+    std::string buf(kIndexMagic, sizeof(kIndexMagic));
+    for (uint32_t id = 0; id < series_.size(); ++id)
+        if (!series_[id].name.empty()) appendIndexRecord(buf, id, series_[id].name);
+    const std::string path = dir_ + "/series.idx";
+    const std::string tmp  = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool written = ::write(fd, buf.data(), buf.size()) == static_cast<ssize_t>(buf.size()) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!written || ::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    int reopened = ::open(path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    if (reopened < 0) return false;
+    if (index_fd_ >= 0) ::close(index_fd_);
+    index_fd_ = reopened;
+    return true;
+}
+
+// `appending`: the series whose new block needs the segment; expiry must
+// not release it even if all its points so far are in expiring segments.
+bool SeriesStore::startSegment(int64_t tMs, uint32_t appending) {
+    auto seg = mapSegment(segmentPath(dir_, next_seq_), O_CREAT | O_EXCL);
+    if (!seg) return false;
+    ++next_seq_;
+    SegmentHeader* h = seg->header();
+    std::memcpy(h->magic, kMagic, sizeof(kMagic));
+    h->version     = kVersion;
+    h->block_bytes = kBlockBytes;
+    h->block_count = kSegmentBlocks;
+    h->created_ms  = tMs;
+    h->newest_ms   = tMs;
+    h->blocks_used = kFirstData;
+
+    if (!segments_.empty()) ::msync(segments_.back()->base, kSegmentBytes, MS_ASYNC);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments_.push_back(std::move(seg));
+    }
+    // open blocks stay where they are: moving every series on here would
+    // let one full segment start the next as soon as it filled, once more
+    // series are live than a segment has blocks
+    expire(tMs, appending);
+    return true;
+}
+
+bool SeriesStore::startBlock(uint32_t id, int64_t tMs) {
+    if (segments_.empty() || !segments_.back()->writable ||
+        segments_.back()->header()->blocks_used >= kSegmentBlocks)
+        if (!startSegment(tMs, id)) return false;
+    Segment& seg = *segments_.back();
+    uint32_t b   = seg.header()->blocks_used;
+
+    seg.dir()[b] = DirEntry{id + 1, 0, tMs};
+    BlockHeader* h = seg.block(b);
+    h->series   = id;
+    h->first_ms = tMs;
+    h->count    = 0;
+    __atomic_store_n(&seg.header()->blocks_used, b + 1, __ATOMIC_RELEASE);
+
+    Series& s = series_[id];
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        s.blocks.push_back(BlockRef{segments_.back(), b, tMs});
+    }
+    s.tail           = Tail{};
+    s.tail.data      = seg.data(b);
+    s.tail.count     = &h->count;
+    s.tail.newest_ms = &seg.header()->newest_ms;
+    return true;
+}
+
+void SeriesStore::append(const std::string& name, int64_t tMs, float v) {
+    if (!ok_) return;
+    uint32_t id = seriesId(name);
+    if (id >= series_.size()) return;
+
+    Tail* tl = &series_[id].tail;
+    const int64_t dod = tl->n ? (tMs - tl->last_ms) - tl->last_delta : 0;
+    if (tl->data && (tl->bit + kMaxPointBits > kDataBits || tMs < tl->last_ms ||
+                     dod < std::numeric_limits<int32_t>::min() || dod > std::numeric_limits<int32_t>::max()))
+        tl->data = nullptr;
+    if (!tl->data) {
+        if (!startBlock(id, tMs)) return;
+        tl = &series_[id].tail;
+    }
+
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    if (tl->n == 0) {
+        putBits(tl->data, tl->bit, bits, 32);
+        tl->last_ms = tMs;
+    } else {
+        // timestamp: delta of the delta, in the smallest bucket it fits
+        const int64_t d = (tMs - tl->last_ms) - tl->last_delta;
+        if      (d == 0)                 putBits(tl->data, tl->bit, 0, 1);
+        else if (d >= -63 && d <= 64)     { putBits(tl->data, tl->bit, 0x2, 2);  putBits(tl->data, tl->bit, static_cast<uint64_t>(d + 63), 7); }
+        else if (d >= -255 && d <= 256)   { putBits(tl->data, tl->bit, 0x6, 3);  putBits(tl->data, tl->bit, static_cast<uint64_t>(d + 255), 9); }
+        else if (d >= -2047 && d <= 2048) { putBits(tl->data, tl->bit, 0xe, 4);  putBits(tl->data, tl->bit, static_cast<uint64_t>(d + 2047), 12); }
+        else                              { putBits(tl->data, tl->bit, 0xf, 4);  putBits(tl->data, tl->bit, static_cast<uint32_t>(d), 32); }
+        tl->last_delta = tMs - tl->last_ms;
+        tl->last_ms    = tMs;
+
+        // value: XOR with the previous one, reusing its window of
+        // meaningful bits when the new one fits inside
+        uint32_t x = bits ^ tl->last_value;
+        if (x == 0) {
+            putBits(tl->data, tl->bit, 0, 1);
+        } else {
+            int lead  = __builtin_clz(x);
+            int trail = __builtin_ctz(x);
+            if (tl->leading >= 0 && lead >= tl->leading && trail >= tl->trailing) {
+                putBits(tl->data, tl->bit, 0x2, 2);
+            } else {
+                putBits(tl->data, tl->bit, 0x3, 2);
+                putBits(tl->data, tl->bit, static_cast<uint64_t>(lead), 5);
+                putBits(tl->data, tl->bit, static_cast<uint64_t>(32 - lead - trail - 1), 5);
+                tl->leading  = lead;
+                tl->trailing = trail;
+            }
+            int sig = 32 - tl->leading - tl->trailing;
+            putBits(tl->data, tl->bit, x >> tl->trailing, sig);
+        }
+    }
+    tl->last_value = bits;
+    if (tMs > *tl->newest_ms) *tl->newest_ms = tMs;
+    __atomic_store_n(tl->count, ++tl->n, __ATOMIC_RELEASE);
+}
+
+// Newest point of segment i.  Segments of older builds do not record it,
+// but there every series moved on when the next segment started.
+int64_t SeriesStore::newestPoint(size_t i) const {
+    const int64_t newest = segments_[i]->header()->newest_ms;
+    if (newest > 0 || i + 1 >= segments_.size()) return newest;
+    return segments_[i + 1]->header()->created_ms;
+}
+
+// Drop whole segments once every point in them is older than the cutoff.
+// A series' blocks are in segment order, so it loses a prefix of them;
+// blocks of that prefix in segments that stay are unlisted on disk too,
+// and a series left without blocks is released, unless it is `keep`.
+void SeriesStore::expire(int64_t nowMs, uint32_t keep) {
+    const int64_t cutoff = nowMs - retention_ms_;
+    bool released = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i + 1 < segments_.size();) {   // never the newest one
+            if (newestPoint(i) > cutoff) { ++i; continue; }
+            const Segment* old = segments_[i].get();
+            for (uint32_t id = 0; id < series_.size(); ++id) {
+                Series& s    = series_[id];
+                auto&   b    = s.blocks;
+                auto    last = std::find_if(b.rbegin(), b.rend(), [old](const BlockRef& r) { return r.segment.get() == old; });
+                if (last == b.rend()) continue;
+                if (last == b.rbegin()) s.tail.data = nullptr;   // its open block goes too
+                for (auto r = b.begin(); r != last.base(); ++r)
+                    if (r->segment.get() != old) r->segment->dir()[r->block].series = 0;
+                b.erase(b.begin(), last.base());
+                if (b.empty() && id != keep) {
+                    release(id);
+                    released = true;
+                }
+            }
+            ::unlink(old->path.c_str());   // unmapped once the last reader lets go
+            segments_.erase(segments_.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+    }
+    if (released) rewriteIndex();
+}
+
+// ---------------------------------------------------------------------------
+// queries
+// ---------------------------------------------------------------------------
+
+bool SeriesStore::scan(const std::string& name, int64_t fromMs, int64_t toMs,
+                       const std::function<void(int64_t, float)>& fn) const {
+    std::vector<BlockRef> blocks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = ids_.find(name);
+        if (it == ids_.end()) return false;
+        blocks = series_[it->second].blocks;
+    }
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        const BlockRef& ref = blocks[i];
+        if (ref.first_ms > toMs) break;
+        if (i + 1 < blocks.size() && blocks[i + 1].first_ms < fromMs) continue;
+
+        uint32_t count = __atomic_load_n(&ref.segment->block(ref.block)->count, __ATOMIC_ACQUIRE);
+        Decoder d{ref.segment->data(ref.block)};
+        d.t = ref.first_ms;
+        for (uint32_t n = 0; n < count && d.bit + kMaxPointBits <= kDataBits; ++n) {
+            d.next();
+            if (d.t > toMs) break;
+            if (d.t >= fromMs) fn(d.t, d.current());
+        }
+    }
+    return true;
+}
+
+int64_t SeriesStore::oldest(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = ids_.find(name);
+    if (it == ids_.end() || series_[it->second].blocks.empty()) return -1;
+    return series_[it->second].blocks.front().first_ms;
+}
+
+std::vector<std::string> SeriesStore::names() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> out;
+    out.reserve(series_.size());
+    for (const auto& s : series_)
+        if (!s.blocks.empty()) out.push_back(s.name);
+    return out;
+}
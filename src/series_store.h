@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Append-only on-disk store of the sampled series, so history survives a
+// restart.
+//
+// Points go into fixed-size segment files (DATA_DIR/segment-NNNNNN.shs)
+// that are mmap'd for writing and reading alike.  A segment is an array of
+// 4 KiB blocks: a header, a directory saying which series owns each block
+// and from when, and data blocks holding one series each, compressed the
+// Gorilla way (timestamps as delta-of-delta, values XOR'ed with the
+// previous one).  A series keeps appending to its block until it is full,
+// so blocks of one segment fill at the pace of their own series.  Opening
+// the store maps the segments and reads their directories, a few pages per
+// segment; only the last block of each series is decoded, to carry on
+// appending.  Queries decode straight from the mapped pages.
+//
+// Series ids are assigned on first sight and their names appended to
+// DATA_DIR/series.idx.  Once every point of a series has expired its id is
+// freed and handed to the next new name, with one more record appended;
+// series.idx is compacted whenever expiry frees ids, so names that come
+// and go (veths, containers) do not pile up in memory or on disk.  One
+// thread appends; any number may scan.
+class SeriesStore {
+public:
+    // Open or create `dir`.  Segments whose data is all older than
+    // `retention` are deleted as new ones are started.
+    SeriesStore(std::string dir, std::chrono::hours retention);
+    ~SeriesStore();
+
+    SeriesStore(const SeriesStore&)            = delete;
+    SeriesStore& operator=(const SeriesStore&) = delete;
+
+    // False if the directory could not be created or read.
+    bool ok() const { return ok_; }
+
+    // Append one point; timestamps of a series must not go backwards.
+    void append(const std::string& name, int64_t tMs, float v);
+
+    // Call fn(t_ms, value) for the points of `name` in [fromMs, toMs],
+    // oldest first.  Returns false if the series is unknown.
+    bool scan(const std::string& name, int64_t fromMs, int64_t toMs,
+              const std::function<void(int64_t, float)>& fn) const;
+
+    // Time of the oldest stored point of `name`, or -1.
+    int64_t oldest(const std::string& name) const;
+
+    std::vector<std::string> names() const;
+
+private:
+    static constexpr uint32_t kNoSeries = UINT32_MAX;
+
+    struct Segment;
+    struct BlockRef {
+        std::shared_ptr<Segment> segment;
+        uint32_t                 block;
+        int64_t                  first_ms;
+    };
+    // Where the next point of a series goes, and what it is encoded against
+    struct Tail {
+        uint8_t*  data       = nullptr;   // null: start a new block
+        uint32_t* count      = nullptr;   // published point count in the block header
+        int64_t*  newest_ms  = nullptr;   // newest point of the block's segment
+        uint32_t  n          = 0;
+        uint32_t  bit        = 0;
+        int64_t   last_ms    = 0;
+        int64_t   last_delta = 0;
+        uint32_t  last_value = 0;
+        int       leading    = -1;        // XOR window of the previous value
+        int       trailing   = 0;
+    };
+    struct Series {
+        std::string           name;
+        std::vector<BlockRef> blocks;   // oldest first
+        Tail                  tail;
+    };
+
+    static std::shared_ptr<Segment> mapSegment(const std::string& path, int flags);
+
+    bool     load();
+    bool     loadIndex();
+    void     nameSeries(uint32_t id, std::string name);
+    uint32_t seriesId(const std::string& name);
+    void     release(uint32_t id);
+    bool     rewriteIndex();
+    bool     startSegment(int64_t tMs, uint32_t appending);
+    bool     startBlock(uint32_t id, int64_t tMs);
+    void     resume(Series& s);
+    void     expire(int64_t nowMs, uint32_t keep = kNoSeries);
+    int64_t  newestPoint(size_t segment) const;
+
+    std::string dir_;
+    int64_t     retention_ms_;
+    bool        ok_ = false;
+    int         index_fd_ = -1;
+
+    // blocks_ of each series and segments_ change under mutex_; the
+    // encoded bits and published counts are read without it
+    mutable std::mutex                        mutex_;
+    std::vector<Series>                       series_;   // by id
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::vector<uint32_t>                     free_ids_; // released, name empty
+    std::vector<std::shared_ptr<Segment>>     segments_; // oldest first
+    uint64_t                                  next_seq_ = 1;
+};
@@ -0,0 +1,390 @@
+#include "speed_test.h"
+
+#include "webhook.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <linux/sockios.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr int    kConnectTimeoutMs = 3000;
+static constexpr size_t kChunk            = 64 * 1024;
+
+SpeedTester::SpeedTester(SpeedTestOptions options)
+    : options_(std::move(options)), wake_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), rng_(std::random_device{}()) {
+    if (options_.streams == 0) options_.streams = 1;
+}
+
+SpeedTester::~SpeedTester() {
+    stop();
+    if (wake_fd_ >= 0) ::close(wake_fd_);
+}
+
+void SpeedTester::start() {
+    if (thread_.joinable()) return;
+    uint64_t drained;
+    while (::read(wake_fd_, &drained, sizeof(drained)) > 0) {}
+    stopping_ = false;
+    thread_ = std::thread([this]() { run(); });
+}
+
+void SpeedTester::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    // left readable, so every later poll in the measurement returns at once
+    uint64_t one = 1;
+    if (::write(wake_fd_, &one, sizeof(one)) < 0) {}
+    wake_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+SpeedTestResult SpeedTester::latest() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return result_;
+}
+
+void SpeedTester::run() {
+    std::uniform_int_distribution<long> jitter(0, static_cast<long>(options_.jitter.count()));
+    auto delay = std::chrono::seconds(jitter(rng_));
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!wake_.wait_for(lock, delay, [this]() { return stopping_; })) {
+        lock.unlock();
+        SpeedTestResult res = measure();
+        lock.lock();
+        if (stopping_) break;   // cut short: not a measurement
+        if (!res.available && result_.available) result_.stale = true;
+        else result_ = std::move(res);
+        delay = options_.interval + std::chrono::seconds(jitter(rng_));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Connections  –  non-blocking, every wait also watches the wake fd
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct Endpoint {
+    std::string      host, port, path;
+    std::string      authority;   // Host header
+    sockaddr_storage addr{};
+    socklen_t        addr_len = 0;
+};
+
+struct Stream {
+    int         fd        = -1;
+    bool        connected = false;
+    std::string out;               // request head
+    size_t      out_off   = 0;
+    uint64_t    body_left = 0;     // upload payload still to write
+    uint64_t    written   = 0;     // upload payload written
+    uint64_t    acked     = 0;     // ... and acknowledged by the peer
+    std::string head;              // response head while it arrives
+    bool        in_body   = false;
+    uint64_t    expected  = 0;     // download: Content-Length, or what was asked for
+    uint64_t    received  = 0;     // download payload
+    bool        done      = false;
+};
+
+struct Transfer {
+    bool     ok    = false;
+    double   mbps  = 0.0;
+    uint64_t bytes = 0;   // payload sent or received
+};
+
+}  // namespace
+
+// Resolved once per run, so the pings and every stream reach the same address
+static bool resolve(const std::string& url, Endpoint& ep) {
+    if (!parseHttpUrl(url, ep.host, ep.port, ep.path)) return false;
+    addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(ep.host.c_str(), ep.port.c_str(), &hints, &res) != 0 || !res) return false;
+    std::memcpy(&ep.addr, res->ai_addr, res->ai_addrlen);
+    ep.addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    ep.authority = ep.host.find(':') != std::string::npos ? "[" + ep.host + "]" : ep.host;
+    if (ep.port != "80") ep.authority += ":" + ep.port;
+    return true;
+}
+
+// Connect started, or -1
+static int openSocket(const Endpoint& ep) {
+    int fd = ::socket(ep.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&ep.addr), ep.addr_len) != 0 && errno != EINPROGRESS) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int socketError(int fd) {
+    int       err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) return errno;
+    return err;
+}
+
+static bool woken(int wakeFd) {
+    pollfd pfd{wakeFd, POLLIN, 0};
+    return ::poll(&pfd, 1, 0) == 1;
+}
+
+// TCP handshake times in ms (SYN to SYN-ACK, plus a scheduling hop; no
+// raw socket needed, unlike ICMP); failed connects are left out
+static std::vector<double> pingTimes(const Endpoint& ep, size_t count, int wakeFd) {
+    std::vector<double> out;
+    for (size_t i = 0; i < count && !woken(wakeFd); ++i) {
+        auto start = Clock::now();
+        int  fd    = openSocket(ep);
+        if (fd < 0) continue;
+        pollfd p[2] = {{fd, POLLOUT, 0}, {wakeFd, POLLIN, 0}};
+        int    n;
+        do n = ::poll(p, 2, kConnectTimeoutMs); while (n < 0 && errno == EINTR);
+        bool ok = n > 0 && !p[1].revents && (p[0].revents & POLLOUT) && socketError(fd) == 0;
+        auto end = Clock::now();
+        ::close(fd);
+        if (ok) out.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return out;
+}
+
+// Upload payload: not compressible, built once
+static const char* payloadChunk() {
+    static const std::vector<char> chunk = [] {
+        std::vector<char> c(kChunk);
+        uint32_t x = 2463534242u;
+        for (char& b : c) {
+            x ^= x << 13, x ^= x >> 17, x ^= x << 5;
+            b = static_cast<char>(x);
+        }
+        return c;
+    }();
+    return chunk.data();
+}
+
+// "Content-Length: n" of a response head, case-insensitively; 0 if absent
+static uint64_t contentLength(const std::string& head) {
+    static constexpr std::string_view kName = "\r\ncontent-length:";
+    auto it = std::search(head.begin(), head.end(), kName.begin(), kName.end(),
+                          [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+    if (it == head.end()) return 0;
+    return std::strtoull(&*it + kName.size(), nullptr, 10);
+}
+
+static void finish(Stream& s) {
+    if (s.fd >= 0) ::close(s.fd);
+    s.fd   = -1;
+    s.done = true;
+}
+
+// Advance one stream after poll() flagged it
+static void step(Stream& s, bool upload, std::vector<char>& buf) {
+    if (!s.connected) {
+        if (socketError(s.fd) != 0) return finish(s);
+        s.connected = true;
+    }
+    while (s.out_off < s.out.size() || s.body_left > 0) {
+        const char* data;
+        size_t      len;
+        if (s.out_off < s.out.size()) {
+            data = s.out.data() + s.out_off;
+            len  = s.out.size() - s.out_off;
+        } else {
+            data = payloadChunk();
+            len  = static_cast<size_t>(std::min<uint64_t>(s.body_left, kChunk));
+        }
+        ssize_t n = ::send(s.fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return;
+        if (n <= 0) return finish(s);
+        if (s.out_off < s.out.size()) {
+            s.out_off += static_cast<size_t>(n);
+        } else {
+            s.body_left -= static_cast<uint64_t>(n);
+            s.written   += static_cast<uint64_t>(n);
+        }
+    }
+    for (;;) {
+        ssize_t n = ::recv(s.fd, buf.data(), buf.size(), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return;
+        if (n <= 0) return finish(s);   // EOF ends a download without Content-Length
+        size_t body = static_cast<size_t>(n);
+        if (!s.in_body) {
+            s.head.append(buf.data(), body);
+            size_t end = s.head.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                if (s.head.size() > 16384) return finish(s);
+                continue;
+            }
+            if (s.head.size() < 12 || s.head.compare(0, 5, "HTTP/") != 0 || s.head[9] != '2') return finish(s);
+            if (upload) {   // the peer has read the whole body
+                s.acked = s.written;
+                return finish(s);
+            }
+            uint64_t length = contentLength(s.head);
+            if (length > 0) s.expected = std::min(s.expected, length);
+            body      = s.head.size() - (end + 4);
+            s.in_body = true;
+        }
+        s.received += body;
+        // a server that ignores the size asked for is cut off at the budget
+        if (s.received >= s.expected) return finish(s);
+    }
+}
+
+// Move up to `budget` bytes over `streams` connections at once, for at most
+// `limit`; the rate covers the last three quarters of the transfer
+static Transfer transfer(const Endpoint& ep, bool upload, size_t streams, uint64_t budget,
+                         std::chrono::seconds limit, int wakeFd) {
+    Transfer result;
+    uint64_t per = std::max<uint64_t>(budget / streams, 1);
+    std::string path = ep.path;
+    if (size_t at = path.find("{bytes}"); at != std::string::npos) path.replace(at, 7, std::to_string(per));
+    std::string head = std::string(upload ? "POST " : "GET ") + path + " HTTP/1.1\r\nHost: " + ep.authority +
+                       "\r\nUser-Agent: serverhealth\r\nAccept-Encoding: identity\r\n";
+    if (upload) head += "Content-Type: application/octet-stream\r\nContent-Length: " + std::to_string(per) + "\r\n";
+    head += "Connection: close\r\n\r\n";
+
+    std::vector<Stream> ss(streams);
+    for (Stream& s : ss) {
+        s.fd  = openSocket(ep);
+        s.out = head;
+        if (upload) s.body_left = per;
+        else s.expected = per;
+        if (s.fd < 0) s.done = true;
+    }
+
+    struct Sample {
+        Clock::time_point t;
+        uint64_t          bytes;
+    };
+    std::vector<Sample>    samples;
+    std::vector<pollfd>    pfds;
+    std::vector<Stream*>   polled;
+    std::vector<char>      buf(kChunk);
+    auto                   deadline  = Clock::now() + limit;
+    Clock::time_point      first, end;
+    bool                   started   = false;
+    bool                   cancelled = false;
+    uint64_t               moved     = 0;
+
+    for (;;) {
+        // uploads count what the peer acknowledged: written minus what
+        // still sits in the send queue
+        moved = 0;
+        result.bytes = 0;
+        for (Stream& s : ss) {
+            if (upload) {
+                int queued = 0;
+                if (s.fd >= 0 && s.connected && ::ioctl(s.fd, SIOCOUTQ, &queued) == 0)
+                    s.acked = s.written - std::min<uint64_t>(s.written, static_cast<uint64_t>(queued));
+                moved        += s.acked;
+                result.bytes += s.written;
+            } else {
+                moved        += s.received;
+                result.bytes += s.received;
+            }
+        }
+        end = Clock::now();
+        if (!started && moved > 0) {
+            started = true;
+            first   = end;
+        }
+        if (started && (samples.empty() || moved != samples.back().bytes)) samples.push_back({end, moved});
+
+        pfds.clear();
+        polled.clear();
+        for (Stream& s : ss) {
+            if (s.done) continue;
+            bool sending = !s.connected || s.out_off < s.out.size() || s.body_left > 0;
+            pfds.push_back({s.fd, static_cast<short>(sending ? POLLOUT : POLLIN), 0});
+            polled.push_back(&s);
+        }
+        if (polled.empty() || end >= deadline) break;
+        pfds.push_back({wakeFd, POLLIN, 0});
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - end).count() + 1;
+        int  n    = ::poll(pfds.data(), pfds.size(), static_cast<int>(std::min<long long>(wait, 100)));
+        if (n < 0 && errno != EINTR) break;
+        if (pfds.back().revents) {
+            cancelled = true;
+            break;
+        }
+        for (size_t i = 0; i < polled.size(); ++i)
+            if (pfds[i].revents) step(*polled[i], upload, buf);
+    }
+    for (Stream& s : ss)
+        if (s.fd >= 0) ::close(s.fd);
+    if (cancelled || !started || moved == 0) return result;
+
+    // leave out the first quarter, while the congestion windows open
+    auto   from = first + (end - first) / 4;
+    Sample base{first, 0};
+    for (const Sample& x : samples) {
+        if (x.t > from) break;
+        base = x;
+    }
+    double secs = std::chrono::duration<double>(end - base.t).count();
+    if (secs <= 0.0) return result;
+    result.mbps = static_cast<double>(moved - base.bytes) * 8.0 / secs / 1e6;
+    result.ok   = true;
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// One run  –  latency, then download, then upload
+// ---------------------------------------------------------------------------
+
+SpeedTestResult SpeedTester::measure() {
+    SpeedTestResult res;
+    res.timestamp = HealthCollector::isoTimestamp(std::time(nullptr));
+    Endpoint down;
+    if (!resolve(options_.download_url, down)) return res;
+
+    std::vector<double> rtt = pingTimes(down, options_.pings, wake_fd_);
+    if (!rtt.empty()) {
+        double jitter = 0.0;
+        for (size_t i = 1; i < rtt.size(); ++i) jitter += std::abs(rtt[i] - rtt[i - 1]);
+        if (rtt.size() > 1) res.jitter_ms = static_cast<float>(jitter / static_cast<double>(rtt.size() - 1));
+        std::nth_element(rtt.begin(), rtt.begin() + rtt.size() / 2, rtt.end());
+        res.latency_ms = static_cast<float>(rtt[rtt.size() / 2]);
+    }
+
+    bool     upload     = !options_.upload_url.empty();
+    uint64_t downBudget = upload ? options_.max_bytes - options_.max_bytes / 4 : options_.max_bytes;
+    Transfer d = transfer(down, false, options_.streams, downBudget, options_.max_duration, wake_fd_);
+    res.bytes_used = d.bytes;
+    if (!d.ok) return res;
+    res.download_mbps = static_cast<float>(d.mbps);
+    res.available     = true;
+
+    Endpoint up;
+    if (upload && resolve(options_.upload_url, up)) {
+        Transfer u = transfer(up, true, options_.streams, options_.max_bytes / 4, options_.max_duration, wake_fd_);
+        res.bytes_used += u.bytes;
+        if (u.ok) res.upload_mbps = static_cast<float>(u.mbps);
+    }
+    return res;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "health_collector.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+// SPEEDTEST_DOWNLOAD_URL, SPEEDTEST_UPLOAD_URL, SPEEDTEST_INTERVAL_S,
+// SPEEDTEST_JITTER_S, SPEEDTEST_MAX_BYTES, SPEEDTEST_MAX_SECONDS,
+// SPEEDTEST_STREAMS
+struct SpeedTestOptions {
+    // "{bytes}" is replaced by the size each stream asks for
+    std::string download_url = "http://speed.cloudflare.com/__down?bytes={bytes}";
+    std::string upload_url   = "http://speed.cloudflare.com/__up";   // empty: download only
+    std::chrono::seconds interval{3600};
+    std::chrono::seconds jitter{300};        // every run starts up to this much later
+    uint64_t             max_bytes = 40000000;   // per run, download and upload together
+    std::chrono::seconds max_duration{10};   // per direction
+    size_t               streams = 4;        // parallel connections per direction
+    size_t               pings   = 10;
+};
+
+// Measures latency and throughput to plain-HTTP endpoints from its own
+// thread, on a schedule.
+//
+// A run first times `pings` TCP connects to the download host (latency is
+// their median, jitter the mean difference between consecutive ones), then
+// moves data over `streams` non-blocking connections at once, one poll()
+// loop for all of them, first down and then up.  A direction stops when
+// its share of max_bytes (3/4 down, 1/4 up) has moved or max_duration has
+// passed, whichever is first; the rate leaves out the first quarter of the
+// transfer, while TCP is still ramping up.  Uploaded bytes are counted once
+// the peer has acknowledged them, not when they enter the send buffer.
+// stop() cuts a running measurement short within one poll.
+class SpeedTester {
+public:
+    explicit SpeedTester(SpeedTestOptions options);
+    ~SpeedTester();
+
+    SpeedTester(const SpeedTester&)            = delete;
+    SpeedTester& operator=(const SpeedTester&) = delete;
+
+    void start();
+    void stop();
+
+    // Last result; a failed run keeps the previous figures, marked stale.
+    SpeedTestResult latest() const;
+
+private:
+    void run();
+    SpeedTestResult measure();
+
+    SpeedTestOptions options_;
+    int              wake_fd_ = -1;   // eventfd, polled with the sockets so stop() interrupts a transfer
+
+    mutable std::mutex      mutex_;
+    std::condition_variable wake_;
+    bool                    stopping_ = false;
+    SpeedTestResult         result_;
+    std::thread             thread_;
+    std::mt19937_64         rng_;
+};
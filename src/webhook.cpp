@@ -0,0 +1,181 @@
+#include "webhook.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static constexpr int kTimeoutMs = 5000;   // connect, and each send / receive
+static constexpr int kAttempts  = 3;
+
+bool parseHttpUrl(std::string_view url, std::string& host, std::string& port, std::string& path) {
+    static constexpr std::string_view kScheme = "http://";
+    if (url.substr(0, kScheme.size()) != kScheme) return false;
+    url.remove_prefix(kScheme.size());
+    size_t slash = url.find('/');
+    std::string_view authority = url.substr(0, slash);
+    path.assign(slash == std::string_view::npos ? std::string_view("/") : url.substr(slash));
+
+    std::string_view h = authority, p = "80";
+    if (!authority.empty() && authority.front() == '[') {   // [v6addr]:port
+        size_t close = authority.find(']');
+        if (close == std::string_view::npos) return false;
+        h = authority.substr(1, close - 1);
+        if (close + 1 < authority.size()) {
+            if (authority[close + 1] != ':') return false;
+            p = authority.substr(close + 2);
+        }
+    } else if (size_t colon = authority.rfind(':'); colon != std::string_view::npos) {
+        h = authority.substr(0, colon);
+        p = authority.substr(colon + 1);
+    }
+    int portNum = std::atoi(std::string(p).c_str());
+    if (h.empty() || p.find_first_not_of("0123456789") != std::string_view::npos || portNum <= 0 || portNum > 65535)
+        return false;
+    host.assign(h);
+    port.assign(p);
+    return true;
+}
+
+WebhookSender::WebhookSender(const std::string& url, size_t maxQueued)
+    : url_(url), max_queued_(maxQueued ? maxQueued : 1) {
+    parseHttpUrl(url_, host_, port_, path_);
+}
+
+WebhookSender::~WebhookSender() {
+    stop();
+}
+
+void WebhookSender::start() {
+    if (thread_.joinable()) return;
+    stopping_ = false;
+    thread_ = std::thread([this]() { run(); });
+}
+
+void WebhookSender::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void WebhookSender::post(std::string body) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.size() >= max_queued_) {
+            queue_.pop_front();
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        queue_.push_back(std::move(body));
+    }
+    wake_.notify_one();
+}
+
+size_t WebhookSender::queued() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+// ---------------------------------------------------------------------------
+// delivery thread
+// ---------------------------------------------------------------------------
+
+void WebhookSender::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (queue_.empty()) {
+            wake_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            continue;
+        }
+        std::string body = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        bool ok = false;
+        for (int attempt = 0; attempt < kAttempts && !ok; ++attempt) {
+            if (attempt > 0) {   // 1 s, then 2 s; stop() cuts the pause short
+                std::unique_lock<std::mutex> pause(mutex_);
+                if (wake_.wait_for(pause, std::chrono::seconds(attempt), [this]() { return stopping_; })) break;
+            }
+            ok = deliver(body);
+        }
+        (ok ? sent_ : failed_).fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+    }
+}
+
+// First address of `host` that accepts within the timeout, or -1
+static int connectWithTimeout(const std::string& host, const std::string& port) {
+    addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || !res) return -1;
+
+    int fd = -1;
+    for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) continue;
+        int err = 0;
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            err = errno;
+            if (err == EINPROGRESS) {
+                pollfd pfd{fd, POLLOUT, 0};
+                socklen_t len = sizeof(err);
+                err = ETIMEDOUT;
+                if (::poll(&pfd, 1, kTimeoutMs) == 1) getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            }
+        }
+        if (err != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;   // still non-blocking: every wait below goes through poll()
+}
+
+bool WebhookSender::deliver(const std::string& body) {
+    int fd = connectWithTimeout(host_, port_);
+    if (fd < 0) return false;
+
+    std::string authority = host_.find(':') != std::string::npos ? "[" + host_ + "]" : host_;
+    if (port_ != "80") authority += ":" + port_;
+    std::string req = "POST " + path_ + " HTTP/1.1\r\nHost: " + authority +
+                      "\r\nUser-Agent: serverhealth\r\nContent-Type: application/json\r\nContent-Length: " +
+                      std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+    req += body;
+    bool ok = true;
+    for (size_t off = 0; off < req.size() && ok;) {
+        ssize_t n = ::send(fd, req.data() + off, req.size() - off, MSG_NOSIGNAL);
+        if (n > 0) off += static_cast<size_t>(n);
+        else if (n < 0 && errno == EINTR) continue;
+        else if (n < 0 && errno == EAGAIN) {
+            pollfd pfd{fd, POLLOUT, 0};
+            ok = ::poll(&pfd, 1, kTimeoutMs) == 1;
+        } else {
+            ok = false;
+        }
+    }
+
+    // only the status line matters
+    std::string head;
+    char buf[512];
+    while (ok && head.find("\r\n") == std::string::npos && head.size() < 4096) {
+        pollfd pfd{fd, POLLIN, 0};
+        if (::poll(&pfd, 1, kTimeoutMs) != 1) { ok = false; break; }
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (n <= 0) { ok = false; break; }
+        head.append(buf, static_cast<size_t>(n));
+    }
+    ::close(fd);
+    return ok && head.size() >= 12 && head.compare(0, 5, "HTTP/") == 0 && head[9] == '2';
+}
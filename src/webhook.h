@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Split "http://host[:port]/path" (port defaults to 80).  https is not
+// supported: the binary is built without TLS.  Also used for the speed
+// test endpoints.
+bool parseHttpUrl(std::string_view url, std::string& host, std::string& port, std::string& path);
+
+// Delivers JSON bodies by HTTP POST from its own thread.
+//
+// post() only appends to a bounded in-memory queue and returns, so a slow
+// or unreachable receiver never holds up the sampler; when the queue is
+// full the oldest body is dropped and counted.  Each body is tried up to
+// three times with a growing pause, one connection per delivery
+// (alerts are rare enough that keeping one open is not worth it).
+class WebhookSender {
+public:
+    explicit WebhookSender(const std::string& url, size_t maxQueued = 1000);
+    ~WebhookSender();
+
+    WebhookSender(const WebhookSender&)            = delete;
+    WebhookSender& operator=(const WebhookSender&) = delete;
+
+    void start();
+    void stop();
+
+    void post(std::string body);
+
+    const std::string& url() const { return url_; }
+    size_t   queued()  const;
+    uint64_t sent()    const { return sent_.load(std::memory_order_relaxed); }
+    uint64_t failed()  const { return failed_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    bool deliver(const std::string& body);   // true on a 2xx answer
+
+    std::string url_, host_, port_, path_;
+    size_t      max_queued_;
+
+    mutable std::mutex      mutex_;
+    std::condition_variable wake_;
+    std::deque<std::string> queue_;
+    bool                    stopping_ = false;
+    std::thread             thread_;
+
+    std::atomic<uint64_t> sent_{0}, failed_{0}, dropped_{0};
+};
@@ -0,0 +1,38 @@
+#include "worker_pool.h"
+
+#include <thread>
+#include <utility>
+
+WorkerPool::WorkerPool(size_t threads) : state_(std::make_shared<State>()) {
+    for (size_t i = 0; i < threads; ++i) std::thread(run, state_).detach();
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->stopping = true;
+        state_->tasks.clear();
+    }
+    state_->cv.notify_all();
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->tasks.push_back(std::move(task));
+    }
+    state_->cv.notify_one();
+}
+
+void WorkerPool::run(std::shared_ptr<State> state) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    for (;;) {
+        state->cv.wait(lock, [&]() { return state->stopping || !state->tasks.empty(); });
+        if (state->stopping) return;
+        std::function<void()> task = std::move(state->tasks.front());
+        state->tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// A few threads for blocking calls that may never return (statvfs on a
+// dead NFS server).  Threads are detached and share ownership of the queue,
+// so destroying the pool never waits for a stuck task; an idle worker
+// simply exits once it sees the pool is gone.  Tasks must therefore own
+// everything they touch.
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&)            = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+private:
+    struct State {
+        std::mutex                        mutex;
+        std::condition_variable           cv;
+        std::deque<std::function<void()>> tasks;
+        bool                              stopping = false;
+    };
+
+    static void run(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> state_;
+};
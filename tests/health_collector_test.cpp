@@ -0,0 +1,86 @@
+// Every entry of a list group has a key of its own, so CBOR deltas and
+// history series of one entry never stand for another: thermal zones that
+// share a type are told apart by their directory, and a mount point listed
+// twice in /proc/mounts is one disk.
+//
+//   cmake --build _build && ctest --test-dir _build -R health_collector
+
+#include "health_collector.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                           \
+    do {                                                                      \
+        if (!(cond)) {                                                        \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                                       \
+        }                                                                     \
+    } while (0)
+
+static void writeFile(const fs::path& path, const std::string& text) {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path) << text;
+}
+
+int main() {
+    const fs::path root = fs::temp_directory_path() / ("serverhealth-collector-" + std::to_string(::getpid()));
+    fs::remove_all(root);
+
+    const fs::path thermal = root / "sys/class/thermal";
+    writeFile(thermal / "thermal_zone0/type", "acpitz\n");
+    writeFile(thermal / "thermal_zone0/temp", "41000\n");
+    writeFile(thermal / "thermal_zone1/type", "acpitz\n");
+    writeFile(thermal / "thermal_zone1/temp", "52000\n");
+    writeFile(thermal / "thermal_zone2/type", "x86_pkg_temp\n");
+    writeFile(thermal / "thermal_zone2/temp", "63000\n");
+    // "/" mounted over: procfs lists both, statvfs() sees the top one
+    writeFile(root / "proc/mounts", "/dev/sda1 / ext4 rw 0 0\n"
+                                    "/dev/sdb1 / ext4 rw 0 0\n");
+
+    ::setenv("SYS_PATH", (root / "sys").c_str(), 1);
+    ::setenv("PROC_PATH", (root / "proc").c_str(), 1);
+    {
+        HealthCollector collector(kGroupTemperature | kGroupDisks);
+        HealthData d = collector.collect();
+
+        CHECK(d.temperature.size() == 3);
+        std::set<std::string> zones;
+        for (const auto& t : d.temperature) zones.insert(t.zone);
+        CHECK(zones == (std::set<std::string>{"thermal_zone0", "thermal_zone1", "thermal_zone2"}));
+        CHECK(d.disks.size() == 1);
+
+        std::string cbor;
+        std::vector<CborEntry> entries;
+        HealthCollector::writeCbor(d, 1, 1, cbor, &entries);
+        std::set<std::pair<int, std::string>> keys;
+        size_t listEntries = 0;
+        for (const auto& e : entries) {
+            if (e.key.empty()) continue;   // a scalar group
+            ++listEntries;
+            keys.emplace(e.group, e.key);
+        }
+        CHECK(listEntries == 4);
+        CHECK(keys.size() == listEntries);
+        CHECK(keys.count({metricGroupIndex("temperature"), "thermal_zone1"}) == 1);
+        CHECK(keys.count({metricGroupIndex("disks"), "/"}) == 1);
+
+        const std::string json = HealthCollector::toJson(d, false);
+        CHECK(json.find("\"zone\":\"thermal_zone1\",\"name\":\"acpitz\"") != std::string::npos);
+    }
+
+    fs::remove_all(root);
+    if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+// SeriesStore with more live series than a segment has data blocks: every
+// series keeps its open block, so a round of appends does not start a new
+// segment, and the points survive a reopen.  Series whose points expire
+// free their ids for new names.
+//
+//   cmake --build _build && ctest --test-dir _build -R series_store
+
+#include "series_store.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                           \
+    do {                                                                      \
+        if (!(cond)) {                                                        \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                                       \
+        }                                                                     \
+    } while (0)
+
+static size_t segmentFiles(const std::string& dir) {
+    size_t n = 0;
+    for (const auto& e : fs::directory_iterator(dir))
+        if (e.path().extension() == ".shs") ++n;
+    return n;
+}
+
+static std::vector<float> points(const SeriesStore& store, const std::string& name) {
+    std::vector<float> out;
+    store.scan(name, 0, INT64_MAX, [&](int64_t, float v) { out.push_back(v); });
+    return out;
+}
+
+int main() {
+    std::string dir = (fs::temp_directory_path() / ("serverhealth-series-" + std::to_string(::getpid()))).string();
+    fs::remove_all(dir);
+
+    constexpr int     kSeries = 1500;   // more than the 1019 data blocks of a segment
+    constexpr int     kRounds = 20;
+    // recent, or opening the store would expire them
+    const int64_t     kStart  = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    std::chrono::system_clock::now().time_since_epoch()).count() - 60000;
+    auto name = [](int i) { return "network[veth" + std::to_string(i) + "].rx_bytes_per_sec"; };
+
+    {
+        SeriesStore store(dir, std::chrono::hours(24));
+        CHECK(store.ok());
+        for (int r = 0; r < kRounds; ++r)
+            for (int i = 0; i < kSeries; ++i)
+                store.append(name(i), kStart + r * 1000, static_cast<float>(i + r));
+        // the first round opens one block per series, later rounds append to them
+        CHECK(segmentFiles(dir) == 2);
+        CHECK(points(store, name(0)).size() == kRounds);
+        CHECK(points(store, name(kSeries - 1)).size() == kRounds);
+    }
+
+    {
+        SeriesStore store(dir, std::chrono::hours(24));
+        CHECK(store.ok());
+        CHECK(store.names().size() == kSeries);
+        for (int i = 0; i < kSeries; ++i)
+            store.append(name(i), kStart + kRounds * 1000, static_cast<float>(i + kRounds));
+        CHECK(segmentFiles(dir) == 2);   // reopened blocks take the new points
+        for (int i : {0, 1018, 1019, kSeries - 1}) {
+            std::vector<float> v = points(store, name(i));
+            CHECK(v.size() == kRounds + 1);
+            for (size_t r = 0; r < v.size(); ++r) CHECK(v[r] == static_cast<float>(i) + r);
+        }
+        CHECK(store.oldest(name(7)) == kStart);
+    }
+
+    fs::remove_all(dir);
+
+    // names whose points have all expired give their ids to new ones
+    {
+        const int64_t now = kStart + 60000;
+        SeriesStore store(dir, std::chrono::hours(1));
+        for (int i = 0; i < 1019; ++i) store.append("old" + std::to_string(i), now - 3 * 3600 * 1000, 1.0f);
+        store.append("live", now, 2.0f);   // starts the second segment; the first expires
+        CHECK(segmentFiles(dir) == 1);
+        CHECK(store.names().size() == 1);
+        // expiry compacted series.idx; new names only append to it
+        struct stat before, after;
+        ::stat((dir + "/series.idx").c_str(), &before);
+        for (int i = 0; i < 1019; ++i) store.append("new" + std::to_string(i), now, 3.0f);
+        ::stat((dir + "/series.idx").c_str(), &after);
+        CHECK(before.st_ino == after.st_ino);
+        CHECK(store.names().size() == 1020);
+    }
+    {
+        SeriesStore store(dir, std::chrono::hours(1));
+        CHECK(store.names().size() == 1020);
+        CHECK(!store.scan("old5", 0, INT64_MAX, [](int64_t, float) {}));
+        std::vector<float> v = points(store, "new5");
+        CHECK(v.size() == 1 && v[0] == 3.0f);
+        // magic, then a record (id, length, name) per live name
+        size_t expected = 8 + 6 + 4;
+        for (int i = 0; i < 1019; ++i) expected += 6 + 3 + std::to_string(i).size();
+        CHECK(fs::file_size(dir + "/series.idx") == expected);
+    }
+
+    fs::remove_all(dir);
+
+    // the series whose append starts the new segment has its only points in
+    // the one that expires: it keeps its id and the point lands under its name
+    {
+        const int64_t now = kStart + 60000;
+        SeriesStore store(dir, std::chrono::hours(1));
+        const int64_t old = now - 30LL * 24 * 3600 * 1000;   // too far back to delta-encode against
+        store.append("a", old, 1.0f);
+        for (int i = 1; i < 1019; ++i) store.append("n" + std::to_string(i), old, 1.0f);
+        store.append("a", now, 42.0f);   // new block, the segment is full: rotate and expire
+        std::vector<float> v = points(store, "a");
+        CHECK(v.size() == 1 && v[0] == 42.0f);
+        store.append("fresh", now, 7.0f);   // may take a freed id
+        v = points(store, "fresh");
+        CHECK(v.size() == 1 && v[0] == 7.0f);
+    }
+    {
+        SeriesStore store(dir, std::chrono::hours(1));
+        std::vector<float> v = points(store, "a");
+        CHECK(v.size() == 1 && v[0] == 42.0f);
+        CHECK(points(store, "fresh").size() == 1);
+    }
+
+    fs::remove_all(dir);
+
+    // no room for a segment (here: a file size limit below 4 MiB): the point
+    // is dropped, nothing is mapped that the disk could not back
+    {
+        struct rlimit saved;
+        ::getrlimit(RLIMIT_FSIZE, &saved);
+        struct rlimit small = saved;
+        small.rlim_cur      = 1 << 20;
+        std::signal(SIGXFSZ, SIG_IGN);
+        ::setrlimit(RLIMIT_FSIZE, &small);
+        {
+            SeriesStore store(dir, std::chrono::hours(1));
+            CHECK(store.ok());
+            store.append("full", kStart, 1.0f);
+            CHECK(points(store, "full").empty());
+            CHECK(segmentFiles(dir) == 0);
+        }
+        ::setrlimit(RLIMIT_FSIZE, &saved);
+        std::signal(SIGXFSZ, SIG_DFL);
+        SeriesStore store(dir, std::chrono::hours(1));
+        store.append("full", kStart, 2.0f);
+        CHECK(points(store, "full").size() == 1);
+    }
+
+    fs::remove_all(dir);
+    if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}